@@ -112,7 +112,9 @@ int main(int argc, char **argv) {
 
   // step3: 在 demo 侧构建一个“外部设备”示例：SimDDR
   // 实际对接 FPGA 时，这里替换为板卡/外设接口收发逻辑即可。
+  // SimDDR 直接读写句柄自有的物理内存。
   sim_ddr::SimDDR ddr;
+  ddr.set_memory(sc_sim_get_memory(sim));
   ddr.init();
   ddr.comb_outputs();
 
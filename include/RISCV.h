@@ -7,6 +7,8 @@
 #define INST_SRET 0x10200073
 #define INST_WFI 0x10500073
 #define INST_NOP 0x00000013
+#define INST_SFENCE_VMA 0x12000073
+#define INST_SFENCE_VMA_MASK 0xfe007fff
 
 enum enum_number_opcode {
   number_0_opcode_lui = 0b0110111,   // lui
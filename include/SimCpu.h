@@ -1,4 +0,0 @@
-#pragma once
-
-class SimCpu {};
-extern SimCpu cpu;
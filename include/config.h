@@ -116,18 +116,19 @@ using namespace std;
 #define LOG_START 0
 // #define LOG_ENABLE
 
+// 每个仿真实例有自己的时间基准，日志开关不再依赖全局 sim_time
 #ifndef LOG_ENABLE
 #define DEBUG (0)
-#define LOG (0 && (sim_time >= LOG_START))
-#define MEM_LOG (0 && (sim_time >= LOG_START))
-#define DCACHE_LOG (0 && (sim_time >= LOG_START))
-#define MMU_LOG (0 && (sim_time >= LOG_START))
+#define LOG (0)
+#define MEM_LOG (0)
+#define DCACHE_LOG (0)
+#define MMU_LOG (0)
 #else
-#define DEBUG (1 && (sim_time >= 0))
-#define LOG (1 && (sim_time >= LOG_START))
-#define MEM_LOG (0 && (sim_time >= LOG_START))
-#define DCACHE_LOG (0 && (sim_time >= LOG_START))
-#define MMU_LOG (0 && (sim_time >= LOG_START))
+#define DEBUG (1)
+#define LOG (1)
+#define MEM_LOG (0)
+#define DCACHE_LOG (0)
+#define MMU_LOG (0)
 #endif
 
 // #define LOG_START (sim_time >= 512966 && sim_time <= 514966)
@@ -469,8 +470,6 @@ public:
   }
 };
 
-extern long long sim_time;
-
 class SimContext {
 public:
   PerfCount perf;
@@ -3,6 +3,8 @@
 #include <stdint.h>
 
 #ifdef __cplusplus
+#include <unordered_map>
+
 extern "C" {
 #endif
 
@@ -69,22 +71,259 @@ typedef struct sc_sim_status_t {
   uint8_t uart_ch;
 } sc_sim_status_t;
 
+typedef struct sc_sim_tlb_stats_t {
+  uint64_t itlb_hit;
+  uint64_t itlb_miss;
+  uint64_t dtlb_hit;
+  uint64_t dtlb_miss;
+  uint64_t flushes;
+} sc_sim_tlb_stats_t;
+
+typedef struct sc_sim_dcache_stats_t {
+  uint64_t accesses;   // cacheable loads, stores and AMOs
+  uint64_t misses;
+  uint64_t writebacks; // dirty lines written back on eviction
+} sc_sim_dcache_stats_t;
+
+// Latency of the AXI requests of one master, in cycles from the cycle the
+// core sets the request up (waits for the port included) to the cycle its
+// response arrives. Posted stores count from entering the store buffer.
+#define SC_SIM_PERF_LATENCY_BUCKETS 16
+typedef struct sc_sim_latency_hist_t {
+  uint64_t count;
+  uint64_t total_cycles;
+  uint64_t max_cycles;
+  // buckets[0]: 0-1 cycles, buckets[i]: [2^i, 2^(i+1)), the last one open
+  uint64_t buckets[SC_SIM_PERF_LATENCY_BUCKETS];
+} sc_sim_latency_hist_t;
+
+// latency[] index, same numbering as the interconnect masters.
+#define SC_SIM_PERF_MASTER_ICACHE 0
+#define SC_SIM_PERF_MASTER_DCACHE_R 1
+#define SC_SIM_PERF_MASTER_MMU 2
+#define SC_SIM_PERF_MASTER_DCACHE_W 3
+#define SC_SIM_PERF_MASTERS 4
+
+typedef struct sc_sim_perf_t {
+  uint64_t sim_time;
+  uint64_t inst_count;
+  // Cycles spent in each core stage; with fast_forward_cycles they add up to
+  // sim_time. Page-table walks show up in the stage that needed them and
+  // in mmu_pending_cycles as well.
+  uint64_t prepare_fetch_cycles;
+  uint64_t wait_fetch_cycles;
+  uint64_t prepare_data_cycles;
+  uint64_t wait_data_cycles;
+  uint64_t execute_cycles;
+  uint64_t wait_amo_write_cycles;
+  uint64_t fast_forward_cycles;
+  uint64_t mmu_pending_cycles;
+  uint64_t icache_access; // fetch buffer lookups (fetches from RAM)
+  uint64_t icache_miss;
+  uint64_t dcache_access;
+  uint64_t dcache_miss;
+  uint64_t dcache_writeback;
+  uint64_t itlb_hit;
+  uint64_t itlb_miss;
+  uint64_t dtlb_hit;
+  uint64_t dtlb_miss;
+  sc_sim_latency_hist_t latency[SC_SIM_PERF_MASTERS];
+} sc_sim_perf_t;
+
 typedef struct sc_sim_handle sc_sim_handle;
 
+// Slave model for the batched API. Called once per cycle with the settled
+// master outputs; it must advance the slave by one cycle and leave the slave
+// outputs for the next cycle in *axi_in. `cycle` equals status.sim_time after
+// the cycle, as reported by sc_sim_step().
+typedef void (*sc_sim_slave_fn)(void *user, uint64_t cycle,
+                                const sc_axi4_out_t *axi_out,
+                                sc_axi4_in_t *axi_in);
+
+// Extra stop conditions for sc_sim_step_n/sc_sim_run_until. Halt and error
+// always stop. UART bytes are only reported when SC_SIM_STOP_UART is set.
+#define SC_SIM_STOP_UART 0x1u   // a byte was written to the UART
+#define SC_SIM_STOP_RETIRE 0x2u // at least one instruction retired
+
 sc_sim_handle *sc_sim_create(void);
 void sc_sim_destroy(sc_sim_handle *handle);
 
+// Forks a simulation at its current cycle. CPU, interconnect and built-in
+// SimDDR state (including transactions in flight) are copied; memory is shared
+// copy-on-write, so a clone costs roughly the page-table size, not the memory
+// size. Limits and the slave callback are copied as well: a callback slave
+// with its own state needs sc_sim_set_slave() on the clone. The source must
+// not be stepped concurrently with the call; afterwards both handles are
+// independent and may run in different threads.
+sc_sim_handle *sc_sim_clone(sc_sim_handle *handle);
+
+// Replaces the whole memory contents and resets the machine state, so one
+// handle can run several images in turn. Settings (limits, latency, timing
+// mode, buffers and caches) are kept.
+// A raw binary is loaded at 0x80000000 and entered there. An RV32 ELF file
+// has its PT_LOAD segments loaded at their physical addresses and is entered
+// at e_entry; image_size_out then receives the bytes loaded from the file.
+// Page-aligned parts of the file are mapped (mmap, copy-on-write) rather than
+// copied, so the file must not be truncated or rewritten while a handle
+// still uses it. A gzip-compressed raw binary is inflated straight into
+// memory at 0x80000000; image_size_out then receives the decompressed size.
 int sc_sim_load_image(sc_sim_handle *handle, const char *image_path,
                       uint64_t *image_size_out);
+// Raising max_inst after a max_inst stop resumes the run.
 void sc_sim_set_limits(sc_sim_handle *handle, uint64_t max_inst,
                        uint64_t max_cycles);
 
+// Checkpoints hold the architectural state, the AXI pipeline state of the
+// core, interconnect and built-in SimDDR, and the non-zero memory pages
+// (zlib-compressed per page). A callback slave's own state is not included.
+// Loading replaces the machine state but keeps limits and the slave callback;
+// a checkpoint taken at a max_inst stop resumes once max_inst is above
+// inst_count. Both return 0 on success and -1 on error (sc_sim_last_error()).
+int sc_sim_save_checkpoint(sc_sim_handle *handle, const char *path);
+int sc_sim_load_checkpoint(sc_sim_handle *handle, const char *path);
+
+// Latency of the built-in SimDDR in cycles (default ICACHE_MISS_LATENCY).
+// sc_sim_load_image() does not reset it; typically set on a fresh clone.
+void sc_sim_set_ddr_latency(sc_sim_handle *handle, uint32_t cycles);
+
+// Timing modes. CYCLE drives every AXI beat through the interconnect and
+// DDR. TLM (built-in SimDDR only) completes each memory request in one call
+// and adds the cycle-mode cost of that request to sim_time; with requests
+// issued one at a time, as this core does, sim_time matches the cycle mode
+// exactly. In TLM mode sc_sim_step() is unavailable and sc_sim_step_n()
+// advances whole instructions, so it may overrun n_cycles by one
+// instruction. Switching is only allowed at an instruction boundary, and TLM
+// needs the store buffer, fetch buffer and data cache off; returns 0 on
+// success, -1 on error.
+#define SC_SIM_TIMING_CYCLE 0
+#define SC_SIM_TIMING_TLM 1
+int sc_sim_set_timing_mode(sc_sim_handle *handle, int mode);
+
+// Posted-write store buffer (cycle timing only, off by default). With
+// entries > 0 a store to RAM retires once it is in the buffer, and the buffer
+// drains to the write port in the background; a store to a word whose write
+// has not been issued yet is merged into it. Loads fully covered by buffered
+// stores are forwarded without a bus read, other loads, fetches and page-table
+// reads touching a buffered word wait for it to drain. FENCE, FENCE.I,
+// SFENCE.VMA, AMOs and MMIO accesses wait until the buffer is empty. Only
+// allowed at an instruction boundary with an empty buffer and not in TLM
+// mode; returns 0 on success, -1 on error.
+#define SC_SIM_STORE_BUFFER_MAX 16
+int sc_sim_set_store_buffer(sc_sim_handle *handle, uint32_t entries);
+
+// Line fetch buffer (cycle timing only, off by default). With lines > 0,
+// instruction fetches from RAM read whole 32-byte lines in one burst into a
+// small fully associative buffer (FIFO replacement), and fetches that hit a
+// buffered line skip the bus. With prefetch != 0 (needs lines >= 2), every
+// fetch also requests the next line in the background if it is missing.
+// FENCE.I empties the buffer. Fetches below RAM (boot ROM, MMIO) still read
+// one word. Same restrictions as sc_sim_set_store_buffer(); changing the
+// configuration empties the buffer. Returns 0 on success, -1 on error.
+#define SC_SIM_FETCH_BUFFER_MAX 16
+int sc_sim_set_fetch_buffer(sc_sim_handle *handle, uint32_t lines,
+                            int prefetch);
+
+// Set-associative data cache between the core and the dcache ports (cycle
+// timing only, off by default; sets == 0 turns it off). Loads, stores and
+// AMOs to RAM look up the cache: hits complete without bus traffic, misses
+// refill the whole line with one burst on the dcache read port. With
+// write_back != 0 stores allocate and dirty the line, and a dirty victim is
+// written back as one burst on the write port while the refill runs;
+// otherwise stores write through to the bus (or the store buffer) and do not
+// allocate. MMIO is never cached. sets must be a power of two, ways at most
+// SC_SIM_DCACHE_WAYS_MAX, line_bytes 4, 8, 16 or 32. Memory is always up to
+// date in the simulator, so changing the configuration drops the contents
+// without writing them back. Only allowed at an instruction boundary with no
+// write-back in flight and not in TLM mode; returns 0 on success, -1 on error.
+#define SC_SIM_DCACHE_SETS_MAX 4096
+#define SC_SIM_DCACHE_WAYS_MAX 16
+#define SC_SIM_DCACHE_LRU 0
+#define SC_SIM_DCACHE_FIFO 1
+#define SC_SIM_DCACHE_RANDOM 2
+int sc_sim_set_dcache(sc_sim_handle *handle, uint32_t sets, uint32_t ways,
+                      uint32_t line_bytes, int policy, int write_back);
+
 int sc_sim_step(sc_sim_handle *handle, const sc_axi4_in_t *axi_in,
                 sc_axi4_out_t *axi_out, sc_sim_status_t *status_out);
 void sc_sim_get_status(const sc_sim_handle *handle, sc_sim_status_t *status_out);
 
+// Batched stepping. slave_fn == NULL selects the built-in SimDDR (reset by
+// sc_sim_load_image); initial_in (may be NULL) is the callback slave's output
+// for the first cycle. sc_sim_step_n advances up to n_cycles, sc_sim_run_until
+// runs until a stop condition; both return like sc_sim_step().
+void sc_sim_set_slave(sc_sim_handle *handle, sc_sim_slave_fn slave_fn,
+                      void *user, const sc_axi4_in_t *initial_in);
+int sc_sim_step_n(sc_sim_handle *handle, uint64_t n_cycles, uint32_t stop_mask,
+                  sc_sim_status_t *status_out);
+int sc_sim_run_until(sc_sim_handle *handle, uint32_t stop_mask,
+                     sc_sim_status_t *status_out);
+
+// Functional fast-forward: executes up to max_inst instructions without AXI
+// traffic (one cycle per instruction), then hands back to sc_sim_step().
+// Only valid at an instruction boundary: before the first sc_sim_step() or
+// right after a step that retired an instruction, with the store buffer
+// drained and no data cache write-back in flight. Returns early after each UART byte (status.uart_valid) so the
+// caller can print it.
+// Return value follows sc_sim_step(): 0 running, 1 halted ok, -1 error.
+int sc_sim_fast_forward(sc_sim_handle *handle, uint64_t max_inst,
+                        sc_sim_status_t *status_out);
+
+void sc_sim_get_tlb_stats(const sc_sim_handle *handle,
+                          sc_sim_tlb_stats_t *stats_out);
+// Counters since sc_sim_load_image(); all zero while the data cache is off.
+void sc_sim_get_dcache_stats(const sc_sim_handle *handle,
+                             sc_sim_dcache_stats_t *stats_out);
+
+// Performance counters since sc_sim_load_image() (kept in checkpoints).
+// Stage cycles and latencies are gathered in both timing modes; TLM mode
+// charges each request its calibrated cost.
+void sc_sim_get_perf(const sc_sim_handle *handle, sc_sim_perf_t *perf_out);
+// Writes the counters of sc_sim_get_perf() as a JSON object to `path`
+// ("-" for stdout). Returns 0 on success, -1 on error (sc_sim_last_error()).
+int sc_sim_write_perf_json(sc_sim_handle *handle, const char *path);
+
+// Host bytes held by the handle's sparse physical memory (pages that were
+// written with non-zero data, plus page tables).
+uint64_t sc_sim_get_resident_memory(const sc_sim_handle *handle);
+
+// Basic-block vector profiling for SimPoint-style sampling. While enabled,
+// sc_sim_fast_forward() counts the instructions retired per basic block
+// (C++ hosts read the counts with sc_sim_take_bbv()). Enabling clears them.
+void sc_sim_set_bbv_profiling(sc_sim_handle *handle, int enable);
+
+// Guest PC profiling. With period N > 0 every N-th executed instruction is a
+// sample charged with all cycles since the previous sample, AXI waits and
+// PTW stalls included (1: exact per-instruction counts); 0 turns it off.
+// Samples are kept per PC and shadow call stack. Enabling drops earlier data;
+// profiles are not saved in checkpoints (loading one restarts the profile),
+// clones copy them. Cycles run by sc_sim_fast_forward() are reported as a
+// single "[fast-forward]" frame.
+int sc_sim_set_pc_profiling(sc_sim_handle *handle, uint32_t period);
+// Writes the profile gathered so far. `folded_path` gets folded stacks
+// ("caller;callee;function cycles" per line, for flamegraph.pl and similar),
+// `hot_spots_path` ("-" for stdout) a table of the `top` functions with the
+// most self cycles (0: all); either may be NULL. `elf_path` (may be NULL)
+// names PCs after the functions in that ELF's symbol table, otherwise PCs
+// are printed in hex. Returns 0 on success, -1 on error.
+int sc_sim_write_pc_profile(sc_sim_handle *handle, const char *folded_path,
+                            const char *hot_spots_path, const char *elf_path,
+                            uint32_t top);
+
 const char *sc_sim_last_error(const sc_sim_handle *handle);
 
 #ifdef __cplusplus
 }
+
+// Each handle owns its physical memory and time base, so handles are fully
+// independent and may be driven from different threads (one thread per
+// handle). C++ hosts that run an in-process slave model (e.g. SimDDR) attach
+// it to the handle's memory with this accessor.
+class PhysicalMemory;
+PhysicalMemory *sc_sim_get_memory(sc_sim_handle *handle);
+
+// Moves the basic-block vector gathered since the previous call (or since
+// profiling was enabled) into bbv_out: block start physical address ->
+// instructions retired from that block.
+void sc_sim_take_bbv(sc_sim_handle *handle,
+                     std::unordered_map<uint32_t, uint64_t> &bbv_out);
 #endif
@@ -8,18 +8,23 @@
  */
 
 #include "AXI_Interconnect.h"
+#include "Checkpoint.h"
 #include <algorithm>
 #include <cstdio>
 
 namespace axi_interconnect {
 
+constexpr uint32_t kPendingTimeout = 100000;
+
 // ============================================================================
 // Initialization
 // ============================================================================
 void AXI_Interconnect::init() {
   r_arb_rr_idx = 0;
   r_current_master = -1;
-  r_pending.clear();
+  for (int i = 0; i < NUM_READ_SLOTS; i++) {
+    r_pending[i] = {};
+  }
 
   // Clear AR latch
   ar_latched.valid = false;
@@ -31,8 +36,11 @@ void AXI_Interconnect::init() {
   ar_latched.master_id = 0;
   ar_latched.orig_id = 0;
 
+  r_issue_seq = 0;
+
   w_active = false;
   w_current = {};
+  w_outstanding = 0;
   w_req_ready_r = false;
   w_resp_valid = false;
   w_resp_id = 0;
@@ -49,6 +57,8 @@ void AXI_Interconnect::init() {
   // Clear registered req.ready signals
   for (int i = 0; i < NUM_READ_MASTERS; i++) {
     req_ready_r[i] = false;
+    r_pending_cnt[i] = 0;
+    r_resp_slot[i] = -1;
     r_pending_age[i] = 0;
     r_pending_warned[i] = false;
     req_drop_warned[i] = false;
@@ -103,11 +113,6 @@ void AXI_Interconnect::comb_outputs() {
     read_ports[i].req.ready = req_ready_r[i];
   }
 
-  // If AR is latched (waiting for arready), also keep req.ready true
-  if (ar_latched.valid) {
-    read_ports[ar_latched.master_id].req.ready = true;
-  }
-
   // Registered write req.ready (two-phase timing)
   write_port.req.ready = w_req_ready_r;
 }
@@ -151,10 +156,8 @@ void AXI_Interconnect::comb_read_arbiter() {
     axi_io.ar.arsize = ar_latched.size;
     axi_io.ar.arburst = ar_latched.burst;
     axi_io.ar.arid = ar_latched.id;
-    // Also need to keep req.ready=true for the master whose request is latched
-    // so the handshake completes and ICache knows request was accepted
-    read_ports[ar_latched.master_id].req.ready = true;
-    req_ready_r[ar_latched.master_id] = true;
+    // The master already saw ready when the AR was first driven; another
+    // ready pulse now would accept its next request, which has to wait.
     return; // Cannot accept new requests while AR pending
   }
 
@@ -166,14 +169,7 @@ void AXI_Interconnect::comb_read_arbiter() {
     if (!req_ready_curr[i] || !read_ports[i].req.valid) {
       continue;
     }
-    bool has_pending = false;
-    for (const auto &txn : r_pending) {
-      if (txn.master_id == i) {
-        has_pending = true;
-        break;
-      }
-    }
-    if (has_pending) {
+    if (!can_accept_read(i)) {
       continue;
     }
 
@@ -193,17 +189,9 @@ void AXI_Interconnect::comb_read_arbiter() {
     int idx = (r_arb_rr_idx + i) % NUM_READ_MASTERS;
 
     if (read_ports[idx].req.valid) {
-      // Check if this master already has a pending transaction (only one
-      // outstanding per master for correctness with simple masters)
-      bool has_pending = false;
-      for (const auto &txn : r_pending) {
-        if (txn.master_id == idx) {
-          has_pending = true;
-          break;
-        }
-      }
-      if (has_pending) {
-        continue; // Skip, transaction in flight
+      // Respect the per-master depth and keep one transaction per ID
+      if (!can_accept_read(idx)) {
+        continue; // Skip, depth reached or ID in flight
       }
 
       r_current_master = idx;
@@ -235,18 +223,14 @@ void AXI_Interconnect::comb_read_response() {
   }
   axi_io.r.rready = true;
 
-  // Find first complete response for EACH master (not just first overall)
-  bool master_has_resp[NUM_READ_MASTERS] = {false};
-  for (auto &txn : r_pending) {
-    if (txn.beats_done == txn.total_beats) {
-      uint8_t master = txn.master_id;
-      if (!master_has_resp[master]) { // Only first complete per master
-        read_ports[master].resp.valid = true;
-        read_ports[master].resp.data = txn.data;
-        read_ports[master].resp.id = txn.orig_id;
-        master_has_resp[master] = true;
-        // No break - continue to find responses for other masters
-      }
+  // One complete response for EACH master (not just first overall)
+  for (int i = 0; i < NUM_READ_MASTERS; i++) {
+    const int slot = complete_slot(i);
+    r_resp_slot[i] = static_cast<int8_t>(slot);
+    if (slot >= 0) {
+      read_ports[i].resp.valid = true;
+      read_ports[i].resp.data = r_pending[slot].data;
+      read_ports[i].resp.id = r_pending[slot].orig_id;
     }
   }
 }
@@ -277,8 +261,7 @@ void AXI_Interconnect::comb_write_request() {
 
     // Ready-first handshake: raise req.ready one cycle before accepting.
     // write_port.req.ready is driven from w_req_ready_r in comb_outputs().
-    if (!w_active && !w_resp_valid && write_port.req.valid &&
-        !w_req_ready_curr) {
+    if (can_accept_write() && write_port.req.valid && !w_req_ready_curr) {
       w_req_ready_r = true;
     }
   }
@@ -305,8 +288,6 @@ void AXI_Interconnect::comb_write_response() {
 // Sequential Logic
 // ============================================================================
 void AXI_Interconnect::seq() {
-  constexpr uint32_t kPendingTimeout = 100000;
-
   // ========== AR Channel with Latch ==========
 
   // If new AR request and NOT immediately ready, latch it
@@ -325,6 +306,7 @@ void AXI_Interconnect::seq() {
   // AR handshake complete
   if (axi_io.ar.arvalid && axi_io.ar.arready) {
     ReadPendingTxn txn;
+    txn.valid = true;
     if (ar_latched.valid) {
       // Use latched values
       txn.master_id = ar_latched.master_id;
@@ -338,8 +320,11 @@ void AXI_Interconnect::seq() {
       txn.total_beats = axi_io.ar.arlen + 1;
     }
     txn.beats_done = 0;
+    txn.seq = r_issue_seq++;
     txn.data.clear();
-    r_pending.push_back(txn);
+    const uint8_t slot = txn.master_id * READ_IDS_PER_MASTER + txn.orig_id;
+    r_pending[slot] = txn;
+    r_pending_cnt[txn.master_id]++;
     r_arb_rr_idx = (txn.master_id + 1) % NUM_READ_MASTERS;
 
     // req_ready_r is recomputed in comb_read_arbiter.
@@ -347,46 +332,38 @@ void AXI_Interconnect::seq() {
 
   // R handshake
   if (axi_io.r.rvalid && axi_io.r.rready) {
-    uint8_t master = (axi_io.r.rid >> 2) & 0x3;
-    for (auto &txn : r_pending) {
-      if (txn.master_id == master && txn.beats_done < txn.total_beats) {
+    const uint8_t master = (axi_io.r.rid >> 2) & 0x3;
+    const uint8_t slot = master * READ_IDS_PER_MASTER + (axi_io.r.rid & 0x3);
+    if (master < NUM_READ_MASTERS) {
+      ReadPendingTxn &txn = r_pending[slot];
+      if (txn.valid && txn.beats_done < txn.total_beats) {
         txn.data[txn.beats_done] = axi_io.r.rdata;
         txn.beats_done++;
-        break;
       }
     }
   }
 
-  // Response handshake
+  // Response handshake: frees the slot comb_read_response() presented
   for (int i = 0; i < NUM_READ_MASTERS; i++) {
     if (read_ports[i].resp.valid && read_ports[i].resp.ready) {
-      r_pending.erase(std::remove_if(r_pending.begin(), r_pending.end(),
-                                     [i](const ReadPendingTxn &t) {
-                                       return t.master_id == i &&
-                                              t.beats_done == t.total_beats;
-                                     }),
-                      r_pending.end());
+      const int slot = r_resp_slot[i];
+      if (slot >= 0 && r_pending[slot].valid) {
+        r_pending[slot].valid = false;
+        r_pending_cnt[i]--;
+        r_pending_age[i] = 0; // 有进展, 重新计时
+        r_pending_warned[i] = false;
+      }
     }
   }
 
-  // Monitor long-lived pending reads per master.
+  // Monitor masters whose pending reads make no progress.
   for (int i = 0; i < NUM_READ_MASTERS; i++) {
-    bool has_pending = false;
-    int beats_done = 0;
-    int total_beats = 0;
-    for (const auto &txn : r_pending) {
-      if (txn.master_id == i) {
-        has_pending = true;
-        beats_done = txn.beats_done;
-        total_beats = txn.total_beats;
-        break;
-      }
-    }
-    if (has_pending) {
+    if (r_pending_cnt[i] != 0) {
       r_pending_age[i]++;
       if (r_pending_age[i] > kPendingTimeout && !r_pending_warned[i]) {
+        const ReadPendingTxn &txn = r_pending[pending_slot(i)];
         printf("[axi] pending read timeout master=%d beats=%d/%d\n", i,
-               beats_done, total_beats);
+               txn.beats_done, txn.total_beats);
         r_pending_warned[i] = true;
       }
     } else {
@@ -400,6 +377,7 @@ void AXI_Interconnect::seq() {
   // Accept new write request
   if (!w_active && write_port.req.valid && write_port.req.ready) {
     w_active = true;
+    w_outstanding++;
     w_current.master_id = MASTER_DCACHE_W;
     w_current.orig_id = write_port.req.id;
     w_current.addr = write_port.req.addr;
@@ -430,6 +408,7 @@ void AXI_Interconnect::seq() {
     w_current.beats_sent++;
     if (axi_io.w.wlast) {
       w_current.w_done = true;
+      w_active = false; // the B response is tracked by w_outstanding
     }
   }
 
@@ -440,33 +419,233 @@ void AXI_Interconnect::seq() {
     w_resp_resp = axi_io.b.bresp;
   }
 
-  // Upstream response handshake (only one write outstanding is supported)
+  // Upstream response handshake (B responses come back in order)
   if (write_port.resp.valid && write_port.resp.ready) {
     w_resp_valid = false;
-    w_active = false;
-    w_current = {};
+    w_outstanding--;
+  }
+}
+
+// ============================================================================
+// Idle Skipping
+// ============================================================================
+bool AXI_Interconnect::idle() const {
+  if (ar_latched.valid || aw_latched.valid || w_req_ready_r || w_resp_valid) {
+    return false;
+  }
+  if (w_active || (write_port.req.valid && can_accept_write())) {
+    return false;
+  }
+  for (int i = 0; i < NUM_READ_MASTERS; i++) {
+    if (req_ready_r[i]) {
+      return false;
+    }
+  }
+  for (const auto &txn : r_pending) {
+    if (txn.valid && txn.beats_done != 0) {
+      return false;
+    }
+  }
+  for (int i = 0; i < NUM_READ_MASTERS; i++) {
+    if (read_ports[i].req.valid && can_accept_read(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void AXI_Interconnect::skip_cycles(uint64_t cycles) {
+  for (int i = 0; i < NUM_READ_MASTERS; i++) {
+    if (r_pending_cnt[i] == 0) {
+      continue;
+    }
+    const uint64_t age = r_pending_age[i] + cycles;
+    r_pending_age[i] = static_cast<uint32_t>(age);
+    if (age > kPendingTimeout && !r_pending_warned[i]) {
+      const ReadPendingTxn &txn = r_pending[pending_slot(i)];
+      printf("[axi] pending read timeout master=%d beats=%d/%d\n", i,
+             txn.beats_done, txn.total_beats);
+      r_pending_warned[i] = true;
+    }
   }
 }
 
 void AXI_Interconnect::debug_print() {
-  printf("  interconnect: ar_latched=%d r_pending=%zu w_active=%d\n",
-         ar_latched.valid, r_pending.size(), w_active);
+  int pending = 0;
+  for (int i = 0; i < NUM_READ_MASTERS; i++) {
+    pending += r_pending_cnt[i];
+  }
+  printf("  interconnect: ar_latched=%d r_pending=%d w_active=%d "
+         "w_outstanding=%u\n",
+         ar_latched.valid, pending, w_active, w_outstanding);
   if (ar_latched.valid) {
     printf("    ar_latched: master=%u addr=0x%08x len=%u id=0x%02x\n",
            ar_latched.master_id, ar_latched.addr, ar_latched.len,
            ar_latched.id);
   }
-  if (!r_pending.empty()) {
-    for (const auto &txn : r_pending) {
-      printf("    r_pending: master=%u beats=%u/%u\n", txn.master_id,
-             txn.beats_done, txn.total_beats);
+  for (const auto &txn : r_pending) {
+    if (txn.valid) {
+      printf("    r_pending: master=%u id=%u beats=%u/%u\n", txn.master_id,
+             txn.orig_id, txn.beats_done, txn.total_beats);
     }
   }
 }
 
+// ============================================================================
+// Checkpoint
+// ============================================================================
+void AXI_Interconnect::save(CheckpointWriter &out) const {
+  out.put(read_ports);
+  out.put(write_port);
+  out.put(axi_io);
+  out.put(r_arb_rr_idx);
+  out.put(r_current_master);
+  out.put(req_ready_r);
+  out.put(r_pending_age);
+  out.put(r_pending_warned);
+  out.put(req_drop_warned);
+  out.put(w_req_ready_r);
+  out.put(ar_latched);
+  out.put(r_pending);
+  out.put(r_pending_cnt);
+  out.put(r_issue_seq);
+  out.put(r_depth);
+  out.put(r_reorder);
+  out.put(w_active);
+  out.put(w_current);
+  out.put(w_outstanding);
+  out.put(w_depth);
+  out.put(w_resp_valid);
+  out.put(w_resp_id);
+  out.put(w_resp_resp);
+  out.put(aw_latched);
+}
+
+bool AXI_Interconnect::load(CheckpointReader &in) {
+  in.get(read_ports);
+  in.get(write_port);
+  in.get(axi_io);
+  in.get(r_arb_rr_idx);
+  in.get(r_current_master);
+  in.get(req_ready_r);
+  in.get(r_pending_age);
+  in.get(r_pending_warned);
+  in.get(req_drop_warned);
+  in.get(w_req_ready_r);
+  in.get(ar_latched);
+  in.get(r_pending);
+  in.get(r_pending_cnt);
+  in.get(r_issue_seq);
+  in.get(r_depth);
+  in.get(r_reorder);
+  in.get(w_active);
+  in.get(w_current);
+  in.get(w_outstanding);
+  in.get(w_depth);
+  in.get(w_resp_valid);
+  in.get(w_resp_id);
+  in.get(w_resp_resp);
+  in.get(aw_latched);
+  return in.ok() && state_consistent();
+}
+
+bool AXI_Interconnect::state_consistent() const {
+  if (r_depth < 1 || r_depth > MAX_READS_PER_MASTER || w_depth < 1 ||
+      w_depth > MAX_WRITES_OUTSTANDING || w_outstanding > w_depth) {
+    return false;
+  }
+  if (r_arb_rr_idx >= NUM_READ_MASTERS || r_current_master < -1 ||
+      r_current_master >= NUM_READ_MASTERS) {
+    return false;
+  }
+  // seq() 用 master_id/orig_id 拼出 r_pending 下标
+  if (ar_latched.master_id >= NUM_READ_MASTERS ||
+      ar_latched.orig_id >= READ_IDS_PER_MASTER) {
+    return false;
+  }
+
+  uint8_t valid_per_master[NUM_READ_MASTERS] = {};
+  for (int slot = 0; slot < NUM_READ_SLOTS; slot++) {
+    const ReadPendingTxn &txn = r_pending[slot];
+    if (!txn.valid) {
+      continue;
+    }
+    if (txn.master_id != slot / READ_IDS_PER_MASTER ||
+        txn.orig_id != slot % READ_IDS_PER_MASTER || txn.total_beats == 0 ||
+        txn.total_beats > CACHELINE_WORDS ||
+        txn.beats_done > txn.total_beats) {
+      return false;
+    }
+    valid_per_master[txn.master_id]++;
+  }
+  for (int i = 0; i < NUM_READ_MASTERS; i++) {
+    if (r_pending_cnt[i] != valid_per_master[i] || r_pending_cnt[i] > r_depth) {
+      return false;
+    }
+  }
+
+  // comb_write_request() 按 beats_sent 取 wdata 的字
+  if (w_current.total_beats > CACHELINE_WORDS ||
+      w_current.beats_sent > w_current.total_beats ||
+      (w_active && w_current.beats_sent >= w_current.total_beats)) {
+    return false;
+  }
+  return true;
+}
+
 // ============================================================================
 // Helpers
 // ============================================================================
+void AXI_Interconnect::set_read_depth(uint8_t depth) {
+  r_depth = std::clamp<uint8_t>(depth, 1, MAX_READS_PER_MASTER);
+}
+
+void AXI_Interconnect::set_write_depth(uint8_t depth) {
+  w_depth = std::clamp<uint8_t>(depth, 1, MAX_WRITES_OUTSTANDING);
+}
+
+bool AXI_Interconnect::can_accept_read(int master) const {
+  const int slot = master * READ_IDS_PER_MASTER + (read_ports[master].req.id & 0x3);
+  return r_pending_cnt[master] < r_depth && !r_pending[slot].valid;
+}
+
+bool AXI_Interconnect::can_accept_write() const {
+  return !w_active && !w_resp_valid && w_outstanding < w_depth;
+}
+
+int AXI_Interconnect::complete_slot(int master) const {
+  int best = -1;
+  for (int slot = master * READ_IDS_PER_MASTER;
+       slot < (master + 1) * READ_IDS_PER_MASTER; slot++) {
+    const ReadPendingTxn &txn = r_pending[slot];
+    if (!txn.valid) {
+      continue;
+    }
+    if (r_reorder && txn.beats_done != txn.total_beats) {
+      continue;
+    }
+    // Oldest first; seq wraps, so compare the difference
+    if (best < 0 ||
+        static_cast<int32_t>(txn.seq - r_pending[best].seq) < 0) {
+      best = slot;
+    }
+  }
+  if (best >= 0 && r_pending[best].beats_done != r_pending[best].total_beats) {
+    return -1; // in order: the oldest read is not finished yet
+  }
+  return best;
+}
+
+int AXI_Interconnect::pending_slot(int master) const {
+  for (int slot = master * READ_IDS_PER_MASTER;
+       slot < (master + 1) * READ_IDS_PER_MASTER; slot++) {
+    if (r_pending[slot].valid) {
+      return slot;
+    }
+  }
+  return -1;
+}
+
 uint8_t AXI_Interconnect::calc_burst_len(uint8_t total_size) {
   uint8_t bytes = total_size + 1;
   uint8_t beats = (bytes + 3) / 4;
@@ -14,8 +14,9 @@
 #include "AXI_Interconnect_IO.h"
 #include "SimDDR_IO.h"
 #include <config.h>
-#include <queue>
-#include <vector>
+
+class CheckpointWriter;
+class CheckpointReader;
 
 namespace axi_interconnect {
 
@@ -50,10 +51,12 @@ struct AWLatch_t {
 // ============================================================================
 
 struct ReadPendingTxn {
+  bool valid;
   uint8_t master_id;
   uint8_t orig_id;
   uint8_t total_beats;
   uint8_t beats_done;
+  uint32_t seq; // issue order within the interconnect
   WideData256_t data;
 };
 
@@ -87,8 +90,30 @@ public:
 
   void seq();
 
+  // ========== Outstanding Depth ==========
+  // Reads in flight per master (1..MAX_READS_PER_MASTER). Each needs its own
+  // ID: a request whose ID is still pending waits.
+  void set_read_depth(uint8_t depth);
+  // false (default): each master gets its reads back in issue order.
+  // true: a finished read is returned as soon as it completes.
+  void set_read_reorder(bool enable) { r_reorder = enable; }
+  // Writes accepted before their B response (1..MAX_WRITES_OUTSTANDING).
+  // AW/W of one write are sent before the next is accepted.
+  void set_write_depth(uint8_t depth);
+
+  // True when a cycle would only age pending reads: nothing latched, no
+  // ready pulse, no W beat or response to deliver, and every master request
+  // still asserted is already in flight.
+  bool idle() const;
+  // Same state as `cycles` idle cycles.
+  void skip_cycles(uint64_t cycles);
+
   void debug_print();
 
+  // Checkpoint: ports, arbiter state and transactions in flight.
+  void save(CheckpointWriter &out) const;
+  bool load(CheckpointReader &in);
+
   // Upstream IO (Masters)
   ReadMasterPort_t read_ports[NUM_READ_MASTERS];
   WriteMasterPort_t write_port;
@@ -111,12 +136,21 @@ private:
   // AR latch for AXI compliance
   ARLatch_t ar_latched;
 
-  // Pending read transactions
-  std::vector<ReadPendingTxn> r_pending;
-
-  // Write state
+  // Pending read transactions, one slot per AXI ID
+  ReadPendingTxn r_pending[NUM_READ_SLOTS];
+  uint8_t r_pending_cnt[NUM_READ_MASTERS]; // valid slots per master
+  uint32_t r_issue_seq;
+  uint8_t r_depth = MAX_READS_PER_MASTER;
+  bool r_reorder = false;
+  // Slot shown on each master's resp port this cycle (-1: none)
+  int8_t r_resp_slot[NUM_READ_MASTERS];
+
+  // Write state: w_active while AW/W of w_current are being sent;
+  // w_outstanding counts accepted writes not yet answered upstream
   bool w_active;
   WritePendingTxn w_current;
+  uint8_t w_outstanding;
+  uint8_t w_depth = MAX_WRITES_OUTSTANDING;
   bool w_resp_valid;
   uint8_t w_resp_id;
   uint8_t w_resp_resp;
@@ -130,6 +164,16 @@ private:
   void comb_write_response();
 
   uint8_t calc_burst_len(uint8_t total_size);
+  bool can_accept_read(int master) const;
+  bool can_accept_write() const;
+  // Slot whose response `master` gets next, -1 if none is ready: the oldest
+  // pending read if complete, or with reordering the oldest complete one.
+  int complete_slot(int master) const;
+  // First valid slot of `master`, -1 if none.
+  int pending_slot(int master) const;
+  // Checkpoint sanity: indices and counters that seq()/comb use to index
+  // ports and slots are in range and agree with the configured depths.
+  bool state_consistent() const;
 };
 
 } // namespace axi_interconnect
@@ -20,6 +20,12 @@ namespace axi_interconnect {
 constexpr uint8_t NUM_READ_MASTERS = 3;  // icache, dcache, mmu
 constexpr uint8_t NUM_WRITE_MASTERS = 1; // dcache only
 constexpr uint8_t MAX_OUTSTANDING = 8;
+// Read transaction slots, indexed by AXI ID (master << 2 | per-master id)
+constexpr uint8_t READ_IDS_PER_MASTER = 4;
+constexpr uint8_t NUM_READ_SLOTS = NUM_READ_MASTERS * READ_IDS_PER_MASTER;
+// Default outstanding depth: reads per master, writes on the write port
+constexpr uint8_t MAX_READS_PER_MASTER = READ_IDS_PER_MASTER;
+constexpr uint8_t MAX_WRITES_OUTSTANDING = 4;
 constexpr uint8_t CACHELINE_WORDS = 8; // 256-bit = 8 x 32-bit
 
 // Master IDs
@@ -0,0 +1,174 @@
+/**
+ * @file Checkpoint.cpp
+ * @brief Checkpoint file writer (zlib per page) and mmap-based reader.
+ */
+
+#include "Checkpoint.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+
+constexpr uint32_t kPageBytes = PhysicalMemory::kPageBytes;
+
+bool page_is_zero(const uint32_t *words) {
+  for (uint32_t i = 0; i < PhysicalMemory::kPageWords; ++i) {
+    if (words[i] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Read-only mapping of a whole file, unmapped on scope exit.
+struct MappedFile {
+  const uint8_t *data = nullptr;
+  size_t size = 0;
+
+  ~MappedFile() {
+    if (data != nullptr) {
+      munmap(const_cast<uint8_t *>(data), size);
+    }
+  }
+
+  bool open(const char *path) {
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+      ::close(fd);
+      return false;
+    }
+    size = static_cast<size_t>(st.st_size);
+    void *ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED) {
+      size = 0;
+      return false;
+    }
+    madvise(ptr, size, MADV_SEQUENTIAL);
+    data = static_cast<const uint8_t *>(ptr);
+    return true;
+  }
+};
+
+} // namespace
+
+bool checkpoint_write_file(const char *path, const CheckpointWriter &state,
+                           const PhysicalMemory &memory, std::string &error) {
+  FILE *file = std::fopen(path, "wb");
+  if (file == nullptr) {
+    error = std::string("cannot open checkpoint for writing: ") + path;
+    return false;
+  }
+
+  CheckpointHeader header{};
+  std::memcpy(header.magic, kCheckpointMagic, sizeof(header.magic));
+  header.version = kCheckpointVersion;
+  header.page_bytes = kPageBytes;
+  header.state_offset = sizeof(CheckpointHeader);
+  header.state_bytes = state.data().size();
+  header.pages_offset = header.state_offset + header.state_bytes;
+
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+            (state.data().empty() ||
+             std::fwrite(state.data().data(), state.data().size(), 1, file) ==
+                 1);
+
+  std::vector<uint8_t> comp(compressBound(kPageBytes));
+  memory.for_each_page([&](uint32_t page, const uint32_t *words) {
+    if (!ok || page_is_zero(words)) {
+      return;
+    }
+    uLongf comp_len = static_cast<uLongf>(comp.size());
+    CheckpointPageRecord record{page, kPageBytes};
+    const void *payload = words;
+    if (compress2(comp.data(), &comp_len,
+                  reinterpret_cast<const Bytef *>(words), kPageBytes,
+                  Z_BEST_SPEED) == Z_OK &&
+        comp_len < kPageBytes) {
+      record.comp_bytes = static_cast<uint32_t>(comp_len);
+      payload = comp.data();
+    }
+    ok = std::fwrite(&record, sizeof(record), 1, file) == 1 &&
+         std::fwrite(payload, record.comp_bytes, 1, file) == 1;
+    header.page_count++;
+  });
+
+  // The page count is only known at the end; patch it into the header.
+  ok = ok && std::fseek(file, 0, SEEK_SET) == 0 &&
+       std::fwrite(&header, sizeof(header), 1, file) == 1;
+  ok = (std::fclose(file) == 0) && ok;
+  if (!ok) {
+    error = std::string("failed to write checkpoint: ") + path;
+  }
+  return ok;
+}
+
+bool checkpoint_read_file(const char *path, std::vector<uint8_t> &state,
+                          PhysicalMemory &memory, std::string &error) {
+  MappedFile file;
+  if (!file.open(path)) {
+    error = std::string("cannot map checkpoint: ") + path;
+    return false;
+  }
+
+  CheckpointHeader header{};
+  if (file.size < sizeof(header)) {
+    error = "checkpoint truncated";
+    return false;
+  }
+  std::memcpy(&header, file.data, sizeof(header));
+  if (std::memcmp(header.magic, kCheckpointMagic, sizeof(header.magic)) != 0 ||
+      header.version != kCheckpointVersion || header.page_bytes != kPageBytes) {
+    error = "not a compatible checkpoint file";
+    return false;
+  }
+  if (header.state_offset > file.size ||
+      header.state_bytes > file.size - header.state_offset ||
+      header.pages_offset > file.size) {
+    error = "checkpoint truncated";
+    return false;
+  }
+  state.assign(file.data + header.state_offset,
+               file.data + header.state_offset + header.state_bytes);
+
+  memory.clear();
+  size_t offset = static_cast<size_t>(header.pages_offset);
+  for (uint64_t i = 0; i < header.page_count; ++i) {
+    CheckpointPageRecord record{};
+    if (file.size - offset < sizeof(record)) {
+      error = "checkpoint truncated";
+      return false;
+    }
+    std::memcpy(&record, file.data + offset, sizeof(record));
+    offset += sizeof(record);
+    if (record.comp_bytes > kPageBytes ||
+        file.size - offset < record.comp_bytes ||
+        record.page >= (1u << (32 - PhysicalMemory::kPageShift))) {
+      error = "checkpoint page record corrupt";
+      return false;
+    }
+    Bytef *dst = reinterpret_cast<Bytef *>(memory.mutable_page(record.page));
+    if (record.comp_bytes == kPageBytes) {
+      std::memcpy(dst, file.data + offset, kPageBytes);
+    } else {
+      uLongf out_len = kPageBytes;
+      if (uncompress(dst, &out_len, file.data + offset, record.comp_bytes) !=
+              Z_OK ||
+          out_len != kPageBytes) {
+        error = "checkpoint page inflate failed";
+        return false;
+      }
+    }
+    offset += record.comp_bytes;
+  }
+  return true;
+}
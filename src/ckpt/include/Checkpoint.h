@@ -0,0 +1,126 @@
+#pragma once
+/**
+ * @file Checkpoint.h
+ * @brief Checkpoint file format and state (de)serialization helpers.
+ *
+ * File layout (little-endian host order, offsets from the start of file):
+ *
+ *   CheckpointHeader
+ *   state blob      state_bytes, uncompressed (CPU, interconnect, SimDDR, ...)
+ *   page records    page_count x { CheckpointPageRecord, comp_bytes of data }
+ *
+ * Only pages holding non-zero data are stored. Every page is its own zlib
+ * stream (or raw when compression does not help), so the loader maps the file
+ * read-only and inflates page by page straight into simulator memory.
+ */
+
+#include "PhysicalMemory.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+constexpr char kCheckpointMagic[8] = {'S', 'C', 'A', 'X', 'C', 'K', 'P', 'T'};
+constexpr uint32_t kCheckpointVersion = 9;
+
+struct CheckpointHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t page_bytes;
+  uint64_t state_offset;
+  uint64_t state_bytes;
+  uint64_t pages_offset;
+  uint64_t page_count;
+};
+
+struct CheckpointPageRecord {
+  uint32_t page;       // physical page number (paddr >> 12)
+  uint32_t comp_bytes; // == page_bytes: stored raw
+};
+
+// Appends trivially copyable values to the state blob.
+class CheckpointWriter {
+public:
+  template <typename T> void put(const T &value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "checkpoint fields must be trivially copyable");
+    put_bytes(&value, sizeof(T));
+  }
+
+  template <typename T> void put_vector(const std::vector<T> &values) {
+    put(static_cast<uint64_t>(values.size()));
+    for (const T &value : values) {
+      put(value);
+    }
+  }
+
+  void put_bytes(const void *src, size_t len) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(src);
+    data_.insert(data_.end(), bytes, bytes + len);
+  }
+
+  const std::vector<uint8_t> &data() const { return data_; }
+
+private:
+  std::vector<uint8_t> data_;
+};
+
+// Reads the state blob back. A short read latches !ok() and leaves the
+// destination untouched.
+class CheckpointReader {
+public:
+  CheckpointReader(const uint8_t *data, size_t size)
+      : cur_(data), end_(data + size) {}
+
+  template <typename T> bool get(T &value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "checkpoint fields must be trivially copyable");
+    return get_bytes(&value, sizeof(T));
+  }
+
+  template <typename T> bool get_vector(std::vector<T> &values) {
+    uint64_t count = 0;
+    if (!get(count)) {
+      return false;
+    }
+    if (count > static_cast<uint64_t>(end_ - cur_) / sizeof(T)) {
+      ok_ = false;
+      return false;
+    }
+    values.resize(static_cast<size_t>(count));
+    for (T &value : values) {
+      get(value);
+    }
+    return ok_;
+  }
+
+  bool get_bytes(void *dst, size_t len) {
+    if (!ok_ || static_cast<size_t>(end_ - cur_) < len) {
+      ok_ = false;
+      return false;
+    }
+    std::memcpy(dst, cur_, len);
+    cur_ += len;
+    return true;
+  }
+
+  bool ok() const { return ok_; }
+  bool at_end() const { return cur_ == end_; }
+
+private:
+  const uint8_t *cur_;
+  const uint8_t *end_;
+  bool ok_ = true;
+};
+
+// Writes state + non-zero memory pages to path.
+bool checkpoint_write_file(const char *path, const CheckpointWriter &state,
+                           const PhysicalMemory &memory, std::string &error);
+
+// Maps path, copies the state blob out and replaces memory with the stored
+// pages. memory is only touched after the header and state blob validated.
+bool checkpoint_read_file(const char *path, std::vector<uint8_t> &state,
+                          PhysicalMemory &memory, std::string &error);
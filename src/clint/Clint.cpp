@@ -0,0 +1,93 @@
+/**
+ * @file Clint.cpp
+ * @brief CLINT register access, deadline scheduling and checkpointing.
+ */
+
+#include "Clint.h"
+
+#include "Checkpoint.h"
+
+namespace {
+
+uint32_t merge(uint32_t old_word, uint32_t data, uint32_t wstrb) {
+  uint32_t mask = 0;
+  for (uint32_t lane = 0; lane < 4; ++lane) {
+    if (wstrb & (1u << lane)) {
+      mask |= 0xFFu << (lane * 8);
+    }
+  }
+  return (data & mask) | (old_word & ~mask);
+}
+
+uint64_t set_half(uint64_t value, bool high, uint32_t word) {
+  return high ? (value & 0xFFFFFFFFull) | (static_cast<uint64_t>(word) << 32)
+              : (value & ~0xFFFFFFFFull) | word;
+}
+
+} // namespace
+
+void Clint::reset() {
+  msip_ = 0;
+  mtimecmp_ = kNever;
+  offset_ = 0;
+  event_ = kNever;
+}
+
+void Clint::schedule(uint64_t now) {
+  const uint64_t time = mtime(now);
+  if (time >= mtimecmp_) {
+    event_ = kNever; // MTIP 已置位，只有写寄存器才会改变
+    return;
+  }
+  const uint64_t delta = mtimecmp_ - time;
+  event_ = (delta > kNever - now) ? kNever : now + delta;
+}
+
+uint32_t Clint::read32(uint32_t paddr, uint64_t now) const {
+  const uint32_t offset = paddr - kBase;
+  const bool high = (offset & 4u) != 0;
+  if (offset == kMsip) {
+    return msip_;
+  }
+  if ((offset & ~4u) == kMtimecmp) {
+    return static_cast<uint32_t>(high ? mtimecmp_ >> 32 : mtimecmp_);
+  }
+  if ((offset & ~4u) == kMtime) {
+    const uint64_t time = mtime(now);
+    return static_cast<uint32_t>(high ? time >> 32 : time);
+  }
+  return 0;
+}
+
+void Clint::write32(uint32_t paddr, uint32_t data, uint32_t wstrb,
+                    uint64_t now) {
+  const uint32_t offset = paddr - kBase;
+  const bool high = (offset & 4u) != 0;
+  if (offset == kMsip) {
+    msip_ = merge(msip_, data, wstrb) & 1u;
+  } else if ((offset & ~4u) == kMtimecmp) {
+    const auto old_word =
+        static_cast<uint32_t>(high ? mtimecmp_ >> 32 : mtimecmp_);
+    mtimecmp_ = set_half(mtimecmp_, high, merge(old_word, data, wstrb));
+  } else if ((offset & ~4u) == kMtime) {
+    const uint64_t time = mtime(now);
+    const auto old_word = static_cast<uint32_t>(high ? time >> 32 : time);
+    offset_ = set_half(time, high, merge(old_word, data, wstrb)) - now;
+  }
+  schedule(now);
+}
+
+void Clint::save(CheckpointWriter &out) const {
+  out.put(msip_);
+  out.put(mtimecmp_);
+  out.put(offset_);
+  out.put(event_);
+}
+
+bool Clint::load(CheckpointReader &in) {
+  in.get(msip_);
+  in.get(mtimecmp_);
+  in.get(offset_);
+  in.get(event_);
+  return in.ok();
+}
@@ -0,0 +1,68 @@
+#pragma once
+/**
+ * @file Clint.h
+ * @brief Core-local interruptor (SiFive CLINT layout) for a single hart.
+ *
+ * mtime counts simulated cycles: it is kept as an offset from sim_time, so it
+ * costs nothing per cycle and is exact in every timing mode. The timer
+ * interrupt is event driven: each write to mtime or mtimecmp computes the
+ * cycle at which mtime reaches mtimecmp, and the core compares sim_time with
+ * that single deadline instead of evaluating mtime >= mtimecmp every cycle.
+ *
+ * Register map (offsets from kBase, 32-bit accesses):
+ *   0x0000  msip      bit 0 drives MIP.MSIP
+ *   0x4000  mtimecmp  64-bit, low word at the lower address
+ *   0xbff8  mtime     64-bit, writable
+ */
+
+#include <cstdint>
+
+class CheckpointWriter;
+class CheckpointReader;
+
+class Clint {
+public:
+  static constexpr uint32_t kBase = 0x02000000u;
+  static constexpr uint32_t kSize = 0x10000u;
+  static constexpr uint32_t kMsip = 0x0000u;
+  static constexpr uint32_t kMtimecmp = 0x4000u;
+  static constexpr uint32_t kMtime = 0xbff8u;
+  static constexpr uint32_t kMipMsip = 1u << 3;
+  static constexpr uint32_t kMipMtip = 1u << 7;
+  static constexpr uint64_t kNever = UINT64_MAX;
+
+  static bool contains(uint32_t paddr) { return paddr - kBase < kSize; }
+
+  // msip = 0, mtimecmp = all ones (timer off), mtime = sim_time.
+  void reset();
+
+  uint64_t mtime(uint64_t now) const { return now + offset_; }
+  // MIP.MSIP | MIP.MTIP as seen at cycle `now`.
+  uint32_t pending(uint64_t now) const {
+    return ((msip_ & 1u) ? kMipMsip : 0u) |
+           (mtime(now) >= mtimecmp_ ? kMipMtip : 0u);
+  }
+  // First cycle at which pending() changes on its own: the mtimecmp deadline
+  // while MTIP is low, kNever once it is up or the timer is off.
+  uint64_t next_event() const { return event_; }
+  // Re-arms next_event() for cycle `now` and returns pending(now).
+  uint32_t sync(uint64_t now) {
+    schedule(now);
+    return pending(now);
+  }
+
+  // Word access; paddr is word aligned and inside the device.
+  uint32_t read32(uint32_t paddr, uint64_t now) const;
+  void write32(uint32_t paddr, uint32_t data, uint32_t wstrb, uint64_t now);
+
+  void save(CheckpointWriter &out) const;
+  bool load(CheckpointReader &in);
+
+private:
+  void schedule(uint64_t now);
+
+  uint32_t msip_ = 0;
+  uint64_t mtimecmp_ = kNever;
+  uint64_t offset_ = 0; // mtime - sim_time (mod 2^64)
+  uint64_t event_ = kNever;
+};
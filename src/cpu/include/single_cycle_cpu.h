@@ -1,5 +1,9 @@
 #pragma once
+#include "Clint.h"
+
 #include <cstdint>
+#include <unordered_map>
+#include <vector>
 
 #define RISCV_MODE_U 0b00
 #define RISCV_MODE_S 0b01
@@ -73,9 +77,148 @@ typedef struct CPU_state {
   bool store;
 } CPU_state;
 
+// Sv32 leaf translation cached by the software TLB. The raw leaf PTE is kept so
+// permission bits can be re-checked on every hit (privilege, MPRV, SUM and MXR
+// may change without an sfence.vma).
+struct TlbEntry {
+  bool valid;
+  uint16_t asid;
+  uint32_t vpn; // vaddr[31:12] for 4 KiB pages, vaddr[31:22] for superpages
+  uint32_t pte;
+};
+
+struct SoftTlb {
+  static constexpr uint32_t kPageEntries = 64;  // direct-mapped, 4 KiB pages
+  static constexpr uint32_t kSuperEntries = 16; // direct-mapped, 4 MiB pages
+  TlbEntry page[kPageEntries];
+  TlbEntry super[kSuperEntries];
+  uint64_t hit;
+  uint64_t miss;
+};
+
+class SingleCycleCpu;
+class CheckpointWriter;
+class CheckpointReader;
+namespace guest_prof {
+class GuestProfiler;
+}
+
+// Operation kinds produced by SingleCycleCpu::decode_inst(). The order matches
+// SingleCycleCpu::kOpHandlers and the dispatch table in run_fast().
+enum DecodedOp : uint8_t {
+  kOpLui,
+  kOpAuipc,
+  kOpJal,
+  kOpJalr,
+  kOpBeq,
+  kOpBne,
+  kOpBlt,
+  kOpBge,
+  kOpBltu,
+  kOpBgeu,
+  kOpLoad,
+  kOpStore,
+  kOpAddi,
+  kOpSlti,
+  kOpSltiu,
+  kOpXori,
+  kOpOri,
+  kOpAndi,
+  kOpSlli,
+  kOpSrli,
+  kOpSrai,
+  kOpAdd,
+  kOpSub,
+  kOpSll,
+  kOpSlt,
+  kOpSltu,
+  kOpXor,
+  kOpSrl,
+  kOpSra,
+  kOpOr,
+  kOpAnd,
+  kOpMul,
+  kOpMulh,
+  kOpMulhsu,
+  kOpMulhu,
+  kOpDiv,
+  kOpDivu,
+  kOpRem,
+  kOpRemu,
+  kOpSfenceVma,
+  kOpSystem,
+  kOpAmo,
+  kOpZfinx,
+  kOpLegacy,
+  kOpCount,
+};
+
+// Pre-decoded instruction, keyed by the physical address it was fetched from.
+// The raw word is kept as part of the tag so memory written behind the CPU's
+// back (image loads, host pokes) can never execute a stale decode.
+struct DecodedInst {
+  void (SingleCycleCpu::*handler)(const DecodedInst &d);
+  uint32_t paddr;
+  uint32_t inst;
+  uint32_t imm;
+  uint8_t rd;
+  uint8_t rs1;
+  uint8_t rs2;
+  uint8_t funct3;
+  uint8_t op; // DecodedOp
+  bool valid;
+};
+
+// Straight-line run of pre-decoded instructions used by run_fast(). A block
+// never crosses a 4 KiB page and ends after a branch/jump or before any
+// SYSTEM instruction, which is left to the precise exec() path. Memory can
+// change between run_fast() calls without going through store_data() (slave
+// read data mirrored in cycle mode, host writes through sc_sim_get_memory()),
+// so a block is checked against memory once per call before it is reused.
+struct FastOp {
+  const void *target; // threaded-dispatch label for d.op
+  DecodedInst d;
+};
+
+struct FastBlock {
+  static constexpr uint32_t kMaxOps = 32;
+  bool valid;
+  uint32_t paddr;
+  uint32_t n_ops;
+  uint64_t epoch;   // run_fast() call that last matched ops[].d.inst to memory
+  uint64_t retired; // instructions retired from this block (BBV profiling)
+  FastOp ops[kMaxOps];
+};
+
+enum FastExitReason : uint8_t {
+  kFastExitLimit = 0, // instruction budget used up
+  kFastExitEbreak = 1,
+  kFastExitUart = 2, // a byte was written to UART_BASE
+};
+
+enum CpuMemReadResult : uint8_t {
+  CPU_MEM_READ_OK = 0,
+  CPU_MEM_READ_PENDING = 1,
+  CPU_MEM_READ_FAULT = 2,
+};
+
+// Memory interface provided by the embedding runtime. Every hook gets ctx
+// back, so each core talks only to its own simulator instance.
+struct CpuMemHooks {
+  void *ctx = nullptr;
+  // Physical-memory read used by the va2pa page-table walk (supports pending).
+  CpuMemReadResult (*read32)(void *ctx, uint32_t paddr,
+                             uint32_t *data) = nullptr;
+  // Immediate read/write used by instruction/load/store/amo paths.
+  bool (*read32_now)(void *ctx, uint32_t paddr, uint32_t *data) = nullptr;
+  bool (*write32_now)(void *ctx, uint32_t paddr, uint32_t data,
+                      uint32_t wstrb) = nullptr;
+};
+
 class SingleCycleCpu {
 public:
-  uint32_t *memory;
+  CpuMemHooks mem_hooks;
+  long long sim_time = 0; // 本实例的周期计数（时间基准）
   uint32_t Instruction;
   CPU_state state;
   uint8_t privilege;
@@ -97,8 +240,22 @@ public:
 
   bool fast_run = false;
 
+  // CLINT 定时器/软件中断。MIP.MTIP/MSIP 只由它驱动：每条指令前比较一次
+  // sim_time 与 clint.next_event()，寄存器写入后立即刷新。
+  Clint clint;
+  // 上一条指令是 WFI 且当时没有待处理的已使能中断：核可以睡到
+  // clint.next_event()。下一条指令开始时清除。
+  bool wfi_idle = false;
+  void clint_update();
+
+  // 非空时 exec() 把每条执行完的指令报告给 profiler；run_fast() 期间应置空
+  guest_prof::GuestProfiler *profiler = nullptr;
+
   void init(uint32_t reset_pc);
+  void save(CheckpointWriter &out) const;
+  bool load(CheckpointReader &in);
   void exec();
+  void exec_inst();
   void RISCV();
   void RV32IM();
   void RV32A();
@@ -107,6 +264,9 @@ public:
   void exception(uint32_t trap_val);
   void store_data();
   bool va2pa(uint32_t &p_addr, uint32_t v_addr, uint32_t type);
+  bool page_walk(SoftTlb &tlb, uint32_t &p_addr, uint32_t v_addr,
+                 uint32_t type, uint32_t asid, int eff_priv, bool mxr,
+                 bool sum);
 
   bool is_br;
   bool br_taken;
@@ -123,20 +283,107 @@ public:
   void ptw_cache_fill(uint32_t paddr, uint32_t data);
   void ptw_cache_invalidate_word(uint32_t paddr);
   void ptw_cache_flush();
-};
 
-enum CpuMemReadResult : uint8_t {
-  CPU_MEM_READ_OK = 0,
-  CPU_MEM_READ_PENDING = 1,
-  CPU_MEM_READ_FAULT = 2,
-};
+  // Split I/D TLBs in front of va2pa(). Flushed on satp writes and sfence.vma;
+  // stores that may hit a page table backing a cached entry flush them too.
+  static constexpr uint32_t kTlbPteFilterBits = 4096;
+  SoftTlb itlb;
+  SoftTlb dtlb;
+  uint64_t tlb_flush_count;
+  uint64_t tlb_pte_filter[kTlbPteFilterBits / 64];
+  void tlb_reset();
+  bool tlb_lookup(SoftTlb &tlb, uint32_t v_addr, uint32_t asid, uint32_t &pte,
+                  bool &superpage);
+  void tlb_fill(SoftTlb &tlb, uint32_t v_addr, uint32_t asid, uint32_t pte,
+                bool superpage, uint32_t pte1_addr, uint32_t pte2_addr);
+  void tlb_flush(bool match_vaddr, uint32_t v_addr, bool match_asid,
+                 uint32_t asid);
+  void tlb_flush_all();
+  void tlb_snoop_store(uint32_t paddr);
+  void sfence_vma();
+
+  // Decoded-instruction cache (direct-mapped on the fetch physical address).
+  // RISCV() dispatches through it; store_data() drops entries it overwrites.
+  static constexpr uint32_t kDecodeCacheSize = 4096;
+  uint32_t inst_paddr;
+  DecodedInst decode_cache[kDecodeCacheSize];
+  void decode_cache_reset();
+  const DecodedInst &decode_cache_lookup(uint32_t paddr, uint32_t inst);
+  void decode_cache_invalidate_word(uint32_t paddr);
+  static void decode_inst(uint32_t inst, DecodedInst &d);
+  static void (SingleCycleCpu::*const kOpHandlers[kOpCount])(
+      const DecodedInst &d);
 
-// Physical-memory read hook used by va2pa page-table walk (supports pending).
-extern CpuMemReadResult (*g_cpu_mem_read32_hook)(uint32_t paddr,
-                                                  uint32_t *data);
+  // Functional fast mode: runs up to max_inst instructions from cached basic
+  // blocks without touching the AXI model, advancing sim_time one cycle per
+  // instruction. Page-table walks read memory directly while it runs.
+  static constexpr uint32_t kFastBlockCount = 1024;
+  std::vector<FastBlock> fast_blocks;
+  std::vector<uint64_t> fast_code_pages; // one bit per physical 4 KiB page
+  uint64_t fast_epoch = 0;               // bumped on every run_fast() call
+  bool ptw_direct = false;
+  bool fast_block_break = false;
+  bool fast_uart_valid = false;
+  uint8_t fast_uart_ch = 0;
+  uint8_t fast_exit_reason = kFastExitLimit;
+  uint64_t run_fast(uint64_t max_inst);
+  FastBlock *fast_block_lookup(uint32_t paddr, const void *const *labels);
+  bool fast_block_matches_memory(const FastBlock &block);
+  void fast_block_invalidate_word(uint32_t paddr);
+  void fast_block_reset();
+  void fast_block_retire(FastBlock &block);
+  void update_interrupts();
 
-// Immediate read/write hooks used by instruction/load/store/amo paths.
-// These hooks must be provided by the embedding runtime.
-extern bool (*g_cpu_mem_read32_now_hook)(uint32_t paddr, uint32_t *data);
-extern bool (*g_cpu_mem_write32_now_hook)(uint32_t paddr, uint32_t data,
-                                          uint32_t wstrb);
+  // Basic-block vector profiling for sampled simulation. Blocks count their
+  // own retired instructions; while bbv_enabled a count moves to bbv_spill
+  // when its slot is refilled or invalidated, and bbv_take() collects both.
+  // Keys are block start physical addresses.
+  bool bbv_enabled = false;
+  std::unordered_map<uint32_t, uint64_t> bbv_spill;
+  void bbv_take(std::unordered_map<uint32_t, uint64_t> &out);
+
+  void op_lui(const DecodedInst &d);
+  void op_auipc(const DecodedInst &d);
+  void op_jal(const DecodedInst &d);
+  void op_jalr(const DecodedInst &d);
+  void op_beq(const DecodedInst &d);
+  void op_bne(const DecodedInst &d);
+  void op_blt(const DecodedInst &d);
+  void op_bge(const DecodedInst &d);
+  void op_bltu(const DecodedInst &d);
+  void op_bgeu(const DecodedInst &d);
+  void op_load(const DecodedInst &d);
+  void op_store(const DecodedInst &d);
+  void op_addi(const DecodedInst &d);
+  void op_slti(const DecodedInst &d);
+  void op_sltiu(const DecodedInst &d);
+  void op_xori(const DecodedInst &d);
+  void op_ori(const DecodedInst &d);
+  void op_andi(const DecodedInst &d);
+  void op_slli(const DecodedInst &d);
+  void op_srli(const DecodedInst &d);
+  void op_srai(const DecodedInst &d);
+  void op_add(const DecodedInst &d);
+  void op_sub(const DecodedInst &d);
+  void op_sll(const DecodedInst &d);
+  void op_slt(const DecodedInst &d);
+  void op_sltu(const DecodedInst &d);
+  void op_xor(const DecodedInst &d);
+  void op_srl(const DecodedInst &d);
+  void op_sra(const DecodedInst &d);
+  void op_or(const DecodedInst &d);
+  void op_and(const DecodedInst &d);
+  void op_mul(const DecodedInst &d);
+  void op_mulh(const DecodedInst &d);
+  void op_mulhsu(const DecodedInst &d);
+  void op_mulhu(const DecodedInst &d);
+  void op_div(const DecodedInst &d);
+  void op_divu(const DecodedInst &d);
+  void op_rem(const DecodedInst &d);
+  void op_remu(const DecodedInst &d);
+  void op_sfence_vma(const DecodedInst &d);
+  void op_system(const DecodedInst &d);
+  void op_amo(const DecodedInst &d);
+  void op_zfinx(const DecodedInst &d);
+  void op_legacy(const DecodedInst &d);
+};
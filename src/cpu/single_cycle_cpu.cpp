@@ -1,45 +1,56 @@
 #include "single_cycle_cpu.h"
 #include "CSR.h"
+#include "Checkpoint.h"
+#include "GuestProfiler.h"
 #include "RISCV.h"
-#include "SimCpu.h"
 #include "config.h"
 #include <cstdint>
 #include <iostream>
+#include <mutex>
 extern "C" {
 #include "softfloat.h"
 }
 
-CpuMemReadResult (*g_cpu_mem_read32_hook)(uint32_t paddr, uint32_t *data) =
-    nullptr;
-bool (*g_cpu_mem_read32_now_hook)(uint32_t paddr, uint32_t *data) = nullptr;
-bool (*g_cpu_mem_write32_now_hook)(uint32_t paddr, uint32_t data,
-                                   uint32_t wstrb) = nullptr;
+// softfloat 的舍入模式与异常标志是进程级全局变量（预编译库未开 THREAD_LOCAL），
+// 不同线程上的句柄同时执行浮点指令时必须串行。
+static std::mutex softfloat_mutex;
 
-static inline CpuMemReadResult cpu_phys_read32(uint32_t *memory, uint32_t paddr,
-                                               uint32_t *data) {
-  if (data == nullptr) {
-    return CPU_MEM_READ_FAULT;
-  }
-  (void)memory;
-  if (g_cpu_mem_read32_hook == nullptr) {
+// 早期镜像轮询的计时器地址（CLINT 之前的约定），读出 mtime 低 32 位，高字为 0
+static constexpr uint32_t kLegacyTimerAddr = 0x1fd0e000u;
+
+static inline CpuMemReadResult cpu_phys_read32(const CpuMemHooks &hooks,
+                                               uint32_t paddr, uint32_t *data) {
+  if (data == nullptr || hooks.read32 == nullptr) {
     return CPU_MEM_READ_FAULT;
   }
-  return g_cpu_mem_read32_hook(paddr, data);
+  return hooks.read32(hooks.ctx, paddr, data);
 }
 
-static inline bool cpu_mem_read32_now(uint32_t paddr, uint32_t *data) {
-  if (data == nullptr || g_cpu_mem_read32_now_hook == nullptr) {
+static inline bool cpu_mem_read32_now(const CpuMemHooks &hooks, uint32_t paddr,
+                                      uint32_t *data) {
+  if (data == nullptr || hooks.read32_now == nullptr) {
     return false;
   }
-  return g_cpu_mem_read32_now_hook(paddr, data);
+  return hooks.read32_now(hooks.ctx, paddr, data);
 }
 
-static inline bool cpu_mem_write32_now(uint32_t paddr, uint32_t data,
-                                       uint32_t wstrb) {
-  if (g_cpu_mem_write32_now_hook == nullptr) {
+static inline bool cpu_mem_write32_now(const CpuMemHooks &hooks, uint32_t paddr,
+                                       uint32_t data, uint32_t wstrb) {
+  if (hooks.write32_now == nullptr) {
     return false;
   }
-  return g_cpu_mem_write32_now_hook(paddr, data, wstrb);
+  return hooks.write32_now(hooks.ctx, paddr, data, wstrb);
+}
+
+// Fast mode walks page tables with immediate reads instead of the MMU port.
+static inline CpuMemReadResult cpu_ptw_read32(const CpuMemHooks &hooks,
+                                              bool direct, uint32_t paddr,
+                                              uint32_t *data) {
+  if (direct) {
+    return cpu_mem_read32_now(hooks, paddr, data) ? CPU_MEM_READ_OK
+                                                  : CPU_MEM_READ_FAULT;
+  }
+  return cpu_phys_read32(hooks, paddr, data);
 }
 
 static inline uint32_t ptw_cache_index(uint32_t paddr) {
@@ -85,6 +96,125 @@ void SingleCycleCpu::ptw_cache_invalidate_word(uint32_t paddr) {
 
 void SingleCycleCpu::ptw_cache_flush() { ptw_cache_reset(); }
 
+static inline uint32_t tlb_pte_filter_index(uint32_t paddr) {
+  return (paddr >> 12) & (SingleCycleCpu::kTlbPteFilterBits - 1);
+}
+
+static inline void tlb_entry_clear(TlbEntry &entry) {
+  entry.valid = false;
+  entry.asid = 0;
+  entry.vpn = 0;
+  entry.pte = 0;
+}
+
+void SingleCycleCpu::tlb_reset() {
+  for (SoftTlb *tlb : {&itlb, &dtlb}) {
+    for (uint32_t i = 0; i < SoftTlb::kPageEntries; ++i) {
+      tlb_entry_clear(tlb->page[i]);
+    }
+    for (uint32_t i = 0; i < SoftTlb::kSuperEntries; ++i) {
+      tlb_entry_clear(tlb->super[i]);
+    }
+    tlb->hit = 0;
+    tlb->miss = 0;
+  }
+  tlb_flush_count = 0;
+  for (uint64_t &word : tlb_pte_filter) {
+    word = 0;
+  }
+}
+
+bool SingleCycleCpu::tlb_lookup(SoftTlb &tlb, uint32_t v_addr, uint32_t asid,
+                                uint32_t &pte, bool &superpage) {
+  const uint32_t vpn = v_addr >> 12;
+  const TlbEntry &page = tlb.page[vpn & (SoftTlb::kPageEntries - 1)];
+  if (page.valid && page.vpn == vpn &&
+      ((page.pte & PTE_G) || page.asid == asid)) {
+    pte = page.pte;
+    superpage = false;
+    tlb.hit++;
+    return true;
+  }
+
+  const uint32_t vpn1 = v_addr >> 22;
+  const TlbEntry &super = tlb.super[vpn1 & (SoftTlb::kSuperEntries - 1)];
+  if (super.valid && super.vpn == vpn1 &&
+      ((super.pte & PTE_G) || super.asid == asid)) {
+    pte = super.pte;
+    superpage = true;
+    tlb.hit++;
+    return true;
+  }
+
+  return false;
+}
+
+void SingleCycleCpu::tlb_fill(SoftTlb &tlb, uint32_t v_addr, uint32_t asid,
+                              uint32_t pte, bool superpage, uint32_t pte1_addr,
+                              uint32_t pte2_addr) {
+  TlbEntry &entry =
+      superpage ? tlb.super[(v_addr >> 22) & (SoftTlb::kSuperEntries - 1)]
+                : tlb.page[(v_addr >> 12) & (SoftTlb::kPageEntries - 1)];
+  entry.valid = true;
+  entry.asid = static_cast<uint16_t>(asid);
+  entry.vpn = superpage ? (v_addr >> 22) : (v_addr >> 12);
+  entry.pte = pte;
+
+  // Remember which page-table pages back this entry so a store into them
+  // drops the cached translation, like the PTW word cache does.
+  for (uint32_t addr : {pte1_addr, pte2_addr}) {
+    const uint32_t idx = tlb_pte_filter_index(addr);
+    tlb_pte_filter[idx >> 6] |= (1ull << (idx & 63));
+  }
+}
+
+void SingleCycleCpu::tlb_flush(bool match_vaddr, uint32_t v_addr,
+                               bool match_asid, uint32_t asid) {
+  tlb_flush_count++;
+  for (SoftTlb *tlb : {&itlb, &dtlb}) {
+    auto flush_entry = [&](TlbEntry &entry, bool vaddr_hit) {
+      if (!entry.valid) {
+        return;
+      }
+      if (match_vaddr && !vaddr_hit) {
+        return;
+      }
+      // Global mappings survive an ASID-qualified sfence.vma.
+      if (match_asid && ((entry.pte & PTE_G) || entry.asid != asid)) {
+        return;
+      }
+      entry.valid = false;
+    };
+    for (uint32_t i = 0; i < SoftTlb::kPageEntries; ++i) {
+      flush_entry(tlb->page[i], tlb->page[i].vpn == (v_addr >> 12));
+    }
+    for (uint32_t i = 0; i < SoftTlb::kSuperEntries; ++i) {
+      flush_entry(tlb->super[i], tlb->super[i].vpn == (v_addr >> 22));
+    }
+  }
+  if (!match_vaddr && !match_asid) {
+    for (uint64_t &word : tlb_pte_filter) {
+      word = 0;
+    }
+  }
+}
+
+void SingleCycleCpu::tlb_flush_all() { tlb_flush(false, 0, false, 0); }
+
+void SingleCycleCpu::tlb_snoop_store(uint32_t paddr) {
+  const uint32_t idx = tlb_pte_filter_index(paddr);
+  if (tlb_pte_filter[idx >> 6] & (1ull << (idx & 63))) {
+    tlb_flush_all();
+  }
+}
+
+void SingleCycleCpu::sfence_vma() {
+  const uint32_t rs1 = BITS(Instruction, 19, 15);
+  const uint32_t rs2 = BITS(Instruction, 24, 20);
+  tlb_flush(rs1 != 0, state.gpr[rs1], rs2 != 0, state.gpr[rs2] & 0x1ff);
+  state.pc += 4;
+}
+
 // ---------------- 辅助工具 ----------------
 static inline float32_t to_f32(uint32_t v) {
   float32_t f;
@@ -213,7 +343,6 @@ uint32_t f32_classify(float32_t f) {
 
 void SingleCycleCpu::init(uint32_t reset_pc) {
   state.pc = reset_pc;
-  memory = nullptr;
   for (int i = 0; i < 32; i++) {
     state.gpr[i] = 0;
   }
@@ -229,15 +358,121 @@ void SingleCycleCpu::init(uint32_t reset_pc) {
   page_fault_load = false;
   page_fault_store = false;
   translation_pending = false;
+  inst_paddr = reset_pc;
+  clint.reset();
+  wfi_idle = false;
   ptw_cache_reset();
+  tlb_reset();
+  decode_cache_reset();
+  fast_block_reset();
+  bbv_spill.clear();
+}
+
+// Architectural state plus the PTW cache and TLBs (their hits decide whether
+// the cycle model issues page-walk reads). Decode and block caches are rebuilt.
+void SingleCycleCpu::save(CheckpointWriter &out) const {
+  out.put(sim_time);
+  out.put(Instruction);
+  out.put(state);
+  out.put(privilege);
+  out.put(asy);
+  out.put(page_fault_inst);
+  out.put(page_fault_load);
+  out.put(page_fault_store);
+  out.put(illegal_exception);
+  out.put(translation_pending);
+  out.put(M_software_interrupt);
+  out.put(M_timer_interrupt);
+  out.put(M_external_interrupt);
+  out.put(S_software_interrupt);
+  out.put(S_timer_interrupt);
+  out.put(S_external_interrupt);
+  out.put(sim_end);
+  out.put(is_br);
+  out.put(br_taken);
+  out.put(is_csr);
+  out.put(is_exception);
+  out.put(ptw_cache_tag);
+  out.put(ptw_cache_data);
+  out.put(ptw_cache_valid);
+  out.put(itlb);
+  out.put(dtlb);
+  out.put(tlb_flush_count);
+  out.put(tlb_pte_filter);
+  out.put(inst_paddr);
+  clint.save(out);
+  out.put(wfi_idle);
+}
+
+bool SingleCycleCpu::load(CheckpointReader &in) {
+  in.get(sim_time);
+  in.get(Instruction);
+  in.get(state);
+  in.get(privilege);
+  in.get(asy);
+  in.get(page_fault_inst);
+  in.get(page_fault_load);
+  in.get(page_fault_store);
+  in.get(illegal_exception);
+  in.get(translation_pending);
+  in.get(M_software_interrupt);
+  in.get(M_timer_interrupt);
+  in.get(M_external_interrupt);
+  in.get(S_software_interrupt);
+  in.get(S_timer_interrupt);
+  in.get(S_external_interrupt);
+  in.get(sim_end);
+  in.get(is_br);
+  in.get(br_taken);
+  in.get(is_csr);
+  in.get(is_exception);
+  in.get(ptw_cache_tag);
+  in.get(ptw_cache_data);
+  in.get(ptw_cache_valid);
+  in.get(itlb);
+  in.get(dtlb);
+  in.get(tlb_flush_count);
+  in.get(tlb_pte_filter);
+  in.get(inst_paddr);
+  clint.load(in);
+  in.get(wfi_idle);
+  fast_run = false;
+  ptw_direct = false;
+  decode_cache_reset();
+  fast_block_reset();
+  bbv_spill.clear();
+  return in.ok();
 }
 
 void SingleCycleCpu::exec() {
+  if (profiler == nullptr) {
+    exec_inst();
+    return;
+  }
+  const uint32_t pc = state.pc;
+  exec_inst();
+  if (!translation_pending) {
+    profiler->on_exec(pc, page_fault_inst ? 0u : Instruction, is_exception,
+                      static_cast<uint64_t>(sim_time));
+  }
+}
+
+void SingleCycleCpu::clint_update() {
+  const uint32_t bits = clint.sync(static_cast<uint64_t>(sim_time));
+  state.csr[csr_mip] =
+      (state.csr[csr_mip] & ~static_cast<uint32_t>(MIP_MSIP | MIP_MTIP)) | bits;
+}
+
+void SingleCycleCpu::exec_inst() {
   is_csr = is_exception = is_br = br_taken = false;
   illegal_exception = page_fault_load = page_fault_inst = page_fault_store =
       asy = false;
   translation_pending = false;
+  wfi_idle = false;
   state.store = false;
+  if (static_cast<uint64_t>(sim_time) >= clint.next_event()) {
+    clint_update();
+  }
 
   uint32_t p_addr = state.pc;
 
@@ -254,12 +489,14 @@ void SingleCycleCpu::exec() {
     }
   }
 
-  if (!cpu_mem_read32_now(p_addr, &Instruction)) {
+  if (!cpu_mem_read32_now(mem_hooks, p_addr, &Instruction)) {
     illegal_exception = true;
     exception(state.pc);
     return;
   }
 
+  inst_paddr = p_addr;
+
   if (Instruction == INST_EBREAK) {
     state.pc += 4;
     if (fast_run) {
@@ -481,35 +718,16 @@ void SingleCycleCpu::exception(uint32_t trap_val) {
   state.pc = next_pc;
 }
 
-void SingleCycleCpu::RISCV() {
-  // === 优化 1: 极速解码 ===
-  // 使用 BITS 宏直接提取字段，完全替代 bool 数组操作
-  uint32_t opcode = BITS(Instruction, 6, 0);
-
-  bool ecall = (Instruction == INST_ECALL);
-  bool mret = (Instruction == INST_MRET);
-  bool sret = (Instruction == INST_SRET);
-
-  // === 优化 2: 快速读取 CSR 状态 ===
+// 根据 mip/mie/mideleg 与当前特权级计算六条中断线 (RISCV() 与 run_fast() 共用)
+void SingleCycleCpu::update_interrupts() {
   uint32_t mstatus = state.csr[csr_mstatus];
   uint32_t mie_reg = state.csr[csr_mie];
   uint32_t mip_reg = state.csr[csr_mip];
   uint32_t mideleg = state.csr[csr_mideleg];
-  uint32_t medeleg = state.csr[csr_medeleg];
 
-  // 提取关键位
   bool mstatus_mie = (mstatus & MSTATUS_MIE) != 0;
   bool mstatus_sie = (mstatus & MSTATUS_SIE) != 0;
 
-  // 异常委托位 (Exceptions)
-  bool medeleg_U_ecall = (medeleg >> 8) & 1;
-  bool medeleg_S_ecall = (medeleg >> 9) & 1;
-  // bool medeleg_M_ecall = (medeleg >> 11) & 1; // 通常M-ecall不委托
-
-  bool medeleg_page_fault_inst = (medeleg >> 12) & 1;
-  bool medeleg_page_fault_load = (medeleg >> 13) & 1;
-  bool medeleg_page_fault_store = (medeleg >> 15) & 1;
-
   // === 优化 3: 中断判断逻辑 (位运算) ===
   // M-mode 中断条件:Pending & Enabled & NotDelegated & (CurrentPriv < M ||
   // MIE=1)
@@ -546,6 +764,26 @@ void SingleCycleCpu::RISCV() {
       (((mip_reg & MIP_MEIP) && (mie_reg & MIP_MEIP) && (mideleg & MIP_MEIP)) ||
        ((mip_reg & MIP_SEIP) && (mie_reg & MIP_SEIP))) &&
       (privilege < 2 && s_irq_enable);
+}
+
+void SingleCycleCpu::RISCV() {
+  bool ecall = (Instruction == INST_ECALL);
+  bool mret = (Instruction == INST_MRET);
+  bool sret = (Instruction == INST_SRET);
+
+  // === 优化 2: 快速读取 CSR 状态 ===
+  uint32_t medeleg = state.csr[csr_medeleg];
+
+  // 异常委托位 (Exceptions)
+  bool medeleg_U_ecall = (medeleg >> 8) & 1;
+  bool medeleg_S_ecall = (medeleg >> 9) & 1;
+  // bool medeleg_M_ecall = (medeleg >> 11) & 1; // 通常M-ecall不委托
+
+  bool medeleg_page_fault_inst = (medeleg >> 12) & 1;
+  bool medeleg_page_fault_load = (medeleg >> 13) & 1;
+  bool medeleg_page_fault_store = (medeleg >> 15) & 1;
+
+  update_interrupts();
 
   // Trap 判断
   bool MTrap =
@@ -563,37 +801,20 @@ void SingleCycleCpu::RISCV() {
 
   asy = MTrap || STrap || mret || sret;
 
-  // WFI 检查 (简单处理)
-  if (Instruction == INST_WFI && !asy && !page_fault_inst && !page_fault_load &&
-      !page_fault_store) {
-    std::cout << " WFI " << std::endl;
-    exit(1);
-  }
-
   if (page_fault_inst) {
     exception(state.pc);
   } else if (illegal_exception) {
     exception(Instruction);
   } else if (asy || Instruction == INST_ECALL) {
     exception(0);
-  } else if (opcode == number_10_opcode_ecall) {
-    // SYSTEM 指令 (CSR, WFI, MRET等)
-    if (Instruction == INST_WFI) {
-      is_csr = false;
-    } else {
-      is_csr = true;
-    }
-    RV32CSR();
-  } else if (opcode == number_11_opcode_lrw) {
-    RV32A();
-  } else if (opcode == number_12_opcode_float ||
-             opcode == number_13_opcode_fmadd ||
-             opcode == number_15_opcode_fnmsub ||
-             opcode == number_16_opcode_fnmadd ||
-             opcode == number_14_opcode_fmsub) {
-    RV32Zfinx();
+  } else if (Instruction == INST_WFI) {
+    // WFI 按 NOP 退休；没有待处理中断时通知外层可以跳到下一个定时器事件
+    wfi_idle = (state.csr[csr_mip] & state.csr[csr_mie]) == 0;
+    state.pc += 4;
   } else {
-    RV32IM();
+    // 译码结果按物理 PC 缓存，热循环中不再重复解码
+    const DecodedInst &d = decode_cache_lookup(inst_paddr, Instruction);
+    (this->*d.handler)(d);
   }
   state.gpr[0] = 0;
 }
@@ -614,6 +835,8 @@ void SingleCycleCpu::RV32Zfinx() {
   uint32_t val_rs2 = state.gpr[rs2];
   uint32_t val_rs3 = state.gpr[rs3]; // 仅用于 FMADD 等指令
 
+  std::lock_guard<std::mutex> softfloat_lock(softfloat_mutex);
+
   // 2. 处理舍入模式 (RM)
   // RISC-V RM 编码: 0=RNE, 1=RTZ, 2=RDN, 3=RUP, 4=RMM, 7=DYN
   uint8_t rm = funct3;
@@ -855,9 +1078,15 @@ void SingleCycleCpu::RV32CSR() {
       csr_addr != number_timeh) {
     ;
   } else if (csr_addr == number_time || csr_addr == number_timeh) {
-    illegal_exception = true;
-    exception(Instruction);
-    return;
+    // 只读计数器，读 CLINT 的 mtime
+    if (we) {
+      illegal_exception = true;
+      exception(Instruction);
+      return;
+    }
+    const uint64_t time = clint.mtime(static_cast<uint64_t>(sim_time));
+    state.gpr[rd] = static_cast<uint32_t>(
+        csr_addr == number_timeh ? time >> 32 : time);
   } else {
 
     int csr_idx = cvt_number_to_csr(csr_addr);
@@ -913,6 +1142,11 @@ void SingleCycleCpu::RV32CSR() {
         state.csr[csr_idx] = csr_wdata;
         if (csr_idx == csr_satp) {
           ptw_cache_flush();
+          tlb_flush_all();
+        }
+        if (csr_idx == csr_mip) {
+          // MTIP/MSIP 只读，由 CLINT 驱动
+          clint_update();
         }
       }
     }
@@ -968,7 +1202,7 @@ void SingleCycleCpu::RV32A() {
   }
 
   uint32_t old_word = 0;
-  if (!cpu_mem_read32_now(p_addr, &old_word)) {
+  if (!cpu_mem_read32_now(mem_hooks, p_addr, &old_word)) {
     illegal_exception = true;
     exception(v_addr);
     return;
@@ -1145,11 +1379,14 @@ void SingleCycleCpu::RV32IM() {
 
     } else {
       uint32_t data = 0;
-      if (!cpu_mem_read32_now(p_addr, &data)) {
+      if (!cpu_mem_read32_now(mem_hooks, p_addr, &data)) {
         illegal_exception = true;
         exception(v_addr);
         return;
       }
+      if (Clint::contains(p_addr)) {
+        data = clint.read32(p_addr & ~0x3u, static_cast<uint64_t>(sim_time));
+      }
       uint32_t offset = p_addr & 0b11;
       uint32_t size = funct3 & 0b11;
       uint32_t sign = 0, mask;
@@ -1173,10 +1410,12 @@ void SingleCycleCpu::RV32IM() {
         data = data | sign;
       }
 
-      if (p_addr == 0x1fd0e000) {
-        data = sim_time;
+      // 旧镜像使用的计时器地址，读 CLINT mtime 的低 32 位
+      if (p_addr == kLegacyTimerAddr) {
+        data = static_cast<uint32_t>(
+            clint.mtime(static_cast<uint64_t>(sim_time)));
       }
-      if (p_addr == 0x1fd0e004) {
+      if (p_addr == kLegacyTimerAddr + 4) {
         data = 0;
       }
 
@@ -1408,6 +1647,665 @@ void SingleCycleCpu::RV32IM() {
   state.pc = next_pc;
 }
 
+// ---------------- 译码缓存 (Decoded-instruction cache) ----------------
+static inline uint32_t decode_cache_index(uint32_t paddr) {
+  return (paddr >> 2) & (SingleCycleCpu::kDecodeCacheSize - 1);
+}
+
+void SingleCycleCpu::decode_cache_reset() {
+  for (uint32_t i = 0; i < kDecodeCacheSize; ++i) {
+    decode_cache[i] = {};
+  }
+}
+
+const DecodedInst &SingleCycleCpu::decode_cache_lookup(uint32_t paddr,
+                                                       uint32_t inst) {
+  DecodedInst &d = decode_cache[decode_cache_index(paddr)];
+  if (!d.valid || d.paddr != paddr || d.inst != inst) {
+    decode_inst(inst, d);
+    d.paddr = paddr;
+    d.valid = true;
+  }
+  return d;
+}
+
+void SingleCycleCpu::decode_cache_invalidate_word(uint32_t paddr) {
+  const uint32_t aligned = paddr & ~0x3u;
+  DecodedInst &d = decode_cache[decode_cache_index(aligned)];
+  if (d.valid && d.paddr == aligned) {
+    d.valid = false;
+  }
+}
+
+void (SingleCycleCpu::*const SingleCycleCpu::kOpHandlers[kOpCount])(
+    const DecodedInst &d) = {
+    &SingleCycleCpu::op_lui,        &SingleCycleCpu::op_auipc,
+    &SingleCycleCpu::op_jal,        &SingleCycleCpu::op_jalr,
+    &SingleCycleCpu::op_beq,        &SingleCycleCpu::op_bne,
+    &SingleCycleCpu::op_blt,        &SingleCycleCpu::op_bge,
+    &SingleCycleCpu::op_bltu,       &SingleCycleCpu::op_bgeu,
+    &SingleCycleCpu::op_load,       &SingleCycleCpu::op_store,
+    &SingleCycleCpu::op_addi,       &SingleCycleCpu::op_slti,
+    &SingleCycleCpu::op_sltiu,      &SingleCycleCpu::op_xori,
+    &SingleCycleCpu::op_ori,        &SingleCycleCpu::op_andi,
+    &SingleCycleCpu::op_slli,       &SingleCycleCpu::op_srli,
+    &SingleCycleCpu::op_srai,       &SingleCycleCpu::op_add,
+    &SingleCycleCpu::op_sub,        &SingleCycleCpu::op_sll,
+    &SingleCycleCpu::op_slt,        &SingleCycleCpu::op_sltu,
+    &SingleCycleCpu::op_xor,        &SingleCycleCpu::op_srl,
+    &SingleCycleCpu::op_sra,        &SingleCycleCpu::op_or,
+    &SingleCycleCpu::op_and,        &SingleCycleCpu::op_mul,
+    &SingleCycleCpu::op_mulh,       &SingleCycleCpu::op_mulhsu,
+    &SingleCycleCpu::op_mulhu,      &SingleCycleCpu::op_div,
+    &SingleCycleCpu::op_divu,       &SingleCycleCpu::op_rem,
+    &SingleCycleCpu::op_remu,       &SingleCycleCpu::op_sfence_vma,
+    &SingleCycleCpu::op_system,     &SingleCycleCpu::op_amo,
+    &SingleCycleCpu::op_zfinx,      &SingleCycleCpu::op_legacy,
+};
+
+void SingleCycleCpu::decode_inst(uint32_t inst, DecodedInst &d) {
+  static const uint8_t kBranchOps[8] = {kOpBeq,    kOpBne, kOpLegacy,
+                                        kOpLegacy, kOpBlt, kOpBge,
+                                        kOpBltu,   kOpBgeu};
+  static const uint8_t kImmOps[8] = {kOpAddi, kOpSlli, kOpSlti, kOpSltiu,
+                                     kOpXori, kOpSrli, kOpOri,  kOpAndi};
+  static const uint8_t kAluOps[8] = {kOpAdd, kOpSll, kOpSlt, kOpSltu,
+                                     kOpXor, kOpSrl, kOpOr,  kOpAnd};
+  static const uint8_t kMulDivOps[8] = {kOpMul, kOpMulh, kOpMulhsu, kOpMulhu,
+                                        kOpDiv, kOpDivu, kOpRem,    kOpRemu};
+
+  const uint32_t opcode = BITS(inst, 6, 0);
+  const uint32_t funct3 = BITS(inst, 14, 12);
+  const uint32_t funct7 = BITS(inst, 31, 25);
+
+  d.inst = inst;
+  d.rd = BITS(inst, 11, 7);
+  d.rs1 = BITS(inst, 19, 15);
+  d.rs2 = BITS(inst, 24, 20);
+  d.funct3 = funct3;
+  d.imm = 0;
+  d.op = kOpLegacy;
+
+  // 未特化的编码交给原来的 RV32IM() 处理，行为保持不变
+  switch (opcode) {
+  case number_0_opcode_lui:
+    d.imm = immU(inst);
+    d.op = kOpLui;
+    break;
+  case number_1_opcode_auipc:
+    d.imm = immU(inst);
+    d.op = kOpAuipc;
+    break;
+  case number_2_opcode_jal:
+    d.imm = immJ(inst);
+    d.op = kOpJal;
+    break;
+  case number_3_opcode_jalr:
+    d.imm = immI(inst);
+    d.op = kOpJalr;
+    break;
+  case number_4_opcode_beq:
+    d.imm = immB(inst);
+    d.op = kBranchOps[funct3];
+    break;
+  case number_5_opcode_lb:
+    d.imm = immI(inst);
+    d.op = kOpLoad;
+    break;
+  case number_6_opcode_sb:
+    d.imm = immS(inst);
+    d.op = kOpStore;
+    break;
+  case number_7_opcode_addi:
+    d.imm = immI(inst);
+    d.op = kImmOps[funct3];
+    if (funct3 == 1 || funct3 == 5) {
+      d.imm &= 0x1f;
+      if (funct3 == 5 && funct7 == 32) {
+        d.op = kOpSrai;
+      } else if (funct7 != 0) {
+        d.op = kOpLegacy;
+      }
+    }
+    break;
+  case number_8_opcode_add:
+    if (funct7 == 1) {
+      d.op = kMulDivOps[funct3];
+    } else if (funct7 == 0) {
+      d.op = kAluOps[funct3];
+    } else if (funct7 == 32 && funct3 == 0) {
+      d.op = kOpSub;
+    } else if (funct7 == 32 && funct3 == 5) {
+      d.op = kOpSra;
+    }
+    break;
+  case number_10_opcode_ecall:
+    if ((inst & INST_SFENCE_VMA_MASK) == INST_SFENCE_VMA) {
+      d.op = kOpSfenceVma;
+    } else {
+      d.op = kOpSystem;
+    }
+    break;
+  case number_11_opcode_lrw:
+    d.op = kOpAmo;
+    break;
+  case number_12_opcode_float:
+  case number_13_opcode_fmadd:
+  case number_14_opcode_fmsub:
+  case number_15_opcode_fnmsub:
+  case number_16_opcode_fnmadd:
+    d.op = kOpZfinx;
+    break;
+  default:
+    break;
+  }
+  d.handler = kOpHandlers[d.op];
+}
+
+void SingleCycleCpu::op_lui(const DecodedInst &d) {
+  state.gpr[d.rd] = d.imm;
+  state.pc += 4;
+}
+
+void SingleCycleCpu::op_auipc(const DecodedInst &d) {
+  state.gpr[d.rd] = state.pc + d.imm;
+  state.pc += 4;
+}
+
+void SingleCycleCpu::op_jal(const DecodedInst &d) {
+  is_br = true;
+  br_taken = true;
+  state.gpr[d.rd] = state.pc + 4;
+  state.pc += d.imm;
+}
+
+void SingleCycleCpu::op_jalr(const DecodedInst &d) {
+  is_br = true;
+  br_taken = true;
+  uint32_t next_pc = (state.gpr[d.rs1] + d.imm) & 0xFFFFFFFC;
+  state.gpr[d.rd] = state.pc + 4;
+  state.pc = next_pc;
+}
+
+#define DECODED_BRANCH(name, cond)                                             \
+  void SingleCycleCpu::name(const DecodedInst &d) {                            \
+    uint32_t a = state.gpr[d.rs1];                                             \
+    uint32_t b = state.gpr[d.rs2];                                             \
+    is_br = true;                                                              \
+    br_taken = (cond);                                                         \
+    state.pc += br_taken ? d.imm : 4;                                          \
+  }
+
+DECODED_BRANCH(op_beq, a == b)
+DECODED_BRANCH(op_bne, a != b)
+DECODED_BRANCH(op_blt, (int32_t)a < (int32_t)b)
+DECODED_BRANCH(op_bge, (int32_t)a >= (int32_t)b)
+DECODED_BRANCH(op_bltu, a < b)
+DECODED_BRANCH(op_bgeu, a >= b)
+#undef DECODED_BRANCH
+
+void SingleCycleCpu::op_load(const DecodedInst &d) {
+  uint32_t v_addr = state.gpr[d.rs1] + d.imm;
+  uint32_t p_addr = v_addr;
+  if ((state.csr[csr_satp] & 0x80000000) && privilege != 3) {
+    page_fault_load = !va2pa(p_addr, v_addr, 1);
+  }
+
+  if (translation_pending) {
+    return;
+  }
+
+  if (page_fault_load) {
+    exception(v_addr);
+    return;
+  }
+
+  uint32_t data = 0;
+  if (!cpu_mem_read32_now(mem_hooks, p_addr, &data)) {
+    illegal_exception = true;
+    exception(v_addr);
+    return;
+  }
+  if (Clint::contains(p_addr)) {
+    data = clint.read32(p_addr & ~0x3u, static_cast<uint64_t>(sim_time));
+  }
+  data >>= (p_addr & 0b11) * 8;
+  switch (d.funct3) {
+  case 0: // lb
+    data = (uint32_t)(int32_t)(int8_t)data;
+    break;
+  case 1: // lh
+    data = (uint32_t)(int32_t)(int16_t)data;
+    break;
+  case 4: // lbu
+    data &= 0xFF;
+    break;
+  case 5: // lhu
+    data &= 0xFFFF;
+    break;
+  default: // lw
+    break;
+  }
+
+  if (p_addr == kLegacyTimerAddr) {
+    data = static_cast<uint32_t>(clint.mtime(static_cast<uint64_t>(sim_time)));
+  }
+  if (p_addr == kLegacyTimerAddr + 4) {
+    data = 0;
+  }
+
+  state.gpr[d.rd] = data;
+  state.pc += 4;
+}
+
+void SingleCycleCpu::op_store(const DecodedInst &d) {
+  uint32_t v_addr = state.gpr[d.rs1] + d.imm;
+  uint32_t p_addr = v_addr;
+  if ((state.csr[csr_satp] & 0x80000000) && privilege != 3) {
+    page_fault_store = !va2pa(p_addr, v_addr, 2);
+  }
+
+  if (translation_pending) {
+    return;
+  }
+
+  if (page_fault_store) {
+    exception(v_addr);
+    return;
+  }
+
+  state.store = true;
+  state.store_addr = p_addr;
+  state.store_data = state.gpr[d.rs2];
+  if (d.funct3 == 0b00) {
+    state.store_strb = 0b1;
+    state.store_data &= 0xFF;
+  } else if (d.funct3 == 0b01) {
+    state.store_strb = 0b11;
+    state.store_data &= 0xFFFF;
+  } else {
+    state.store_strb = 0b1111;
+  }
+
+  store_data();
+  state.pc += 4;
+}
+
+#define DECODED_ALU(name, expr)                                                \
+  void SingleCycleCpu::name(const DecodedInst &d) {                            \
+    uint32_t a = state.gpr[d.rs1];                                             \
+    uint32_t b = state.gpr[d.rs2];                                             \
+    (void)b;                                                                   \
+    state.gpr[d.rd] = (expr);                                                  \
+    state.pc += 4;                                                             \
+  }
+
+DECODED_ALU(op_addi, a + d.imm)
+DECODED_ALU(op_slti, (int32_t)a < (int32_t)d.imm ? 1 : 0)
+DECODED_ALU(op_sltiu, a < d.imm ? 1 : 0)
+DECODED_ALU(op_xori, a ^ d.imm)
+DECODED_ALU(op_ori, a | d.imm)
+DECODED_ALU(op_andi, a & d.imm)
+DECODED_ALU(op_slli, a << d.imm)
+DECODED_ALU(op_srli, a >> d.imm)
+DECODED_ALU(op_srai, (uint32_t)((int32_t)a >> d.imm))
+DECODED_ALU(op_add, a + b)
+DECODED_ALU(op_sub, a - b)
+DECODED_ALU(op_sll, a << (b & 0x1f))
+DECODED_ALU(op_slt, (int32_t)a < (int32_t)b ? 1 : 0)
+DECODED_ALU(op_sltu, a < b ? 1 : 0)
+DECODED_ALU(op_xor, a ^ b)
+DECODED_ALU(op_srl, a >> (b & 0x1f))
+DECODED_ALU(op_sra, (uint32_t)((int32_t)a >> (b & 0x1f)))
+DECODED_ALU(op_or, a | b)
+DECODED_ALU(op_and, a & b)
+DECODED_ALU(op_mul, (uint32_t)((uint64_t)a * b))
+DECODED_ALU(op_mulh,
+            (uint32_t)(((int64_t)(int32_t)a * (int64_t)(int32_t)b) >> 32))
+DECODED_ALU(op_mulhsu, (uint32_t)(((int64_t)(int32_t)a * (int64_t)b) >> 32))
+DECODED_ALU(op_mulhu, (uint32_t)(((uint64_t)a * b) >> 32))
+// RISC-V 规定：除以0结果为 -1 / 最大值，余数为被除数；INT_MIN / -1 溢出
+DECODED_ALU(op_div, b == 0 ? 0xFFFFFFFFu
+                    : (a == 0x80000000u && b == 0xFFFFFFFFu)
+                        ? a
+                        : (uint32_t)((int32_t)a / (int32_t)b))
+DECODED_ALU(op_divu, b == 0 ? 0xFFFFFFFFu : a / b)
+DECODED_ALU(op_rem, b == 0 ? a
+                    : (a == 0x80000000u && b == 0xFFFFFFFFu)
+                        ? 0u
+                        : (uint32_t)((int32_t)a % (int32_t)b))
+DECODED_ALU(op_remu, b == 0 ? a : a % b)
+#undef DECODED_ALU
+
+void SingleCycleCpu::op_sfence_vma(const DecodedInst &d) {
+  (void)d;
+  sfence_vma();
+}
+
+void SingleCycleCpu::op_system(const DecodedInst &d) {
+  // SYSTEM 指令 (CSR, WFI, MRET等)
+  is_csr = (d.inst != INST_WFI);
+  RV32CSR();
+}
+
+void SingleCycleCpu::op_amo(const DecodedInst &d) {
+  (void)d;
+  RV32A();
+}
+
+void SingleCycleCpu::op_zfinx(const DecodedInst &d) {
+  (void)d;
+  RV32Zfinx();
+}
+
+void SingleCycleCpu::op_legacy(const DecodedInst &d) {
+  (void)d;
+  RV32IM();
+}
+
+// ---------------- 快速功能模式 (Basic-block fast mode) ----------------
+static inline uint32_t fast_block_index(uint32_t paddr) {
+  return (paddr >> 2) & (SingleCycleCpu::kFastBlockCount - 1);
+}
+
+static inline bool fast_op_ends_block(uint8_t op) {
+  return op == kOpJal || op == kOpJalr || (op >= kOpBeq && op <= kOpBgeu);
+}
+
+void SingleCycleCpu::fast_block_reset() {
+  for (FastBlock &block : fast_blocks) {
+    fast_block_retire(block);
+    block.valid = false;
+  }
+  for (uint64_t &word : fast_code_pages) {
+    word = 0;
+  }
+  fast_block_break = false;
+  fast_uart_valid = false;
+  fast_exit_reason = kFastExitLimit;
+}
+
+void SingleCycleCpu::fast_block_retire(FastBlock &block) {
+  if (block.retired != 0) {
+    if (bbv_enabled) {
+      bbv_spill[block.paddr] += block.retired;
+    }
+    block.retired = 0;
+  }
+}
+
+void SingleCycleCpu::bbv_take(std::unordered_map<uint32_t, uint64_t> &out) {
+  out.clear();
+  out.swap(bbv_spill);
+  for (FastBlock &block : fast_blocks) {
+    if (block.retired != 0) {
+      out[block.paddr] += block.retired;
+      block.retired = 0;
+    }
+  }
+}
+
+bool SingleCycleCpu::fast_block_matches_memory(const FastBlock &block) {
+  for (uint32_t i = 0; i < block.n_ops; ++i) {
+    uint32_t inst = 0;
+    if (!cpu_mem_read32_now(mem_hooks, block.ops[i].d.paddr, &inst) ||
+        inst != block.ops[i].d.inst) {
+      return false;
+    }
+  }
+  return true;
+}
+
+FastBlock *SingleCycleCpu::fast_block_lookup(uint32_t paddr,
+                                             const void *const *labels) {
+  FastBlock &block = fast_blocks[fast_block_index(paddr)];
+  if (block.valid && block.paddr == paddr) {
+    // 同一次 run_fast() 内只有 store_data() 会改内存，它已负责失效；
+    // 跨调用的外部写入在本次首次进入时比对原始指令字发现
+    if (block.epoch == fast_epoch) {
+      return &block;
+    }
+    if (fast_block_matches_memory(block)) {
+      block.epoch = fast_epoch;
+      return &block;
+    }
+  }
+
+  fast_block_retire(block);
+  block.valid = true;
+  block.paddr = paddr;
+  block.epoch = fast_epoch;
+  block.n_ops = 0;
+  for (uint32_t addr = paddr; block.n_ops < FastBlock::kMaxOps; addr += 4) {
+    if (block.n_ops != 0 && (addr & 0xFFF) == 0) {
+      break; // 不跨页：下一页的取指权限需要重新翻译
+    }
+    uint32_t inst = 0;
+    if (!cpu_mem_read32_now(mem_hooks, addr, &inst)) {
+      break;
+    }
+    FastOp &op = block.ops[block.n_ops];
+    decode_inst(inst, op.d);
+    if (op.d.op == kOpSystem || op.d.op == kOpSfenceVma) {
+      break; // CSR/ecall/mret/ebreak 等交给 exec()
+    }
+    op.d.paddr = addr;
+    op.d.valid = true;
+    op.target = labels[op.d.op];
+    block.n_ops++;
+    if (fast_op_ends_block(op.d.op)) {
+      break;
+    }
+  }
+
+  if (fast_code_pages.empty()) {
+    fast_code_pages.assign((1ull << 20) / 64, 0);
+  }
+  fast_code_pages[paddr >> 18] |= 1ull << ((paddr >> 12) & 63);
+  return &block;
+}
+
+void SingleCycleCpu::fast_block_invalidate_word(uint32_t paddr) {
+  // 块不跨页且最多 kMaxOps 条，只需检查可能覆盖该字的起始地址
+  const uint32_t aligned = paddr & ~0x3u;
+  for (uint32_t k = 0; k < FastBlock::kMaxOps && k * 4 <= (aligned & 0xFFF);
+       ++k) {
+    const uint32_t start = aligned - k * 4;
+    FastBlock &block = fast_blocks[fast_block_index(start)];
+    if (block.valid && block.paddr == start && block.n_ops > k) {
+      fast_block_retire(block);
+      block.valid = false;
+      fast_block_break = true;
+    }
+  }
+}
+
+uint64_t SingleCycleCpu::run_fast(uint64_t max_inst) {
+  // Direct-threaded dispatch: each FastOp carries the address of its label.
+  static const void *const kLabels[kOpCount] = {
+      &&L_op_lui,      &&L_op_auipc,    &&L_op_jal,      &&L_op_jalr,
+      &&L_op_beq,      &&L_op_bne,      &&L_op_blt,      &&L_op_bge,
+      &&L_op_bltu,     &&L_op_bgeu,     &&L_op_load,     &&L_op_store,
+      &&L_op_addi,     &&L_op_slti,     &&L_op_sltiu,    &&L_op_xori,
+      &&L_op_ori,      &&L_op_andi,     &&L_op_slli,     &&L_op_srli,
+      &&L_op_srai,     &&L_op_add,      &&L_op_sub,      &&L_op_sll,
+      &&L_op_slt,      &&L_op_sltu,     &&L_op_xor,      &&L_op_srl,
+      &&L_op_sra,      &&L_op_or,       &&L_op_and,      &&L_op_mul,
+      &&L_op_mulh,     &&L_op_mulhsu,   &&L_op_mulhu,    &&L_op_div,
+      &&L_op_divu,     &&L_op_rem,      &&L_op_remu,     &&L_op_checked,
+      &&L_op_checked,  &&L_op_checked,  &&L_op_checked,  &&L_op_checked,
+  };
+
+  if (fast_blocks.empty()) {
+    fast_blocks.resize(kFastBlockCount);
+    fast_block_reset();
+  }
+
+  fast_exit_reason = kFastExitLimit;
+  fast_uart_valid = false;
+  ptw_direct = true;
+  fast_epoch++;
+  uint64_t executed = 0;
+
+  while (executed < max_inst) {
+    if (static_cast<uint64_t>(sim_time) >= clint.next_event()) {
+      clint_update();
+    }
+    update_interrupts();
+    const bool irq = M_software_interrupt || M_timer_interrupt ||
+                     M_external_interrupt || S_software_interrupt ||
+                     S_timer_interrupt || S_external_interrupt;
+
+    FastBlock *block = nullptr;
+    if (!irq && (state.pc & 0x3) == 0) {
+      uint32_t p_addr = state.pc;
+      bool fetch_ok = true;
+      page_fault_inst = false;
+      if ((state.csr[csr_satp] & 0x80000000) && privilege != 3) {
+        fetch_ok = va2pa(p_addr, state.pc, 0);
+      }
+      if (fetch_ok) {
+        block = fast_block_lookup(p_addr, kLabels);
+      }
+    }
+
+    if (block == nullptr || block->n_ops == 0) {
+      // 中断、取指异常与 SYSTEM 指令走逐条的精确路径
+      exec();
+      executed++;
+      // 空闲的 WFI 直接跳到下一个定时器事件
+      if (wfi_idle && clint.next_event() != Clint::kNever &&
+          static_cast<uint64_t>(sim_time) + 1 < clint.next_event()) {
+        sim_time = static_cast<long long>(clint.next_event()) - 1;
+      }
+      sim_time++;
+      if (bbv_enabled) {
+        bbv_spill[inst_paddr]++;
+      }
+      if (!is_exception && Instruction == INST_EBREAK) {
+        fast_exit_reason = kFastExitEbreak;
+        break;
+      }
+      if (fast_uart_valid) {
+        fast_exit_reason = kFastExitUart;
+        break;
+      }
+      continue;
+    }
+
+    const uint64_t budget = max_inst - executed;
+    // 块内纯计算指令不读 sim_time，只在访存/CSR 等可能读写 CLINT 的指令前
+    // 把它对齐到本条指令的周期，块结束时再补齐
+    const long long block_start = sim_time;
+    FastOp *op = block->ops;
+    FastOp *const end =
+        op + (budget < block->n_ops ? static_cast<uint32_t>(budget)
+                                    : block->n_ops);
+    is_exception = illegal_exception = page_fault_load = page_fault_store =
+        false;
+    is_br = br_taken = false;
+    fast_block_break = false;
+    state.store = false;
+
+#define FAST_NEXT()                                                            \
+  do {                                                                         \
+    state.gpr[0] = 0;                                                          \
+    if (++op != end)                                                           \
+      goto *op->target;                                                        \
+    goto block_done;                                                           \
+  } while (0)
+
+// Ops that may trap or write memory leave the block as soon as they do.
+#define FAST_NEXT_CHECKED()                                                    \
+  do {                                                                         \
+    if (is_exception || fast_block_break) {                                    \
+      state.gpr[0] = 0;                                                        \
+      ++op;                                                                    \
+      goto block_done;                                                         \
+    }                                                                          \
+    FAST_NEXT();                                                               \
+  } while (0)
+
+#define FAST_OP(name)                                                          \
+  L_##name:                                                                    \
+  name(op->d);                                                                 \
+  FAST_NEXT()
+
+    goto *op->target;
+
+    FAST_OP(op_lui);
+    FAST_OP(op_auipc);
+    FAST_OP(op_jal);
+    FAST_OP(op_jalr);
+    FAST_OP(op_beq);
+    FAST_OP(op_bne);
+    FAST_OP(op_blt);
+    FAST_OP(op_bge);
+    FAST_OP(op_bltu);
+    FAST_OP(op_bgeu);
+    FAST_OP(op_addi);
+    FAST_OP(op_slti);
+    FAST_OP(op_sltiu);
+    FAST_OP(op_xori);
+    FAST_OP(op_ori);
+    FAST_OP(op_andi);
+    FAST_OP(op_slli);
+    FAST_OP(op_srli);
+    FAST_OP(op_srai);
+    FAST_OP(op_add);
+    FAST_OP(op_sub);
+    FAST_OP(op_sll);
+    FAST_OP(op_slt);
+    FAST_OP(op_sltu);
+    FAST_OP(op_xor);
+    FAST_OP(op_srl);
+    FAST_OP(op_sra);
+    FAST_OP(op_or);
+    FAST_OP(op_and);
+    FAST_OP(op_mul);
+    FAST_OP(op_mulh);
+    FAST_OP(op_mulhsu);
+    FAST_OP(op_mulhu);
+    FAST_OP(op_div);
+    FAST_OP(op_divu);
+    FAST_OP(op_rem);
+    FAST_OP(op_remu);
+
+  L_op_load:
+    Instruction = op->d.inst;
+    sim_time = block_start + (op - block->ops);
+    op_load(op->d);
+    FAST_NEXT_CHECKED();
+  L_op_store:
+    Instruction = op->d.inst;
+    sim_time = block_start + (op - block->ops);
+    op_store(op->d);
+    FAST_NEXT_CHECKED();
+  L_op_checked:
+    Instruction = op->d.inst;
+    sim_time = block_start + (op - block->ops);
+    (this->*op->d.handler)(op->d);
+    FAST_NEXT_CHECKED();
+
+#undef FAST_OP
+#undef FAST_NEXT_CHECKED
+#undef FAST_NEXT
+
+  block_done:
+    const uint64_t n = static_cast<uint64_t>(op - block->ops);
+    block->retired += n;
+    executed += n;
+    sim_time = block_start + static_cast<long long>(n);
+    if (fast_uart_valid) {
+      fast_exit_reason = kFastExitUart;
+      break;
+    }
+  }
+
+  ptw_direct = false;
+  return executed;
+}
+
 void SingleCycleCpu::store_data() {
 
   uint32_t p_addr = state.store_addr;
@@ -1416,7 +2314,7 @@ void SingleCycleCpu::store_data() {
   uint32_t wstrb = state.store_strb << offset;
   uint32_t wdata = state.store_data << (offset * 8);
   uint32_t old_data = 0;
-  if (!cpu_mem_read32_now(word_addr, &old_data)) {
+  if (!cpu_mem_read32_now(mem_hooks, word_addr, &old_data)) {
     illegal_exception = true;
     return;
   }
@@ -1439,31 +2337,48 @@ void SingleCycleCpu::store_data() {
   /*}*/
 
   uint32_t merged_data = (mask & wdata) | (~mask & old_data);
-  if (!cpu_mem_write32_now(word_addr, merged_data, 0xFu)) {
+  if (!cpu_mem_write32_now(mem_hooks, word_addr, merged_data, 0xFu)) {
     illegal_exception = true;
     return;
   }
   ptw_cache_invalidate_word(word_addr);
+  tlb_snoop_store(word_addr);
+  decode_cache_invalidate_word(word_addr);
+  if (!fast_code_pages.empty() &&
+      ((fast_code_pages[word_addr >> 18] >> ((word_addr >> 12) & 63)) & 1)) {
+    fast_block_invalidate_word(word_addr);
+  }
+
+  if (Clint::contains(word_addr)) {
+    clint.write32(word_addr, wdata, wstrb, static_cast<uint64_t>(sim_time));
+    clint_update();
+    fast_block_break = true;
+  }
 
   if (p_addr == UART_BASE) {
     char temp;
     temp = wdata & 0x000000ff;
     uint32_t uart_reg = 0;
-    if (!cpu_mem_read32_now(0x10000000u, &uart_reg) ||
-        !cpu_mem_write32_now(0x10000000u, uart_reg & 0xffffff00u, 0xFu)) {
+    if (!cpu_mem_read32_now(mem_hooks, 0x10000000u, &uart_reg) ||
+        !cpu_mem_write32_now(mem_hooks, 0x10000000u, uart_reg & 0xffffff00u,
+                             0xFu)) {
       illegal_exception = true;
       return;
     }
     ptw_cache_invalidate_word(0x10000000u);
+    fast_uart_valid = true;
+    fast_uart_ch = static_cast<uint8_t>(temp);
+    fast_block_break = true;
     if (fast_run)
       cout << temp;
   }
 
   if (p_addr == 0x10000001 && (state.store_data & 0x000000ff) == 7) {
     uint32_t uart_reg = 0;
-    if (!cpu_mem_write32_now(0x0c201004u, 0xau, 0xFu) ||
-        !cpu_mem_read32_now(0x10000000u, &uart_reg) ||
-        !cpu_mem_write32_now(0x10000000u, uart_reg & 0xfff0ffffu, 0xFu)) {
+    if (!cpu_mem_write32_now(mem_hooks, 0x0c201004u, 0xau, 0xFu) ||
+        !cpu_mem_read32_now(mem_hooks, 0x10000000u, &uart_reg) ||
+        !cpu_mem_write32_now(mem_hooks, 0x10000000u, uart_reg & 0xfff0ffffu,
+                             0xFu)) {
       illegal_exception = true;
       return;
     }
@@ -1472,12 +2387,13 @@ void SingleCycleCpu::store_data() {
 
     state.csr[csr_mip] = state.csr[csr_mip] | (1 << 9);
     state.csr[csr_sip] = state.csr[csr_sip] | (1 << 9);
+    fast_block_break = true;
   }
 
   if (p_addr == 0x10000001 && (state.store_data & 0x000000ff) == 5) {
     uint32_t uart_reg = 0;
-    if (!cpu_mem_read32_now(0x10000000u, &uart_reg) ||
-        !cpu_mem_write32_now(0x10000000u,
+    if (!cpu_mem_read32_now(mem_hooks, 0x10000000u, &uart_reg) ||
+        !cpu_mem_write32_now(mem_hooks, 0x10000000u,
                              (uart_reg & 0xfff0ffffu) | 0x00030000u, 0xFu)) {
       illegal_exception = true;
       return;
@@ -1486,24 +2402,53 @@ void SingleCycleCpu::store_data() {
   }
 
   if (p_addr == 0xc201004 && (state.store_data & 0x000000ff) == 0xa) {
-    if (!cpu_mem_write32_now(0x0c201004u, 0x0u, 0xFu)) {
+    if (!cpu_mem_write32_now(mem_hooks, 0x0c201004u, 0x0u, 0xFu)) {
       illegal_exception = true;
       return;
     }
     ptw_cache_invalidate_word(0x0c201004u);
     state.csr[csr_mip] = state.csr[csr_mip] & ~(1 << 9);
     state.csr[csr_sip] = state.csr[csr_sip] & ~(1 << 9);
+    fast_block_break = true;
   }
 
   state.store_data = state.store_data << offset * 8;
   state.store_strb = state.store_strb << offset * 8;
 }
 
+// Leaf PTE permission check shared by the page-table walk and TLB hits.
+static inline bool pte_leaf_permits(uint32_t pte, uint32_t type, int eff_priv,
+                                    bool mxr, bool sum) {
+  // 权限检查 (Permission Check)
+  // Fetch (0): 需要 X
+  if (type == 0 && !(pte & PTE_X))
+    return false;
+  // Load (1): 需要 R，或者 (MXR=1 且 X=1)
+  if (type == 1 && !(pte & PTE_R) && !(mxr && (pte & PTE_X)))
+    return false;
+  // Store (2): 需要 W
+  if (type == 2 && !(pte & PTE_W))
+    return false;
+
+  // 用户权限检查 (User/Supervisor Check)
+  bool is_user_page = (pte & PTE_U) != 0;
+  if (eff_priv == 0 && !is_user_page)
+    return false; // U-mode 访问 S-page -> Fault
+  if (eff_priv == 1 && is_user_page && !sum)
+    return false; // S-mode 访问 U-page 且 SUM=0 -> Fault
+
+  // A/D 位检查
+  if (!(pte & PTE_A))
+    return false; // Accessed 必须为 1 (硬件不自动设置时需报错)
+  if (type == 2 && !(pte & PTE_D))
+    return false; // 写操作 Dirty 必须为 1
+  return true;
+}
+
 bool SingleCycleCpu::va2pa(uint32_t &p_addr, uint32_t v_addr, uint32_t type) {
   translation_pending = false;
 
   uint32_t mstatus = state.csr[csr_mstatus];
-  uint32_t sstatus = state.csr[csr_sstatus];
   uint32_t satp = state.csr[csr_satp];
 
   // 1. 提取状态位 (直接位运算，极快)
@@ -1518,12 +2463,39 @@ bool SingleCycleCpu::va2pa(uint32_t &p_addr, uint32_t v_addr, uint32_t type) {
     eff_priv = (mstatus >> MSTATUS_MPP_SHIFT) & 0x3;
   }
 
+  // 0. TLB 查找：命中时只需重新做权限检查
+  uint32_t asid = (satp >> 22) & 0x1FF;
+  SoftTlb &tlb = (type == 0) ? itlb : dtlb;
+  uint32_t tlb_pte = 0;
+  bool tlb_superpage = false;
+  if (tlb_lookup(tlb, v_addr, asid, tlb_pte, tlb_superpage)) {
+    if (!pte_leaf_permits(tlb_pte, type, eff_priv, mxr, sum))
+      return false;
+    if (tlb_superpage) {
+      p_addr = ((tlb_pte << 2) & 0xFFC00000) | (v_addr & 0x3FFFFF);
+    } else {
+      p_addr = ((tlb_pte >> 10) << 12) | (v_addr & 0xFFF);
+    }
+    return true;
+  }
+
+  bool ok = page_walk(tlb, p_addr, v_addr, type, asid, eff_priv, mxr, sum);
+  // A walk stalled on the PTW port is retried; count it once it resolves.
+  if (!translation_pending) {
+    tlb.miss++;
+  }
+  return ok;
+}
+
+bool SingleCycleCpu::page_walk(SoftTlb &tlb, uint32_t &p_addr, uint32_t v_addr,
+                               uint32_t type, uint32_t asid, int eff_priv,
+                               bool mxr, bool sum) {
+  uint32_t satp = state.csr[csr_satp];
+
   // 2. Level 1 Page Table Walk
   // satp 的 PPN 字段在 SV32 中是低 22 位 (0-21)
   // VPN[1] 是 v_addr 的 [31:22] 位
   // pte1_addr = (satp.ppn << 12) + (vpn1 * 4)
-  // 你的原代码逻辑：(satp << 12) | ((v_addr >> 20) & 0xFFC)
-  // 等价于下面的位操作：
   uint32_t ppn_root = satp & 0x3FFFFF; // 提取 SATP 中的 PPN
   uint32_t vpn1 = (v_addr >> 22) & 0x3FF;
   uint32_t pte1_addr = (ppn_root << 12) | (vpn1 << 2);
@@ -1531,7 +2503,8 @@ bool SingleCycleCpu::va2pa(uint32_t &p_addr, uint32_t v_addr, uint32_t type) {
   // 直接读取，注意这里需要确保 memory 是按字寻址还是字节寻址
   uint32_t pte1 = 0;
   if (!ptw_cache_read(pte1_addr, &pte1)) {
-    CpuMemReadResult pte1_result = cpu_phys_read32(memory, pte1_addr, &pte1);
+    CpuMemReadResult pte1_result =
+        cpu_ptw_read32(mem_hooks, ptw_direct, pte1_addr, &pte1);
     if (pte1_result == CPU_MEM_READ_PENDING) {
       translation_pending = true;
       return false;
@@ -1551,35 +2524,15 @@ bool SingleCycleCpu::va2pa(uint32_t &p_addr, uint32_t v_addr, uint32_t type) {
   // 4. 判断是否是叶子节点 (R=1 或 X=1)
   if ((pte1 & PTE_R) || (pte1 & PTE_X)) {
     // --- Superpage (4MB) ---
-
-    // 权限检查 (Permission Check)
-    // Fetch (0): 需要 X
-    if (type == 0 && !(pte1 & PTE_X))
-      return false;
-    // Load (1): 需要 R，或者 (MXR=1 且 X=1)
-    if (type == 1 && !(pte1 & PTE_R) && !(mxr && (pte1 & PTE_X)))
-      return false;
-    // Store (2): 需要 W
-    if (type == 2 && !(pte1 & PTE_W))
+    if (!pte_leaf_permits(pte1, type, eff_priv, mxr, sum))
       return false;
 
-    // 用户权限检查 (User/Supervisor Check)
-    bool is_user_page = (pte1 & PTE_U) != 0;
-    if (eff_priv == 0 && !is_user_page)
-      return false; // U-mode 访问 S-page -> Fault
-    if (eff_priv == 1 && is_user_page && !sum)
-      return false; // S-mode 访问 U-page 且 SUM=0 -> Fault
-
     // 对齐检查 (Superpage 要求 PPN[0] 为 0)
     // PPN[0] 对应 PTE 的 [19:10] 位
     if ((pte1 >> 10) & 0x3FF)
       return false;
 
-    // A/D 位检查
-    if (!(pte1 & PTE_A))
-      return false; // Accessed 必须为 1 (硬件不自动设置时需报错)
-    if (type == 2 && !(pte1 & PTE_D))
-      return false; // 写操作 Dirty 必须为 1
+    tlb_fill(tlb, v_addr, asid, pte1, true, pte1_addr, pte1_addr);
 
     // 计算物理地址 (Superpage)
     // PA = PPN[1] | VPN[0] | Offset
@@ -1597,7 +2550,8 @@ bool SingleCycleCpu::va2pa(uint32_t &p_addr, uint32_t v_addr, uint32_t type) {
 
   uint32_t pte2 = 0;
   if (!ptw_cache_read(pte2_addr, &pte2)) {
-    CpuMemReadResult pte2_result = cpu_phys_read32(memory, pte2_addr, &pte2);
+    CpuMemReadResult pte2_result =
+        cpu_ptw_read32(mem_hooks, ptw_direct, pte2_addr, &pte2);
     if (pte2_result == CPU_MEM_READ_PENDING) {
       translation_pending = true;
       return false;
@@ -1616,27 +2570,10 @@ bool SingleCycleCpu::va2pa(uint32_t &p_addr, uint32_t v_addr, uint32_t type) {
   // Level 2 必须是叶子节点 (SV32 只有两级)
   if ((pte2 & PTE_R) || (pte2 & PTE_X)) {
     // --- 4KB Page ---
-
-    // 权限检查 (逻辑同上)
-    if (type == 0 && !(pte2 & PTE_X))
-      return false;
-    if (type == 1 && !(pte2 & PTE_R) && !(mxr && (pte2 & PTE_X)))
-      return false;
-    if (type == 2 && !(pte2 & PTE_W))
+    if (!pte_leaf_permits(pte2, type, eff_priv, mxr, sum))
       return false;
 
-    // 用户权限检查
-    bool is_user_page = (pte2 & PTE_U) != 0;
-    if (eff_priv == 0 && !is_user_page)
-      return false;
-    if (eff_priv == 1 && is_user_page && !sum)
-      return false;
-
-    // A/D 位检查
-    if (!(pte2 & PTE_A))
-      return false;
-    if (type == 2 && !(pte2 & PTE_D))
-      return false;
+    tlb_fill(tlb, v_addr, asid, pte2, false, pte1_addr, pte2_addr);
 
     // 计算物理地址 (4KB Page)
     // PA = PPN | Offset
@@ -0,0 +1,214 @@
+/**
+ * @file Elf32.cpp
+ * @brief Read-only ELF32 mapping, program header and symbol table reader.
+ */
+
+#include "Elf32.h"
+
+#include <algorithm>
+#include <cstring>
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace elf32 {
+
+namespace {
+
+template <typename T> T load(const uint8_t *ptr) {
+  T value;
+  std::memcpy(&value, ptr, sizeof(T));
+  return value;
+}
+
+} // namespace
+
+bool has_magic(const void *head, size_t bytes) {
+  return bytes >= SELFMAG && std::memcmp(head, ELFMAG, SELFMAG) == 0;
+}
+
+uint32_t physical_entry(const std::vector<Segment> &segments, uint32_t entry) {
+  for (const Segment &seg : segments) {
+    if (entry - seg.vaddr < seg.memsz) {
+      return seg.paddr + (entry - seg.vaddr);
+    }
+  }
+  return entry;
+}
+
+bool ElfFile::open(const std::string &path, std::string &error) {
+  close();
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    error = "cannot open ELF file: " + path;
+    return false;
+  }
+  struct stat st {};
+  if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Elf32_Ehdr))) {
+    ::close(fd);
+    error = "not an ELF file: " + path;
+    return false;
+  }
+  void *ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                   MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (ptr == MAP_FAILED) {
+    error = "cannot map ELF file: " + path;
+    return false;
+  }
+  data_ = static_cast<const uint8_t *>(ptr);
+  size_ = static_cast<size_t>(st.st_size);
+
+  const auto ehdr = load<Elf32_Ehdr>(data_);
+  if (std::memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0) {
+    error = "not an ELF file: " + path;
+  } else if (ehdr.e_ident[EI_CLASS] != ELFCLASS32 ||
+             ehdr.e_ident[EI_DATA] != ELFDATA2LSB) {
+    error = "not a little-endian ELF32 file: " + path;
+  } else if (ehdr.e_machine != EM_RISCV) {
+    error = "not a RISC-V ELF file: " + path;
+  } else {
+    return true;
+  }
+  close();
+  return false;
+}
+
+void ElfFile::close() {
+  if (data_ != nullptr) {
+    munmap(const_cast<uint8_t *>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+}
+
+const uint8_t *ElfFile::at(uint64_t offset, uint64_t bytes) const {
+  if (data_ == nullptr || offset > size_ || bytes > size_ - offset) {
+    return nullptr;
+  }
+  return data_ + offset;
+}
+
+uint32_t ElfFile::entry() const {
+  return data_ != nullptr ? load<Elf32_Ehdr>(data_).e_entry : 0;
+}
+
+bool ElfFile::read_segments(std::vector<Segment> &segments,
+                            std::string &error) const {
+  segments.clear();
+  if (data_ == nullptr) {
+    error = "ELF file not open";
+    return false;
+  }
+  const auto ehdr = load<Elf32_Ehdr>(data_);
+  if (ehdr.e_phnum == 0) {
+    return true;
+  }
+  if (ehdr.e_phentsize < sizeof(Elf32_Phdr) ||
+      at(ehdr.e_phoff, static_cast<uint64_t>(ehdr.e_phnum) *
+                           ehdr.e_phentsize) == nullptr) {
+    error = "bad ELF program header table";
+    return false;
+  }
+  for (uint32_t i = 0; i < ehdr.e_phnum; ++i) {
+    const auto ph = load<Elf32_Phdr>(
+        data_ + ehdr.e_phoff + static_cast<uint64_t>(i) * ehdr.e_phentsize);
+    if (ph.p_type != PT_LOAD || ph.p_memsz == 0) {
+      continue;
+    }
+    if (ph.p_filesz > ph.p_memsz || at(ph.p_offset, ph.p_filesz) == nullptr ||
+        static_cast<uint64_t>(ph.p_paddr) + ph.p_memsz > 0x100000000ULL) {
+      error = "bad ELF segment " + std::to_string(i);
+      return false;
+    }
+    segments.push_back({ph.p_paddr, ph.p_vaddr, ph.p_offset, ph.p_filesz,
+                        ph.p_memsz, ph.p_flags});
+  }
+  return true;
+}
+
+bool ElfFile::read_symbols(std::vector<Symbol> &symbols,
+                           std::string &error) const {
+  symbols.clear();
+  if (data_ == nullptr) {
+    error = "ELF file not open";
+    return false;
+  }
+  const auto ehdr = load<Elf32_Ehdr>(data_);
+  if (ehdr.e_shnum == 0) {
+    return true;
+  }
+  if (ehdr.e_shentsize < sizeof(Elf32_Shdr) ||
+      at(ehdr.e_shoff, static_cast<uint64_t>(ehdr.e_shnum) *
+                           ehdr.e_shentsize) == nullptr) {
+    error = "bad ELF section header table";
+    return false;
+  }
+  auto section = [&](uint32_t index) {
+    return load<Elf32_Shdr>(data_ + ehdr.e_shoff +
+                            static_cast<uint64_t>(index) * ehdr.e_shentsize);
+  };
+
+  int symtab = -1;
+  for (uint32_t i = 0; i < ehdr.e_shnum; ++i) {
+    const uint32_t type = section(i).sh_type;
+    if (type == SHT_SYMTAB || (type == SHT_DYNSYM && symtab < 0)) {
+      symtab = static_cast<int>(i);
+    }
+  }
+  if (symtab < 0) {
+    return true;
+  }
+  const Elf32_Shdr sym_sh = section(static_cast<uint32_t>(symtab));
+  if (sym_sh.sh_link >= ehdr.e_shnum) {
+    error = "bad ELF symbol table";
+    return false;
+  }
+  const Elf32_Shdr str_sh = section(sym_sh.sh_link);
+  const uint8_t *syms = at(sym_sh.sh_offset, sym_sh.sh_size);
+  const uint8_t *strs = at(str_sh.sh_offset, str_sh.sh_size);
+  if (syms == nullptr || strs == nullptr) {
+    error = "bad ELF symbol table";
+    return false;
+  }
+
+  const uint32_t count = sym_sh.sh_size / sizeof(Elf32_Sym);
+  for (uint32_t i = 0; i < count; ++i) {
+    const auto sym = load<Elf32_Sym>(syms + i * sizeof(Elf32_Sym));
+    const uint32_t type = ELF32_ST_TYPE(sym.st_info);
+    if (sym.st_shndx == SHN_UNDEF || sym.st_shndx >= ehdr.e_shnum ||
+        sym.st_name >= str_sh.sh_size) {
+      continue;
+    }
+    if (type != STT_FUNC &&
+        !(type == STT_NOTYPE &&
+          (section(sym.st_shndx).sh_flags & SHF_EXECINSTR) != 0)) {
+      continue;
+    }
+    const char *name = reinterpret_cast<const char *>(strs + sym.st_name);
+    const size_t len = strnlen(name, str_sh.sh_size - sym.st_name);
+    // 跳过汇编器生成的局部标号与 RISC-V 映射符号
+    if (len == 0 || std::strncmp(name, ".L", 2) == 0 ||
+        std::strncmp(name, "$x", 2) == 0 || std::strncmp(name, "$d", 2) == 0) {
+      continue;
+    }
+    symbols.push_back({sym.st_value, sym.st_size, std::string(name, len)});
+  }
+
+  // 同一地址保留有大小的 FUNC 符号
+  std::stable_sort(symbols.begin(), symbols.end(),
+                   [](const Symbol &a, const Symbol &b) {
+                     return a.addr < b.addr ||
+                            (a.addr == b.addr && a.size > b.size);
+                   });
+  symbols.erase(std::unique(symbols.begin(), symbols.end(),
+                            [](const Symbol &a, const Symbol &b) {
+                              return a.addr == b.addr;
+                            }),
+                symbols.end());
+  return true;
+}
+
+} // namespace elf32
@@ -0,0 +1,72 @@
+#pragma once
+/**
+ * @file Elf32.h
+ * @brief Minimal read-only view of a little-endian RV32 ELF file.
+ *
+ * The file is mapped read-only and every table access is bounds-checked, so
+ * truncated or hostile files fail with an error instead of reading past the
+ * mapping. Only what the simulator needs is exposed: the PT_LOAD segments
+ * and entry point used to load an image, and the function symbols used to
+ * symbolize guest PCs.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace elf32 {
+
+// True when the first bytes of a file carry the ELF magic.
+bool has_magic(const void *head, size_t bytes);
+
+struct Segment {
+  uint32_t paddr = 0;
+  uint32_t vaddr = 0;
+  uint32_t offset = 0; // file offset of the first byte
+  uint32_t filesz = 0;
+  uint32_t memsz = 0; // >= filesz; the rest is zero (.bss)
+  uint32_t flags = 0; // PF_R/PF_W/PF_X
+};
+
+struct Symbol {
+  uint32_t addr = 0;
+  uint32_t size = 0; // 0: unknown, extends to the next symbol
+  std::string name;
+};
+
+class ElfFile {
+public:
+  ElfFile() = default;
+  ~ElfFile() { close(); }
+  ElfFile(const ElfFile &) = delete;
+  ElfFile &operator=(const ElfFile &) = delete;
+
+  // Maps `path` and checks the ELF header (ELFCLASS32, little endian,
+  // EM_RISCV).
+  bool open(const std::string &path, std::string &error);
+  void close();
+
+  uint32_t entry() const;
+  // PT_LOAD segments with a non-zero memory size, in header order. Fails
+  // when a segment lies outside the file or the 32-bit address space.
+  bool read_segments(std::vector<Segment> &segments, std::string &error) const;
+
+  // Function symbols sorted by address: STT_FUNC entries plus untyped labels
+  // (e.g. assembly `_start`) in executable sections. Falls back to .dynsym
+  // when there is no .symtab. A stripped file gives an empty list.
+  bool read_symbols(std::vector<Symbol> &symbols, std::string &error) const;
+
+private:
+  const uint8_t *at(uint64_t offset, uint64_t bytes) const;
+
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// Physical address of a virtual entry point: e_entry is a virtual address,
+// which differs from the load address in e.g. a Linux vmlinux. Returned
+// unchanged when no segment covers it.
+uint32_t physical_entry(const std::vector<Segment> &segments, uint32_t entry);
+
+} // namespace elf32
@@ -1,10 +1,13 @@
+#include "AxiTrace.h"
 #include "SimDDR.h"
+#include "SimPoint.h"
 #include "config.h"
 #include "sc_axi4_sim_api.h"
 
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
-#include <fstream>
+#include <cstring>
 #include <getopt.h>
 #include <iostream>
 #include <limits>
@@ -16,6 +19,27 @@ struct SimConfig {
   std::string image_path;
   uint64_t max_inst = MAX_COMMIT_INST;
   uint64_t max_cycles = 12000000000ULL;
+  uint64_t fast_forward = 0;
+  bool tlm = false;
+  uint64_t store_buffer = 0;
+  uint64_t fetch_buffer = 0;
+  bool prefetch = false;
+  uint32_t dcache_sets = 0; // 0 = no data cache
+  uint32_t dcache_ways = 0;
+  uint32_t dcache_line = 0;
+  int dcache_policy = SC_SIM_DCACHE_LRU;
+  bool dcache_write_through = false;
+  std::string perf_json;
+  std::string profile_path;
+  std::string profile_elf;
+  uint64_t profile_period = 1;
+  uint64_t profile_top = 0; // 0 = no hot-spot table
+  std::string save_checkpoint;
+  std::string load_checkpoint;
+  std::string bbv_path;
+  std::string simpoints_path;
+  std::string simpoint_weights_path;
+  SimPointConfig simpoint; // interval/warmup 默认值在 parse_args() 中设置
 };
 
 bool parse_u64(const char *str, uint64_t &value) {
@@ -27,11 +51,76 @@ bool parse_u64(const char *str, uint64_t &value) {
   return end != nullptr && *end == '\0';
 }
 
+// SETSxWAYSxLINE, e.g. 64x4x32; range checks are left to sc_sim_set_dcache().
+bool parse_dcache_geometry(const char *str, SimConfig &cfg) {
+  uint64_t v[3] = {};
+  const char *p = str;
+  for (int i = 0; i < 3; ++i) {
+    char *end = nullptr;
+    v[i] = std::strtoull(p, &end, 10);
+    if (end == p || v[i] == 0 || v[i] > 0xffffffffULL ||
+        *end != (i < 2 ? 'x' : '\0')) {
+      return false;
+    }
+    p = end + 1;
+  }
+  cfg.dcache_sets = static_cast<uint32_t>(v[0]);
+  cfg.dcache_ways = static_cast<uint32_t>(v[1]);
+  cfg.dcache_line = static_cast<uint32_t>(v[2]);
+  return true;
+}
+
 void print_help(const char *argv0) {
   std::cout << "Usage: " << argv0 << " [options] <binary_image>\n"
+            << "       " << argv0
+            << " [options] --load-checkpoint <file>\n"
             << "Options:\n"
             << "  --max-inst <N>    Maximum executed instructions\n"
             << "  --max-cycles <N>  Maximum simulated cycles\n"
+            << "  --fast-forward <N> Run the first N instructions in functional "
+               "fast mode\n"
+            << "  --tlm             Transaction-level timing (no per-beat "
+               "AXI, same sim_time)\n"
+            << "  --store-buffer <N> Post stores to RAM through an N-entry "
+               "store buffer (max "
+            << SC_SIM_STORE_BUFFER_MAX << ", cycle timing)\n"
+            << "  --fetch-buffer <N> Fetch whole lines into an N-line fetch "
+               "buffer (max "
+            << SC_SIM_FETCH_BUFFER_MAX << ", cycle timing)\n"
+            << "  --prefetch        With --fetch-buffer (N >= 2): prefetch "
+               "the next line\n"
+            << "  --dcache <S>x<W>x<L> Data cache with S sets, W ways and "
+               "L-byte lines (cycle timing)\n"
+            << "  --dcache-policy <lru|fifo|random> Replacement policy "
+               "(default lru)\n"
+            << "  --dcache-write-through Write-through, no write-allocate "
+               "(default write-back)\n"
+            << "  --perf-json <file> Write stage cycles, cache counters and "
+               "AXI latencies as JSON (- for stdout)\n"
+            << "  --profile <file>  Profile guest PCs and write folded stacks "
+               "(flamegraph input)\n"
+            << "  --profile-period <N> Sample every N-th instruction "
+               "(default 1: every one)\n"
+            << "  --profile-elf <file> Symbolize the profile with this ELF's "
+               "symbol table\n"
+            << "  --profile-top <N> Print the N hottest functions at exit\n"
+            << "  --save-checkpoint <file> Save a checkpoint when the run "
+               "stops\n"
+            << "  --load-checkpoint <file> Start from a checkpoint instead of "
+               "an image\n"
+            << "  --bbv <file>      Fast-forward the whole run and write "
+               "SimPoint basic-block vectors\n"
+            << "  --simpoints <file> --simpoint-weights <file>\n"
+            << "                    Replay the chosen intervals in cycle mode "
+               "and estimate IPC\n"
+            << "  --simpoint-interval <N> Instructions per interval (default "
+            << SIMPOINT_INTERVAL << ")\n"
+            << "  --simpoint-warmup <N> Cycle-mode warmup before each interval "
+               "(default "
+            << WARMUP << ")\n"
+            << "  --simpoint-jobs <N> Replay threads (default: all cores)\n"
+            << "  --simpoint-ckpt <prefix> Also save each sample as "
+               "<prefix>.<interval>.ckpt\n"
             << "  -h, --help        Show this message\n";
 }
 
@@ -39,10 +128,35 @@ bool parse_args(int argc, char **argv, SimConfig &cfg) {
   static struct option long_options[] = {
       {"max-inst", required_argument, nullptr, 'i'},
       {"max-cycles", required_argument, nullptr, 'c'},
+      {"fast-forward", required_argument, nullptr, 'f'},
+      {"tlm", no_argument, nullptr, 't'},
+      {"store-buffer", required_argument, nullptr, 'B'},
+      {"fetch-buffer", required_argument, nullptr, 'F'},
+      {"prefetch", no_argument, nullptr, 'P'},
+      {"dcache", required_argument, nullptr, 'D'},
+      {"dcache-policy", required_argument, nullptr, 'R'},
+      {"dcache-write-through", no_argument, nullptr, 'W'},
+      {"perf-json", required_argument, nullptr, 'J'},
+      {"profile", required_argument, nullptr, 'X'},
+      {"profile-period", required_argument, nullptr, 'Y'},
+      {"profile-elf", required_argument, nullptr, 'E'},
+      {"profile-top", required_argument, nullptr, 'T'},
+      {"save-checkpoint", required_argument, nullptr, 's'},
+      {"load-checkpoint", required_argument, nullptr, 'r'},
+      {"bbv", required_argument, nullptr, 'b'},
+      {"simpoints", required_argument, nullptr, 'p'},
+      {"simpoint-weights", required_argument, nullptr, 'w'},
+      {"simpoint-interval", required_argument, nullptr, 'n'},
+      {"simpoint-warmup", required_argument, nullptr, 'u'},
+      {"simpoint-jobs", required_argument, nullptr, 'j'},
+      {"simpoint-ckpt", required_argument, nullptr, 'k'},
       {"help", no_argument, nullptr, 'h'},
       {nullptr, 0, nullptr, 0},
   };
 
+  cfg.simpoint.interval = SIMPOINT_INTERVAL;
+  cfg.simpoint.warmup = WARMUP;
+
   int opt = 0;
   int long_idx = 0;
   while ((opt = getopt_long(argc, argv, "h", long_options, &long_idx)) != -1) {
@@ -59,6 +173,116 @@ bool parse_args(int argc, char **argv, SimConfig &cfg) {
         return false;
       }
       break;
+    case 'f':
+      if (!parse_u64(optarg, cfg.fast_forward)) {
+        std::cerr << "Invalid --fast-forward: " << optarg << std::endl;
+        return false;
+      }
+      break;
+    case 't':
+      cfg.tlm = true;
+      break;
+    case 'F':
+      if (!parse_u64(optarg, cfg.fetch_buffer) ||
+          cfg.fetch_buffer > SC_SIM_FETCH_BUFFER_MAX) {
+        std::cerr << "Invalid --fetch-buffer: " << optarg << std::endl;
+        return false;
+      }
+      break;
+    case 'P':
+      cfg.prefetch = true;
+      break;
+    case 'D':
+      if (!parse_dcache_geometry(optarg, cfg)) {
+        std::cerr << "Invalid --dcache: " << optarg << std::endl;
+        return false;
+      }
+      break;
+    case 'R':
+      if (std::strcmp(optarg, "lru") == 0) {
+        cfg.dcache_policy = SC_SIM_DCACHE_LRU;
+      } else if (std::strcmp(optarg, "fifo") == 0) {
+        cfg.dcache_policy = SC_SIM_DCACHE_FIFO;
+      } else if (std::strcmp(optarg, "random") == 0) {
+        cfg.dcache_policy = SC_SIM_DCACHE_RANDOM;
+      } else {
+        std::cerr << "Invalid --dcache-policy: " << optarg << std::endl;
+        return false;
+      }
+      break;
+    case 'W':
+      cfg.dcache_write_through = true;
+      break;
+    case 'B':
+      if (!parse_u64(optarg, cfg.store_buffer) ||
+          cfg.store_buffer > SC_SIM_STORE_BUFFER_MAX) {
+        std::cerr << "Invalid --store-buffer: " << optarg << std::endl;
+        return false;
+      }
+      break;
+    case 'J':
+      cfg.perf_json = optarg;
+      break;
+    case 'X':
+      cfg.profile_path = optarg;
+      break;
+    case 'Y':
+      if (!parse_u64(optarg, cfg.profile_period) || cfg.profile_period == 0 ||
+          cfg.profile_period > 0xffffffffULL) {
+        std::cerr << "Invalid --profile-period: " << optarg << std::endl;
+        return false;
+      }
+      break;
+    case 'E':
+      cfg.profile_elf = optarg;
+      break;
+    case 'T':
+      if (!parse_u64(optarg, cfg.profile_top) || cfg.profile_top == 0 ||
+          cfg.profile_top > 0xffffffffULL) {
+        std::cerr << "Invalid --profile-top: " << optarg << std::endl;
+        return false;
+      }
+      break;
+    case 's':
+      cfg.save_checkpoint = optarg;
+      break;
+    case 'r':
+      cfg.load_checkpoint = optarg;
+      break;
+    case 'b':
+      cfg.bbv_path = optarg;
+      break;
+    case 'p':
+      cfg.simpoints_path = optarg;
+      break;
+    case 'w':
+      cfg.simpoint_weights_path = optarg;
+      break;
+    case 'n':
+      if (!parse_u64(optarg, cfg.simpoint.interval) ||
+          cfg.simpoint.interval == 0) {
+        std::cerr << "Invalid --simpoint-interval: " << optarg << std::endl;
+        return false;
+      }
+      break;
+    case 'u':
+      if (!parse_u64(optarg, cfg.simpoint.warmup)) {
+        std::cerr << "Invalid --simpoint-warmup: " << optarg << std::endl;
+        return false;
+      }
+      break;
+    case 'j': {
+      uint64_t jobs = 0;
+      if (!parse_u64(optarg, jobs)) {
+        std::cerr << "Invalid --simpoint-jobs: " << optarg << std::endl;
+        return false;
+      }
+      cfg.simpoint.jobs = static_cast<unsigned>(jobs);
+      break;
+    }
+    case 'k':
+      cfg.simpoint.checkpoint_prefix = optarg;
+      break;
     case 'h':
       print_help(argv[0]);
       std::exit(0);
@@ -68,11 +292,17 @@ bool parse_args(int argc, char **argv, SimConfig &cfg) {
     }
   }
 
-  if (optind >= argc) {
+  if (cfg.simpoints_path.empty() != cfg.simpoint_weights_path.empty()) {
+    std::cerr << "--simpoints and --simpoint-weights go together" << std::endl;
+    return false;
+  }
+
+  if (optind < argc) {
+    cfg.image_path = argv[optind];
+  } else if (cfg.load_checkpoint.empty()) {
     print_help(argv[0]);
     return false;
   }
-  cfg.image_path = argv[optind];
 
   if (const char *env_target_inst = std::getenv("TARGET_INST")) {
     uint64_t parsed = 0;
@@ -83,11 +313,13 @@ bool parse_args(int argc, char **argv, SimConfig &cfg) {
   return true;
 }
 
+// Binary AXI trace of the master port (decode with axi_trace_decode.out).
 struct AxiTraceWriter {
   bool enabled = false;
   uint64_t emitted = 0;
   uint64_t max_cycles = std::numeric_limits<uint64_t>::max();
-  std::ofstream file;
+  std::string path;
+  axi_trace::TraceWriter writer;
 
   void init_from_env() {
     const char *trace_flag = std::getenv("AXI_TRACE");
@@ -111,55 +343,35 @@ struct AxiTraceWriter {
       }
     }
 
-    std::string path = trace_path ? std::string(trace_path) : "axi4_trace.csv";
-    file.open(path, std::ios::out | std::ios::trunc);
-    if (!file.is_open()) {
-      std::cerr << "Warning: cannot open AXI trace file: " << path << std::endl;
+    path = trace_path ? std::string(trace_path) : "axi4_trace.axt";
+    std::string error;
+    if (!writer.open(path, error)) {
+      std::cerr << "Warning: " << error << std::endl;
       enabled = false;
-      return;
     }
-    file << "cycle,"
-         << "arvalid,arready,arid,araddr,arlen,arsize,"
-         << "awvalid,awready,awid,awaddr,awlen,awsize,"
-         << "wvalid,wready,wdata,wstrb,wlast,"
-         << "rvalid,rready,rid,rdata,rlast,"
-         << "bvalid,bready,bid,bresp\n";
   }
 
-  void emit(const sc_sim_status_t &status, const sc_axi4_in_t &in,
-            const sc_axi4_out_t &out) {
-    if (!enabled || !file.is_open() || emitted >= max_cycles) {
+  void emit(uint64_t cycle, const sc_axi4_in_t &in, const sc_axi4_out_t &out) {
+    if (!enabled || emitted >= max_cycles) {
       return;
     }
-    file << status.sim_time << ","
-         << static_cast<uint32_t>(out.arvalid) << ","
-         << static_cast<uint32_t>(in.arready) << ","
-         << static_cast<uint32_t>(out.arid) << ","
-         << static_cast<uint32_t>(out.araddr) << ","
-         << static_cast<uint32_t>(out.arlen) << ","
-         << static_cast<uint32_t>(out.arsize) << ","
-         << static_cast<uint32_t>(out.awvalid) << ","
-         << static_cast<uint32_t>(in.awready) << ","
-         << static_cast<uint32_t>(out.awid) << ","
-         << static_cast<uint32_t>(out.awaddr) << ","
-         << static_cast<uint32_t>(out.awlen) << ","
-         << static_cast<uint32_t>(out.awsize) << ","
-         << static_cast<uint32_t>(out.wvalid) << ","
-         << static_cast<uint32_t>(in.wready) << ","
-         << static_cast<uint32_t>(out.wdata) << ","
-         << static_cast<uint32_t>(out.wstrb) << ","
-         << static_cast<uint32_t>(out.wlast) << ","
-         << static_cast<uint32_t>(in.rvalid) << ","
-         << static_cast<uint32_t>(out.rready) << ","
-         << static_cast<uint32_t>(in.rid) << ","
-         << static_cast<uint32_t>(in.rdata) << ","
-         << static_cast<uint32_t>(in.rlast) << ","
-         << static_cast<uint32_t>(in.bvalid) << ","
-         << static_cast<uint32_t>(out.bready) << ","
-         << static_cast<uint32_t>(in.bid) << ","
-         << static_cast<uint32_t>(in.bresp) << "\n";
+    writer.record(cycle, in, out);
     emitted++;
   }
+
+  void finish() {
+    if (!enabled) {
+      return;
+    }
+    if (!writer.close()) {
+      std::cerr << "Warning: failed to write AXI trace file: " << path
+                << std::endl;
+      return;
+    }
+    std::cout << "[single-cycle-axi4] axi_trace=" << path
+              << " cycles=" << emitted << " records=" << writer.records()
+              << std::endl;
+  }
 };
 
 void sample_ddr_outputs(const sim_ddr::SimDDR_IO_t &ddr_io, sc_axi4_in_t &in) {
@@ -200,6 +412,77 @@ void drive_ddr_inputs(sim_ddr::SimDDR_IO_t &ddr_io, const sc_axi4_out_t &out) {
   ddr_io.b.bready = out.bready;
 }
 
+// Callback slave used when AXI tracing is on: the simulator's built-in DDR
+// never exposes the per-cycle signals, so drive an external SimDDR instead.
+struct TracedDdrSlave {
+  sim_ddr::SimDDR ddr;
+  AxiTraceWriter *trace = nullptr;
+};
+
+void traced_ddr_cycle(void *user, uint64_t cycle, const sc_axi4_out_t *out,
+                      sc_axi4_in_t *in) {
+  auto *slave = static_cast<TracedDdrSlave *>(user);
+  slave->trace->emit(cycle, *in, *out);
+  drive_ddr_inputs(slave->ddr.io, *out);
+  slave->ddr.comb_inputs();
+  slave->ddr.seq();
+  slave->ddr.comb_outputs();
+  sample_ddr_outputs(slave->ddr.io, *in);
+}
+
+constexpr uint64_t kCyclesPerBatch = 1ull << 20;
+
+// Sampled-simulation modes replace the normal run.
+int run_simpoint(sc_sim_handle *sim, SimConfig &cfg) {
+  std::string error;
+  if (!cfg.bbv_path.empty()) {
+    SimPointProfile profile;
+    cfg.simpoint.uart_out = stdout;
+    if (!simpoint_profile(sim, cfg.simpoint, cfg.bbv_path.c_str(), profile,
+                          error)) {
+      std::cerr << "Error: " << error << std::endl;
+      return 1;
+    }
+    std::cout << "\n[simpoint] bbv=" << cfg.bbv_path
+              << " interval=" << cfg.simpoint.interval
+              << " intervals=" << profile.intervals
+              << " blocks=" << profile.blocks
+              << " inst_count=" << profile.inst_count << std::endl;
+    return 0;
+  }
+
+  SimPointResult result;
+  const auto begin = std::chrono::steady_clock::now();
+  const bool ok =
+      simpoint_replay(sim, cfg.simpoint, cfg.simpoints_path.c_str(),
+                      cfg.simpoint_weights_path.c_str(), result, error);
+  for (const SimPointSample &sample : result.samples) {
+    std::cout << "[simpoint] interval=" << sample.interval
+              << " weight=" << sample.weight
+              << " warmup=" << sample.warmup_inst;
+    if (sample.ok) {
+      std::cout << " inst=" << sample.inst << " cycles=" << sample.cycles
+                << " ipc="
+                << static_cast<double>(sample.inst) /
+                       static_cast<double>(sample.cycles);
+    } else {
+      std::cout << " skipped: " << sample.error;
+    }
+    std::cout << std::endl;
+  }
+  if (!ok) {
+    std::cerr << "Error: " << error << std::endl;
+    return 1;
+  }
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - begin)
+                             .count();
+  std::cout << "[simpoint] estimated_ipc=" << result.ipc
+            << " weight_used=" << result.weight_used
+            << " seconds=" << seconds << std::endl;
+  return 0;
+}
+
 } // namespace
 
 int main(int argc, char **argv) {
@@ -216,54 +499,175 @@ int main(int argc, char **argv) {
   sc_sim_set_limits(sim, cfg.max_inst, cfg.max_cycles);
 
   uint64_t image_size = 0;
-  if (sc_sim_load_image(sim, cfg.image_path.c_str(), &image_size) != 0) {
+  const int load_rc =
+      cfg.load_checkpoint.empty()
+          ? sc_sim_load_image(sim, cfg.image_path.c_str(), &image_size)
+          : sc_sim_load_checkpoint(sim, cfg.load_checkpoint.c_str());
+  if (load_rc != 0) {
     std::cerr << "Error: " << sc_sim_last_error(sim) << std::endl;
     sc_sim_destroy(sim);
     return 1;
   }
 
-  sim_ddr::SimDDR ddr;
-  ddr.init();
-  ddr.comb_outputs();
-
   AxiTraceWriter trace_writer;
   trace_writer.init_from_env();
 
-  std::cout << "[single-cycle-axi4] image=" << cfg.image_path
+  TracedDdrSlave traced_slave;
+  if (trace_writer.enabled && cfg.tlm) {
+    std::cerr << "Warning: AXI trace needs cycle timing, ignoring --tlm"
+              << std::endl;
+    cfg.tlm = false;
+  }
+  if (cfg.tlm && sc_sim_set_timing_mode(sim, SC_SIM_TIMING_TLM) != 0) {
+    std::cerr << "Error: " << sc_sim_last_error(sim) << std::endl;
+    sc_sim_destroy(sim);
+    return 1;
+  }
+  if (cfg.store_buffer != 0 &&
+      sc_sim_set_store_buffer(sim, static_cast<uint32_t>(cfg.store_buffer)) !=
+          0) {
+    std::cerr << "Error: " << sc_sim_last_error(sim) << std::endl;
+    sc_sim_destroy(sim);
+    return 1;
+  }
+  if ((cfg.fetch_buffer != 0 || cfg.prefetch) &&
+      sc_sim_set_fetch_buffer(sim, static_cast<uint32_t>(cfg.fetch_buffer),
+                              cfg.prefetch ? 1 : 0) != 0) {
+    std::cerr << "Error: " << sc_sim_last_error(sim) << std::endl;
+    sc_sim_destroy(sim);
+    return 1;
+  }
+  if (cfg.dcache_sets != 0 &&
+      sc_sim_set_dcache(sim, cfg.dcache_sets, cfg.dcache_ways, cfg.dcache_line,
+                        cfg.dcache_policy,
+                        cfg.dcache_write_through ? 0 : 1) != 0) {
+    std::cerr << "Error: " << sc_sim_last_error(sim) << std::endl;
+    sc_sim_destroy(sim);
+    return 1;
+  }
+
+  const bool profiling = !cfg.profile_path.empty() || cfg.profile_top != 0;
+  if (profiling) {
+    sc_sim_set_pc_profiling(sim, static_cast<uint32_t>(cfg.profile_period));
+  }
+
+  if (trace_writer.enabled) {
+    sc_axi4_in_t initial_in{};
+    traced_slave.trace = &trace_writer;
+    traced_slave.ddr.set_memory(sc_sim_get_memory(sim));
+    traced_slave.ddr.init();
+    traced_slave.ddr.comb_outputs();
+    sample_ddr_outputs(traced_slave.ddr.io, initial_in);
+    sc_sim_set_slave(sim, traced_ddr_cycle, &traced_slave, &initial_in);
+  }
+
+  std::cout << "[single-cycle-axi4] "
+            << (cfg.load_checkpoint.empty() ? "image=" : "checkpoint=")
+            << (cfg.load_checkpoint.empty() ? cfg.image_path
+                                            : cfg.load_checkpoint)
             << " size=" << image_size
             << " max_inst=" << cfg.max_inst
             << " max_cycles=" << cfg.max_cycles
-            << " ddr_latency=" << ICACHE_MISS_LATENCY << std::endl;
+            << " ddr_latency=" << ICACHE_MISS_LATENCY
+            << " timing=" << (cfg.tlm ? "tlm" : "cycle") << std::endl;
+
+  if (!cfg.bbv_path.empty() || !cfg.simpoints_path.empty()) {
+    const int simpoint_rc = run_simpoint(sim, cfg);
+    sc_sim_destroy(sim);
+    return simpoint_rc;
+  }
 
-  sc_axi4_in_t axi_in{};
-  sc_axi4_out_t axi_out{};
   sc_sim_status_t status{};
+  sc_sim_get_status(sim, &status);
 
   int rc = 0;
-  uint64_t last_progress_inst = 0;
-  while (true) {
-    sample_ddr_outputs(ddr.io, axi_in);
+  if (cfg.fast_forward > 0) {
+    const auto ff_begin = std::chrono::steady_clock::now();
+    uint64_t remaining = cfg.fast_forward;
+    while (remaining > 0) {
+      const uint64_t before = status.inst_count;
+      rc = sc_sim_fast_forward(sim, remaining, &status);
+      if (status.uart_valid) {
+        std::cout << static_cast<char>(status.uart_ch) << std::flush;
+      }
+      const uint64_t done = status.inst_count - before;
+      if (rc != 0 || done == 0) {
+        break;
+      }
+      remaining -= (done < remaining) ? done : remaining;
+    }
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - ff_begin)
+                               .count();
+    std::cout << "[single-cycle-axi4] fast-forward inst=" << status.inst_count
+              << " sim_time=" << status.sim_time << " mips="
+              << (seconds > 0 ? status.inst_count / seconds / 1e6 : 0.0)
+              << std::endl;
+  }
 
-    rc = sc_sim_step(sim, &axi_in, &axi_out, &status);
-    trace_writer.emit(status, axi_in, axi_out);
+  uint64_t last_progress_inst = status.inst_count;
+  while (rc == 0) {
+    rc = sc_sim_step_n(sim, kCyclesPerBatch, SC_SIM_STOP_UART, &status);
 
     if (status.uart_valid) {
       std::cout << static_cast<char>(status.uart_ch) << std::flush;
     }
 
-    drive_ddr_inputs(ddr.io, axi_out);
-    ddr.comb_inputs();
-    ddr.seq();
-    ddr.comb_outputs();
-
     if (status.inst_count / 5000000ull != last_progress_inst / 5000000ull) {
       std::cout << "[single-cycle-axi4] inst=" << status.inst_count
                 << " sim_time=" << status.sim_time << std::endl;
       last_progress_inst = status.inst_count;
     }
+  }
 
-    if (rc != 0) {
-      break;
+  trace_writer.finish();
+
+  sc_sim_tlb_stats_t tlb_stats{};
+  sc_sim_get_tlb_stats(sim, &tlb_stats);
+  if (tlb_stats.itlb_hit + tlb_stats.itlb_miss + tlb_stats.dtlb_hit +
+          tlb_stats.dtlb_miss >
+      0) {
+    std::cout << "[single-cycle-axi4] itlb hit=" << tlb_stats.itlb_hit
+              << " miss=" << tlb_stats.itlb_miss
+              << " dtlb hit=" << tlb_stats.dtlb_hit
+              << " miss=" << tlb_stats.dtlb_miss
+              << " flushes=" << tlb_stats.flushes << std::endl;
+  }
+  sc_sim_dcache_stats_t dcache_stats{};
+  sc_sim_get_dcache_stats(sim, &dcache_stats);
+  if (dcache_stats.accesses != 0) {
+    std::cout << "[single-cycle-axi4] dcache access=" << dcache_stats.accesses
+              << " miss=" << dcache_stats.misses
+              << " writeback=" << dcache_stats.writebacks << std::endl;
+  }
+  if (!cfg.perf_json.empty()) {
+    std::cout << std::flush;
+    if (sc_sim_write_perf_json(sim, cfg.perf_json.c_str()) != 0) {
+      std::cerr << "Error: " << sc_sim_last_error(sim) << std::endl;
+    }
+  }
+  if (profiling) {
+    std::cout << std::flush;
+    if (sc_sim_write_pc_profile(
+            sim, cfg.profile_path.empty() ? nullptr : cfg.profile_path.c_str(),
+            cfg.profile_top != 0 ? "-" : nullptr,
+            cfg.profile_elf.empty() ? nullptr : cfg.profile_elf.c_str(),
+            static_cast<uint32_t>(cfg.profile_top)) != 0) {
+      std::cerr << "Error: " << sc_sim_last_error(sim) << std::endl;
+    } else if (!cfg.profile_path.empty()) {
+      std::cout << "[single-cycle-axi4] profile=" << cfg.profile_path
+                << std::endl;
+    }
+  }
+  std::cout << "[single-cycle-axi4] resident_mem_kb="
+            << sc_sim_get_resident_memory(sim) / 1024 << std::endl;
+
+  if (!cfg.save_checkpoint.empty()) {
+    if (sc_sim_save_checkpoint(sim, cfg.save_checkpoint.c_str()) == 0) {
+      std::cout << "[single-cycle-axi4] checkpoint saved: "
+                << cfg.save_checkpoint << std::endl;
+    } else {
+      std::cerr << "Error: " << sc_sim_last_error(sim) << std::endl;
     }
   }
 
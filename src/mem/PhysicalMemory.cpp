@@ -0,0 +1,232 @@
+/**
+ * @file PhysicalMemory.cpp
+ * @brief Sparse physical memory: page-table walk, allocation and
+ *        copy-on-write slow paths.
+ */
+
+#include "PhysicalMemory.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+// Unmapped pages read from here, so the read cache can hold them as well.
+const uint32_t kZeroPage[PhysicalMemory::kPageWords] = {};
+} // namespace
+
+PhysicalMemory::PhysicalMemory(PhysicalMemory &other)
+    : page_count_(other.page_count_), mapped_count_(other.mapped_count_) {
+  reset_caches();
+  other.write_tag_ = kNoPage;
+  other.write_page_ = nullptr;
+  for (uint32_t i = 0; i < kRootEntries; ++i) {
+    const Leaf *src = other.root_[i];
+    if (src == nullptr) {
+      continue;
+    }
+    Leaf *leaf = new Leaf(*src);
+    leaf_count_++;
+    for (uint32_t j = 0; j < kLeafEntries; ++j) {
+      if (leaf->pages[j] != nullptr) {
+        leaf->pages[j]->refs.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    root_[i] = leaf;
+  }
+}
+
+void PhysicalMemory::release(Page *page) {
+  if (page == nullptr ||
+      page->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    return;
+  }
+  if (page->mapping != nullptr) {
+    release(page->mapping);
+    delete page;
+  } else {
+    delete static_cast<OwnedPage *>(page);
+  }
+}
+
+void PhysicalMemory::release(Mapping *mapping) {
+  if (mapping->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    munmap(mapping->base, mapping->bytes);
+    delete mapping;
+  }
+}
+
+PhysicalMemory::Page *PhysicalMemory::find_page(uint32_t page) const {
+  const Leaf *leaf = root_[page >> kLeafBits];
+  if (leaf == nullptr) {
+    return nullptr;
+  }
+  return leaf->pages[page & (kLeafEntries - 1)];
+}
+
+// Returns storage this instance may modify: allocates an unmapped page and
+// un-shares a page still referenced by another fork.
+uint32_t *PhysicalMemory::writable_page(uint32_t page) {
+  Leaf *&leaf = root_[page >> kLeafBits];
+  if (leaf == nullptr) {
+    leaf = new Leaf();
+    leaf_count_++;
+  }
+  Page *&slot = leaf->pages[page & (kLeafEntries - 1)];
+  if (slot == nullptr) {
+    slot = new OwnedPage();
+    page_count_++;
+  } else if (slot->mapping != nullptr ||
+             slot->refs.load(std::memory_order_acquire) != 1) {
+    Page *copy = new OwnedPage();
+    std::memcpy(copy->words, slot->words, kPageBytes);
+    if (slot->mapping != nullptr) {
+      mapped_count_--;
+    }
+    release(slot);
+    slot = copy;
+  } else {
+    return slot->words;
+  }
+  // The read cache may still point at the zero page or the shared original.
+  const uint32_t cached = page & (kReadCacheSize - 1);
+  if (read_tag_[cached] == page) {
+    read_page_[cached] = slot->words;
+  }
+  return slot->words;
+}
+
+void PhysicalMemory::refill_read(uint32_t page) {
+  const Page *ptr = find_page(page);
+  const uint32_t slot = page & (kReadCacheSize - 1);
+  read_tag_[slot] = page;
+  read_page_[slot] = (ptr != nullptr) ? ptr->words : kZeroPage;
+}
+
+// Returns false when the write can be dropped: zero into an unmapped page.
+bool PhysicalMemory::refill_write(uint32_t paddr, uint32_t data) {
+  const uint32_t page = paddr >> kPageShift;
+  if (data == 0 && find_page(page) == nullptr) {
+    return false;
+  }
+  write_page_ = writable_page(page);
+  write_tag_ = page;
+  return true;
+}
+
+void PhysicalMemory::write_bytes(uint32_t paddr, const void *src, size_t len) {
+  const uint8_t *in = static_cast<const uint8_t *>(src);
+  uint64_t addr = paddr;
+  while (len > 0) {
+    const uint32_t page = static_cast<uint32_t>(addr >> kPageShift);
+    const uint32_t offset = static_cast<uint32_t>(addr & (kPageBytes - 1));
+    const size_t n = std::min<size_t>(len, kPageBytes - offset);
+    uint8_t *dst = reinterpret_cast<uint8_t *>(writable_page(page));
+    std::memcpy(dst + offset, in, n);
+    in += n;
+    addr += n;
+    len -= n;
+  }
+}
+
+bool PhysicalMemory::map_file(int fd, uint64_t offset, uint32_t paddr,
+                             uint64_t len) {
+  const uint64_t end = static_cast<uint64_t>(paddr) + len;
+  const uint64_t first =
+      (static_cast<uint64_t>(paddr) + kPageBytes - 1) & ~uint64_t{kPageBytes - 1};
+  const uint64_t last = end & ~uint64_t{kPageBytes - 1};
+  if (((offset ^ paddr) & (kPageBytes - 1)) != 0 || first >= last) {
+    return copy_file(fd, offset, paddr, len);
+  }
+
+  // mmap 的偏移需按宿主页大小对齐，宿主页可能大于 4 KiB
+  const uint64_t file_first = offset + (first - paddr);
+  const auto host_page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  const uint64_t delta = file_first & (host_page - 1);
+  const size_t bytes = static_cast<size_t>(last - first + delta);
+  void *base = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd,
+                    static_cast<off_t>(file_first - delta));
+  if (base == MAP_FAILED) {
+    return copy_file(fd, offset, paddr, len);
+  }
+  auto *mapping = new Mapping{{1}, base, bytes};
+  auto *words = reinterpret_cast<uint32_t *>(static_cast<uint8_t *>(base) + delta);
+  for (uint64_t addr = first; addr < last; addr += kPageBytes) {
+    const auto page = static_cast<uint32_t>(addr >> kPageShift);
+    Leaf *&leaf = root_[page >> kLeafBits];
+    if (leaf == nullptr) {
+      leaf = new Leaf();
+      leaf_count_++;
+    }
+    Page *&slot = leaf->pages[page & (kLeafEntries - 1)];
+    if (slot == nullptr) {
+      page_count_++;
+    } else if (slot->mapping != nullptr) {
+      mapped_count_--;
+    }
+    release(slot);
+    slot = new Page();
+    slot->words = words + (addr - first) / 4;
+    slot->mapping = mapping;
+    mapping->refs.fetch_add(1, std::memory_order_relaxed);
+    mapped_count_++;
+  }
+  release(mapping);
+  reset_caches();
+
+  return copy_file(fd, offset, paddr, first - paddr) &&
+         copy_file(fd, offset + (last - paddr), static_cast<uint32_t>(last),
+                   end - last);
+}
+
+bool PhysicalMemory::copy_file(int fd, uint64_t offset, uint32_t paddr,
+                               uint64_t len) {
+  char chunk[64 * 1024];
+  uint64_t done = 0;
+  while (done < len) {
+    const size_t n = static_cast<size_t>(
+        std::min<uint64_t>(sizeof(chunk), len - done));
+    const ssize_t got = pread(fd, chunk, n, static_cast<off_t>(offset + done));
+    if (got <= 0) {
+      return false;
+    }
+    write_bytes(paddr + static_cast<uint32_t>(done), chunk,
+                static_cast<size_t>(got));
+    done += static_cast<uint64_t>(got);
+  }
+  return true;
+}
+
+void PhysicalMemory::clear() {
+  for (uint32_t i = 0; i < kRootEntries; ++i) {
+    Leaf *leaf = root_[i];
+    if (leaf == nullptr) {
+      continue;
+    }
+    for (uint32_t j = 0; j < kLeafEntries; ++j) {
+      release(leaf->pages[j]);
+    }
+    delete leaf;
+    root_[i] = nullptr;
+  }
+  page_count_ = 0;
+  mapped_count_ = 0;
+  leaf_count_ = 0;
+  reset_caches();
+}
+
+void PhysicalMemory::reset_caches() {
+  for (uint32_t i = 0; i < kReadCacheSize; ++i) {
+    read_tag_[i] = kNoPage;
+    read_page_[i] = nullptr;
+  }
+  write_tag_ = kNoPage;
+  write_page_ = nullptr;
+}
+
+uint64_t PhysicalMemory::resident_bytes() const {
+  return (page_count_ - mapped_count_) * kPageBytes +
+         mapped_count_ * sizeof(Page) + leaf_count_ * sizeof(Leaf) +
+         sizeof(*this);
+}
@@ -0,0 +1,169 @@
+#pragma once
+/**
+ * @file PhysicalMemory.h
+ * @brief Sparse backing store for the simulated 32-bit physical address space.
+ *
+ * Each simulator handle owns one instance; the CPU memory hooks, the AXI
+ * read/write mirrors and SimDDR all access memory through it, so independent
+ * handles never share state.
+ *
+ * Storage is a two-level table of 4 KiB pages allocated on the first non-zero
+ * write. Untouched memory reads as zero. Reads go through a small
+ * direct-mapped page cache (instruction and data pages don't evict each
+ * other) and writes through a last-page cache, so a hot access costs one tag
+ * compare.
+ *
+ * Pages are reference counted. Copying a PhysicalMemory (used to fork a
+ * simulation) shares every page copy-on-write: the first write to a shared
+ * page gives the writer a private copy. The counts are atomic, so the copies
+ * may run in different threads.
+ *
+ * map_file() backs pages with a read-only mmap of an image file instead of
+ * copying it. Such pages are shared with the host page cache, are not
+ * counted as resident, and are copied on their first write like forked
+ * pages. The mapping is released with the last page that uses it.
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class PhysicalMemory {
+public:
+  static constexpr uint32_t kPageShift = 12;
+  static constexpr uint32_t kPageBytes = 1u << kPageShift;
+  static constexpr uint32_t kPageWords = kPageBytes / 4;
+  static constexpr uint32_t kLeafBits = 10;
+  static constexpr uint32_t kLeafEntries = 1u << kLeafBits;
+  static constexpr uint32_t kRootEntries = 1u << (32 - kPageShift - kLeafBits);
+
+  PhysicalMemory() { reset_caches(); }
+  ~PhysicalMemory() { clear(); }
+
+  // Copy-on-write fork. Takes a non-const source because the source must
+  // drop its write cache: the page it points at becomes shared.
+  PhysicalMemory(PhysicalMemory &other);
+  PhysicalMemory &operator=(const PhysicalMemory &) = delete;
+
+  uint32_t read32(uint32_t paddr) {
+    const uint32_t page = paddr >> kPageShift;
+    const uint32_t slot = page & (kReadCacheSize - 1);
+    if (read_tag_[slot] != page) {
+      refill_read(page);
+    }
+    return read_page_[slot][(paddr >> 2) & (kPageWords - 1)];
+  }
+
+  void write32(uint32_t paddr, uint32_t data) {
+    if ((paddr >> kPageShift) != write_tag_ && !refill_write(paddr, data)) {
+      return;
+    }
+    write_page_[(paddr >> 2) & (kPageWords - 1)] = data;
+  }
+
+  void write32(uint32_t paddr, uint32_t data, uint32_t wstrb) {
+    uint32_t mask = 0;
+    if (wstrb & 0x1) {
+      mask |= 0x000000FFu;
+    }
+    if (wstrb & 0x2) {
+      mask |= 0x0000FF00u;
+    }
+    if (wstrb & 0x4) {
+      mask |= 0x00FF0000u;
+    }
+    if (wstrb & 0x8) {
+      mask |= 0xFF000000u;
+    }
+    if ((paddr >> kPageShift) != write_tag_ &&
+        !refill_write(paddr, data & mask)) {
+      return;
+    }
+    uint32_t &word = write_page_[(paddr >> 2) & (kPageWords - 1)];
+    word = (data & mask) | (word & ~mask);
+  }
+
+  // Byte-granular host access, used by image loading.
+  void write_bytes(uint32_t paddr, const void *src, size_t len);
+
+  // Loads len bytes of an open file from `offset` to paddr. Whole pages whose
+  // file offset lines up with paddr modulo the page size are mapped from the
+  // file, the rest is read and copied. Returns false on a read error.
+  bool map_file(int fd, uint64_t offset, uint32_t paddr, uint64_t len);
+
+  // Drops every page; memory reads as zero afterwards.
+  void clear();
+
+  // Whole-page access for checkpoints. mutable_page() allocates or un-shares
+  // like a write would.
+  uint32_t *mutable_page(uint32_t page) { return writable_page(page); }
+
+  // Calls fn(page_number, words) for every mapped page in address order.
+  template <typename Fn> void for_each_page(Fn &&fn) const {
+    for (uint32_t i = 0; i < kRootEntries; ++i) {
+      const Leaf *leaf = root_[i];
+      if (leaf == nullptr) {
+        continue;
+      }
+      for (uint32_t j = 0; j < kLeafEntries; ++j) {
+        if (leaf->pages[j] != nullptr) {
+          fn((i << kLeafBits) | j,
+             static_cast<const uint32_t *>(leaf->pages[j]->words));
+        }
+      }
+    }
+  }
+
+  uint64_t page_count() const { return page_count_; }
+  // Pages still backed by a file mapping (included in page_count()).
+  uint64_t mapped_page_count() const { return mapped_count_; }
+
+  // Host memory held by pages and page tables. Shared pages are counted by
+  // every instance that maps them; file-backed pages are not counted.
+  uint64_t resident_bytes() const;
+
+private:
+  struct Mapping {
+    std::atomic<uint32_t> refs{1}; // one per page, plus the loader's
+    void *base;
+    size_t bytes;
+  };
+
+  struct Page {
+    std::atomic<uint32_t> refs{1};
+    uint32_t *words;
+    Mapping *mapping = nullptr; // words point into a read-only file mapping
+  };
+
+  struct OwnedPage : Page {
+    OwnedPage() { words = storage; }
+    uint32_t storage[kPageWords] = {};
+  };
+
+  struct Leaf {
+    Page *pages[kLeafEntries];
+  };
+
+  Page *find_page(uint32_t page) const;
+  uint32_t *writable_page(uint32_t page);
+  void refill_read(uint32_t page);
+  bool refill_write(uint32_t paddr, uint32_t data);
+  void reset_caches();
+  bool copy_file(int fd, uint64_t offset, uint32_t paddr, uint64_t len);
+  static void release(Page *page);
+  static void release(Mapping *mapping);
+
+  Leaf *root_[kRootEntries] = {};
+  uint64_t page_count_ = 0;
+  uint64_t mapped_count_ = 0;
+  uint64_t leaf_count_ = 0;
+
+  // Page caches. kNoPage never matches a page number (20 bits). The write
+  // cache only ever holds a page this instance owns exclusively.
+  static constexpr uint32_t kNoPage = 0xFFFFFFFFu;
+  static constexpr uint32_t kReadCacheSize = 16;
+  uint32_t read_tag_[kReadCacheSize];
+  const uint32_t *read_page_[kReadCacheSize];
+  uint32_t write_tag_ = kNoPage;
+  uint32_t *write_page_ = nullptr;
+};
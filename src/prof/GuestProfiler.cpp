@@ -0,0 +1,240 @@
+/**
+ * @file GuestProfiler.cpp
+ * @brief Shadow call stack, symbolization and folded/hot-spot output.
+ */
+
+#include "GuestProfiler.h"
+
+#include <algorithm>
+#include <map>
+
+namespace guest_prof {
+
+namespace {
+
+constexpr const char *kFastForwardFrame = "[fast-forward]";
+constexpr const char *kUnsampledFrame = "[unsampled]";
+
+inline bool is_link_reg(uint32_t reg) { return reg == 1 || reg == 5; }
+
+std::string hex_name(uint32_t pc) {
+  char buf[16];
+  std::snprintf(buf, sizeof(buf), "0x%08x", pc);
+  return buf;
+}
+
+} // namespace
+
+// ---------------- SymbolTable ----------------
+
+bool SymbolTable::load_elf(const std::string &path, std::string &error) {
+  elf32::ElfFile elf;
+  return elf.open(path, error) && elf.read_symbols(symbols_, error);
+}
+
+std::string SymbolTable::name(uint32_t pc) const {
+  auto it = std::upper_bound(
+      symbols_.begin(), symbols_.end(), pc,
+      [](uint32_t value, const elf32::Symbol &s) { return value < s.addr; });
+  if (it == symbols_.begin()) {
+    return hex_name(pc);
+  }
+  --it;
+  if (it->size != 0 && pc - it->addr >= it->size) {
+    return hex_name(pc);
+  }
+  return it->name;
+}
+
+// ---------------- GuestProfiler ----------------
+
+void GuestProfiler::configure(uint32_t period, uint64_t now) {
+  period_ = period;
+  countdown_ = period;
+  start_ = now;
+  mark_ = now;
+  samples_ = 0;
+  fast_forward_cycles_ = 0;
+  nodes_.assign(1, Node{0, 0});
+  children_.clear();
+  counts_.clear();
+  node_ = 0;
+  depth_ = 0;
+  lost_depth_ = 0;
+}
+
+// RISC-V 返回地址栈提示（非特权规范表 2.1）：rd 为 ra/t0 视为调用，
+// rs1 为 ra/t0 且 rd 不是视为返回，两者都是且不同则先返回再调用（协程切换）。
+void GuestProfiler::track_jump(uint32_t pc, uint32_t inst) {
+  const uint32_t rd = (inst >> 7) & 0x1f;
+  const uint32_t rs1 = (inst >> 15) & 0x1f;
+  if ((inst & 0x7f) == 0x6f) {
+    if (is_link_reg(rd)) {
+      push(pc);
+    }
+    return;
+  }
+  if (is_link_reg(rd)) {
+    if (is_link_reg(rs1) && rd != rs1) {
+      pop();
+    }
+    push(pc);
+  } else if (is_link_reg(rs1)) {
+    pop();
+  }
+}
+
+void GuestProfiler::push(uint32_t call_pc) {
+  if (depth_ >= kMaxDepth) {
+    lost_depth_++;
+    return;
+  }
+  const uint64_t key = (static_cast<uint64_t>(node_) << 32) | call_pc;
+  auto it = children_.find(key);
+  if (it == children_.end()) {
+    if (nodes_.size() >= kMaxNodes) {
+      lost_depth_++;
+      return;
+    }
+    const auto id = static_cast<uint32_t>(nodes_.size());
+    nodes_.push_back(Node{node_, call_pc});
+    it = children_.emplace(key, id).first;
+  }
+  node_ = it->second;
+  depth_++;
+}
+
+void GuestProfiler::pop() {
+  if (lost_depth_ != 0) {
+    lost_depth_--;
+  } else if (depth_ != 0) {
+    node_ = nodes_[node_].parent;
+    depth_--;
+  }
+}
+
+void GuestProfiler::stack_prefixes(const SymbolTable &symbols,
+                                   std::vector<std::string> &prefixes) const {
+  // 父节点总是先于子节点创建，按编号顺序即可逐层拼接
+  prefixes.assign(nodes_.size(), std::string());
+  for (size_t id = 1; id < nodes_.size(); ++id) {
+    const Node &n = nodes_[id];
+    prefixes[id] = prefixes[n.parent] + symbols.name(n.call_pc) + ";";
+  }
+}
+
+bool GuestProfiler::write_folded(const std::string &path,
+                                 const SymbolTable &symbols, uint64_t now,
+                                 std::string &error) const {
+  std::vector<std::string> prefixes;
+  stack_prefixes(symbols, prefixes);
+  std::map<std::string, uint64_t> folded;
+  for (const auto &[key, count] : counts_) {
+    const auto node = static_cast<uint32_t>(key >> 32);
+    const auto pc = static_cast<uint32_t>(key);
+    folded[prefixes[node] + symbols.name(pc)] += count.cycles;
+  }
+  if (fast_forward_cycles_ != 0) {
+    folded[kFastForwardFrame] += fast_forward_cycles_;
+  }
+  if (now > mark_) {
+    folded[kUnsampledFrame] += now - mark_;
+  }
+
+  FILE *out = std::fopen(path.c_str(), "w");
+  if (out == nullptr) {
+    error = "cannot open profile output: " + path;
+    return false;
+  }
+  for (const auto &[stack, cycles] : folded) {
+    if (cycles != 0) {
+      std::fprintf(out, "%s %llu\n", stack.c_str(),
+                   static_cast<unsigned long long>(cycles));
+    }
+  }
+  if (std::fclose(out) != 0) {
+    error = "failed to write profile output: " + path;
+    return false;
+  }
+  return true;
+}
+
+void GuestProfiler::hot_spots(const SymbolTable &symbols, uint64_t now,
+                              std::vector<HotSpot> &out) const {
+  std::unordered_map<std::string, HotSpot> by_name;
+  std::unordered_map<uint32_t, std::string> names;
+  auto name_of = [&](uint32_t pc) -> const std::string & {
+    auto it = names.find(pc);
+    if (it == names.end()) {
+      it = names.emplace(pc, symbols.name(pc)).first;
+    }
+    return it->second;
+  };
+
+  std::vector<const std::string *> frames;
+  for (const auto &[key, count] : counts_) {
+    const auto node = static_cast<uint32_t>(key >> 32);
+    const auto pc = static_cast<uint32_t>(key);
+    const std::string &leaf = name_of(pc);
+    HotSpot &self = by_name[leaf];
+    self.self_cycles += count.cycles;
+    self.samples += count.samples;
+
+    // 递归函数在栈上出现多次时只计一次 inclusive
+    frames.assign(1, &leaf);
+    for (uint32_t id = node; id != 0; id = nodes_[id].parent) {
+      frames.push_back(&name_of(nodes_[id].call_pc));
+    }
+    for (size_t i = 0; i < frames.size(); ++i) {
+      if (std::find_if(frames.begin(), frames.begin() + i,
+                       [&](const std::string *f) { return *f == *frames[i]; }) ==
+          frames.begin() + i) {
+        by_name[*frames[i]].total_cycles += count.cycles;
+      }
+    }
+  }
+  if (fast_forward_cycles_ != 0) {
+    HotSpot &ff = by_name[kFastForwardFrame];
+    ff.self_cycles = ff.total_cycles = fast_forward_cycles_;
+  }
+  if (now > mark_) {
+    HotSpot &tail = by_name[kUnsampledFrame];
+    tail.self_cycles = tail.total_cycles = now - mark_;
+  }
+
+  out.clear();
+  out.reserve(by_name.size());
+  for (auto &[name, spot] : by_name) {
+    spot.name = name;
+    out.push_back(std::move(spot));
+  }
+  std::sort(out.begin(), out.end(), [](const HotSpot &a, const HotSpot &b) {
+    return a.self_cycles != b.self_cycles ? a.self_cycles > b.self_cycles
+                                          : a.name < b.name;
+  });
+}
+
+void GuestProfiler::write_hot_spots(FILE *out, const SymbolTable &symbols,
+                                    uint64_t now, uint32_t top) const {
+  std::vector<HotSpot> spots;
+  hot_spots(symbols, now, spots);
+  const uint64_t total = total_cycles(now);
+  const double scale = total != 0 ? 100.0 / static_cast<double>(total) : 0.0;
+  std::fprintf(out, "[guest-prof] period=%u samples=%llu cycles=%llu\n",
+               period_, static_cast<unsigned long long>(samples_),
+               static_cast<unsigned long long>(total));
+  std::fprintf(out, "  %7s %7s %14s %10s  %s\n", "self%", "total%",
+               "self_cycles", "samples", "function");
+  const size_t n = (top == 0) ? spots.size()
+                              : std::min<size_t>(top, spots.size());
+  for (size_t i = 0; i < n; ++i) {
+    const HotSpot &s = spots[i];
+    std::fprintf(out, "  %7.2f %7.2f %14llu %10llu  %s\n",
+                 static_cast<double>(s.self_cycles) * scale,
+                 static_cast<double>(s.total_cycles) * scale,
+                 static_cast<unsigned long long>(s.self_cycles),
+                 static_cast<unsigned long long>(s.samples), s.name.c_str());
+  }
+}
+
+} // namespace guest_prof
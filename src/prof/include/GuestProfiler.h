@@ -0,0 +1,139 @@
+#pragma once
+/**
+ * @file GuestProfiler.h
+ * @brief Guest PC profiler: cycles per PC and call stack, folded output.
+ *
+ * SingleCycleCpu::exec() reports every executed instruction. Every
+ * `period`-th one is a sample: it is charged all cycles since the previous
+ * sample, so fetch/data waits on the AXI bus, PTW stalls and idle-skipped
+ * cycles land on the instruction that was waiting for them (period 1 is an
+ * exact per-instruction histogram).
+ *
+ * Samples are keyed by (call stack, PC). The call stack is a shadow stack
+ * kept from the RISC-V return-address hints (JAL/JALR with rd or rs1 in
+ * {ra, t0}); traps push the trapping PC and mret/sret pop it. Stacks are
+ * interned as nodes of a call tree, so a sample costs one hash update.
+ *
+ * Output is symbolized from an optional ELF symbol table:
+ *   - write_folded(): "caller;callee;leaf cycles" lines for flamegraph.pl,
+ *     speedscope or inferno;
+ *   - hot_spots(): per-function self/inclusive cycles.
+ */
+
+#include "Elf32.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace guest_prof {
+
+class SymbolTable {
+public:
+  bool load_elf(const std::string &path, std::string &error);
+  bool empty() const { return symbols_.empty(); }
+  // Function containing pc, or "0x%08x" when no symbol covers it.
+  std::string name(uint32_t pc) const;
+
+private:
+  std::vector<elf32::Symbol> symbols_;
+};
+
+struct HotSpot {
+  std::string name;
+  uint64_t self_cycles = 0;
+  uint64_t total_cycles = 0; // self + callees
+  uint64_t samples = 0;
+};
+
+class GuestProfiler {
+public:
+  static constexpr uint32_t kMaxDepth = 64;
+  static constexpr uint32_t kMaxNodes = 1u << 20;
+  static constexpr uint32_t kInstMret = 0x30200073;
+  static constexpr uint32_t kInstSret = 0x10200073;
+
+  // period 0 disables. Drops collected data; cycles before `now` are not
+  // counted.
+  void configure(uint32_t period, uint64_t now);
+  // Drops collected data and keeps the period.
+  void restart(uint64_t now) { configure(period_, now); }
+  bool enabled() const { return period_ != 0; }
+  uint32_t period() const { return period_; }
+
+  // inst is 0 when the fetch itself faulted.
+  void on_exec(uint32_t pc, uint32_t inst, bool trapped, uint64_t now) {
+    if (--countdown_ == 0) {
+      countdown_ = period_;
+      sample(pc, now);
+    }
+    if (inst == kInstMret || inst == kInstSret) {
+      pop();
+    } else if (trapped) {
+      push(pc);
+    } else if ((inst & 0x7f) == 0x6f || (inst & 0x7f) == 0x67) {
+      track_jump(pc, inst);
+    }
+  }
+
+  // Cycles spent in functional fast-forward; they carry no PCs and are
+  // reported as one "[fast-forward]" frame.
+  void skip(uint64_t cycles) {
+    fast_forward_cycles_ += cycles;
+    mark_ += cycles;
+  }
+
+  uint64_t samples() const { return samples_; }
+  // Cycles covered since configure(), including the not yet sampled tail.
+  uint64_t total_cycles(uint64_t now) const { return now - start_; }
+
+  bool write_folded(const std::string &path, const SymbolTable &symbols,
+                    uint64_t now, std::string &error) const;
+  // Functions sorted by self cycles.
+  void hot_spots(const SymbolTable &symbols, uint64_t now,
+                 std::vector<HotSpot> &out) const;
+  void write_hot_spots(FILE *out, const SymbolTable &symbols, uint64_t now,
+                       uint32_t top) const;
+
+private:
+  struct Node {
+    uint32_t parent;
+    uint32_t call_pc; // PC of the call (or trapping instruction)
+  };
+  struct Count {
+    uint64_t samples;
+    uint64_t cycles;
+  };
+
+  void sample(uint32_t pc, uint64_t now) {
+    Count &c = counts_[(static_cast<uint64_t>(node_) << 32) | pc];
+    c.samples++;
+    c.cycles += now - mark_;
+    mark_ = now;
+    samples_++;
+  }
+  void track_jump(uint32_t pc, uint32_t inst);
+  void push(uint32_t call_pc);
+  void pop();
+  // "frame;frame;" of every node, callers first.
+  void stack_prefixes(const SymbolTable &symbols,
+                      std::vector<std::string> &prefixes) const;
+
+  uint32_t period_ = 0;
+  uint32_t countdown_ = 0;
+  uint64_t start_ = 0;
+  uint64_t mark_ = 0;
+  uint64_t samples_ = 0;
+  uint64_t fast_forward_cycles_ = 0;
+
+  std::vector<Node> nodes_;                       // nodes_[0]: root
+  std::unordered_map<uint64_t, uint32_t> children_; // parent<<32|call_pc
+  std::unordered_map<uint64_t, Count> counts_;      // node<<32|pc
+  uint32_t node_ = 0;
+  uint32_t depth_ = 0;
+  uint32_t lost_depth_ = 0; // pushes dropped past kMaxDepth/kMaxNodes
+};
+
+} // namespace guest_prof
@@ -2,22 +2,30 @@
 
 #include "AXI_Interconnect.h"
 #include "CSR.h"
+#include "Checkpoint.h"
+#include "GuestProfiler.h"
+#include "PhysicalMemory.h"
 #include "RISCV.h"
-#include "SimCpu.h"
+#include "SimDDR.h"
 #include "config.h"
 #include "single_cycle_cpu.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <fcntl.h>
 #include <fstream>
 #include <limits>
+#include <memory>
 #include <new>
 #include <string>
-
-long long sim_time = 0;
-uint32_t *p_memory = nullptr;
-SimCpu cpu;
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include <zlib.h>
 
 namespace {
 
@@ -25,13 +33,8 @@ constexpr uint32_t kImageBase = 0x80000000u;
 constexpr uint8_t kFetchReqId = 0;
 constexpr uint8_t kDataReqId = 1;
 constexpr uint8_t kMmuReqId = 2;
-
-class SingleCycleAxi4Sim;
-static SingleCycleAxi4Sim *g_active_sim = nullptr;
-static CpuMemReadResult cpu_mem_read_hook(uint32_t paddr, uint32_t *data);
-static bool cpu_mem_read_now_hook(uint32_t paddr, uint32_t *data);
-static bool cpu_mem_write_now_hook(uint32_t paddr, uint32_t data,
-                                   uint32_t wstrb);
+constexpr uint8_t kPrefetchReqId = 1; // second ID on the icache port
+constexpr uint32_t kFetchLineBytes = axi_interconnect::CACHELINE_WORDS * 4;
 
 inline int32_t sext(uint32_t value, int bits) {
   const uint32_t sign_bit = 1u << (bits - 1);
@@ -43,28 +46,6 @@ inline uint8_t calc_beats(uint8_t total_size) {
   return static_cast<uint8_t>((bytes + 3) / 4);
 }
 
-inline void apply_wstrb_write(uint32_t addr, uint32_t data, uint8_t wstrb) {
-  if (p_memory == nullptr) {
-    return;
-  }
-  const uint32_t word_addr = addr >> 2;
-  uint32_t old_data = p_memory[word_addr];
-  uint32_t mask = 0;
-  if (wstrb & 0x1) {
-    mask |= 0x000000FFu;
-  }
-  if (wstrb & 0x2) {
-    mask |= 0x0000FF00u;
-  }
-  if (wstrb & 0x4) {
-    mask |= 0x00FF0000u;
-  }
-  if (wstrb & 0x8) {
-    mask |= 0xFF000000u;
-  }
-  p_memory[word_addr] = (data & mask) | (old_data & ~mask);
-}
-
 struct DecodedMemReq {
   bool valid = false;
   bool is_read = true;
@@ -83,6 +64,7 @@ struct ReadReqState {
   uint8_t total_size = 0;
   uint8_t beats_total = 0;
   uint8_t beats_seen = 0;
+  uint64_t start = 0; // setup cycle, for the latency histogram
 };
 
 struct WriteReqState {
@@ -95,6 +77,25 @@ struct WriteReqState {
   uint8_t total_size = 0;
   uint8_t beats_total = 0;
   uint8_t beats_seen = 0;
+  uint64_t start = 0; // setup cycle, for the latency histogram
+};
+
+// Posted store in the store buffer. addr is word aligned; wdata and wstrb
+// hold the merged byte lanes of every store folded into the entry.
+struct StoreBufferEntry {
+  uint32_t addr = 0;
+  uint32_t wdata = 0;
+  uint8_t wstrb = 0;
+  uint64_t start = 0; // cycle the entry was allocated
+};
+
+// Data cache line. tag is the line address; stamp orders the ways of a set
+// for replacement (last use for LRU, fill time for FIFO).
+struct DcacheLine {
+  uint32_t tag = 0;
+  bool valid = false;
+  bool dirty = false;
+  uint64_t stamp = 0;
 };
 
 enum class ExecStage : uint8_t {
@@ -107,6 +108,16 @@ enum class ExecStage : uint8_t {
   kHalted = 6,
 };
 
+constexpr size_t kStageCount = static_cast<size_t>(ExecStage::kHalted) + 1;
+
+// Cycle accounting behind sc_sim_get_perf().
+struct CycleAccounting {
+  uint64_t stage[kStageCount] = {}; // by ExecStage
+  uint64_t mmu_pending = 0;
+  uint64_t fast_forward = 0;
+  sc_sim_latency_hist_t latency[SC_SIM_PERF_MASTERS] = {};
+};
+
 static const char *stage_name(ExecStage stage) {
   switch (stage) {
   case ExecStage::kPrepareFetch:
@@ -127,6 +138,24 @@ static const char *stage_name(ExecStage stage) {
   return "Unknown";
 }
 
+// FENCE/FENCE.I, SFENCE.VMA and AMOs (LR/SC included) start only once the
+// store buffer has drained.
+static bool is_fence_i(uint32_t inst_word) {
+  return (inst_word & 0x707f) == 0x100f;
+}
+
+static bool orders_memory(uint32_t inst_word) {
+  const uint32_t opcode = inst_word & 0x7f;
+  if (opcode == 0x0f || opcode == 0x2f) {
+    return true;
+  }
+  return opcode == 0x73 && ((inst_word >> 12) & 0x7) == 0 &&
+         (inst_word >> 25) == 0x09;
+}
+
+// No retirement for this many cycles is reported once as a stall.
+constexpr uint64_t kStallCycles = 2000000ULL;
+
 struct MmuHookState {
   bool pending = false;
   bool response_valid = false;
@@ -134,21 +163,153 @@ struct MmuHookState {
   uint32_t data = 0;
 };
 
+// Cycle-mode cost of each kind of AXI transaction, used by the TLM timing
+// mode. Measured by replaying one isolated transaction on a scratch simulator
+// with the same DDR latency, so it follows any change to the cycle model.
+struct TlmCosts {
+  bool valid = false;
+  uint32_t fetch = 0;     // cycles spent in kWaitFetch
+  uint32_t mmu_read = 0;  // cycles per page-table read on the MMU port
+  uint32_t read[4] = {};  // kWaitData load, by total_size
+  uint32_t write[4] = {}; // kWaitData store, by total_size
+  uint32_t amo_write = 0; // kWaitAmoWrite
+};
+
+void write_perf_json_object(const sc_sim_perf_t &perf, FILE *out);
+
 class SingleCycleAxi4Sim {
 public:
   SingleCycleAxi4Sim() { init_runtime(); }
 
-  ~SingleCycleAxi4Sim() {
-    if (g_active_sim == this) {
-      g_active_sim = nullptr;
-      g_cpu_mem_read32_hook = nullptr;
-      g_cpu_mem_read32_now_hook = nullptr;
-      g_cpu_mem_write32_now_hook = nullptr;
+  // Fork of a live simulation: memory pages are shared copy-on-write, every
+  // other piece of state (CPU, interconnect, built-in DDR, requests in
+  // flight) is copied. The copy must call bind_self() before it is used.
+  SingleCycleAxi4Sim(SingleCycleAxi4Sim &other) = default;
+  SingleCycleAxi4Sim &operator=(const SingleCycleAxi4Sim &) = delete;
+
+  // Points the CPU hooks and the built-in DDR at this instance.
+  void bind_self() {
+    cpu_core_.mem_hooks.ctx = this;
+    cpu_core_.mem_hooks.read32 = cpu_mem_read_hook;
+    cpu_core_.mem_hooks.read32_now = cpu_mem_read_now_hook;
+    cpu_core_.mem_hooks.write32_now = cpu_mem_write_now_hook;
+    attach_profiler();
+    ddr_.set_memory(&memory_);
+  }
+
+  void attach_profiler() {
+    cpu_core_.profiler = profiler_.enabled() ? &profiler_ : nullptr;
+  }
+
+  void set_ddr_latency(uint32_t cycles) {
+    ddr_.set_latency(cycles);
+    tlm_costs_.valid = false;
+  }
+
+  // Cycle <-> TLM switches only happen at an instruction boundary, where the
+  // interconnect and DDR are idle.
+  int set_timing_mode(int mode) {
+    if (mode != SC_SIM_TIMING_CYCLE && mode != SC_SIM_TIMING_TLM) {
+      set_error("unknown timing mode");
+      return -1;
+    }
+    const ExecStage at =
+        (stage_ == ExecStage::kHalted) ? resume_stage_ : stage_;
+    if (at != ExecStage::kPrepareFetch || mmu_req_.active) {
+      set_error("timing mode can only change at an instruction boundary");
+      return -1;
+    }
+    if (mode == SC_SIM_TIMING_TLM &&
+        (sb_entries_ != 0 || fb_lines_ != 0 || dc_sets_ != 0)) {
+      set_error("TLM timing needs the store buffer, fetch buffer and data "
+                "cache off");
+      return -1;
+    }
+    tlm_mode_ = (mode == SC_SIM_TIMING_TLM);
+    return 0;
+  }
+
+  int set_store_buffer(uint32_t entries) {
+    if (entries > SC_SIM_STORE_BUFFER_MAX) {
+      set_error("store buffer too large");
+      return -1;
+    }
+    if (entries != 0 && tlm_mode_) {
+      set_error("store buffer needs the cycle timing mode");
+      return -1;
+    }
+    const ExecStage at =
+        (stage_ == ExecStage::kHalted) ? resume_stage_ : stage_;
+    if (at != ExecStage::kPrepareFetch || mmu_req_.active || sb_count_ != 0) {
+      set_error("store buffer can only change at an instruction boundary "
+                "with no posted stores");
+      return -1;
+    }
+    sb_entries_ = entries;
+    return 0;
+  }
+
+  int set_fetch_buffer(uint32_t lines, bool prefetch) {
+    if (lines > SC_SIM_FETCH_BUFFER_MAX) {
+      set_error("fetch buffer too large");
+      return -1;
+    }
+    if (prefetch && lines < 2) {
+      set_error("prefetch needs a fetch buffer of at least 2 lines");
+      return -1;
+    }
+    if (lines != 0 && tlm_mode_) {
+      set_error("fetch buffer needs the cycle timing mode");
+      return -1;
     }
-    if (p_memory != nullptr) {
-      delete[] p_memory;
-      p_memory = nullptr;
+    const ExecStage at =
+        (stage_ == ExecStage::kHalted) ? resume_stage_ : stage_;
+    if (at != ExecStage::kPrepareFetch || mmu_req_.active ||
+        prefetch_req_.active) {
+      set_error("fetch buffer can only change at an instruction boundary "
+                "with no prefetch in flight");
+      return -1;
     }
+    fb_lines_ = lines;
+    fb_prefetch_ = prefetch;
+    fetch_buffer_flush();
+    return 0;
+  }
+
+  int set_dcache(uint32_t sets, uint32_t ways, uint32_t line_bytes,
+                 int policy, bool write_back) {
+    if (sets != 0) {
+      if (sets > SC_SIM_DCACHE_SETS_MAX || (sets & (sets - 1)) != 0 ||
+          ways == 0 || ways > SC_SIM_DCACHE_WAYS_MAX ||
+          (line_bytes != 4 && line_bytes != 8 && line_bytes != 16 &&
+           line_bytes != 32)) {
+        set_error("invalid data cache geometry");
+        return -1;
+      }
+      if (policy != SC_SIM_DCACHE_LRU && policy != SC_SIM_DCACHE_FIFO &&
+          policy != SC_SIM_DCACHE_RANDOM) {
+        set_error("unknown data cache replacement policy");
+        return -1;
+      }
+      if (tlm_mode_) {
+        set_error("data cache needs the cycle timing mode");
+        return -1;
+      }
+    }
+    const ExecStage at =
+        (stage_ == ExecStage::kHalted) ? resume_stage_ : stage_;
+    if (at != ExecStage::kPrepareFetch || mmu_req_.active || dc_wb_.active) {
+      set_error("data cache can only change at an instruction boundary "
+                "with no write-back in flight");
+      return -1;
+    }
+    dc_sets_ = sets;
+    dc_ways_ = (sets != 0) ? ways : 0;
+    dc_line_bytes_ = (sets != 0) ? line_bytes : 0;
+    dc_policy_ = policy;
+    dc_write_back_ = (sets != 0) && write_back;
+    dcache_flush();
+    return 0;
   }
 
   int load_image(const char *image_path, uint64_t *image_size_out) {
@@ -156,35 +317,51 @@ public:
       set_error("image path is null");
       return -1;
     }
-    if (p_memory == nullptr) {
-      set_error("memory not initialized");
-      return -1;
-    }
 
-    std::ifstream image(image_path, std::ios::binary);
-    if (!image.is_open()) {
+    const int fd = ::open(image_path, O_RDONLY);
+    struct stat st {};
+    if (fd < 0 || fstat(fd, &st) != 0) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
       set_error(std::string("image not found: ") + image_path);
       return -1;
     }
+    uint8_t head[4] = {};
+    const bool has_head =
+        pread(fd, head, sizeof(head), 0) == static_cast<ssize_t>(sizeof(head));
+    const bool is_elf = has_head && elf32::has_magic(head, sizeof(head));
+    const bool is_gzip = has_head && head[0] == 0x1f && head[1] == 0x8b;
 
-    image.seekg(0, std::ios::end);
-    const size_t image_size = static_cast<size_t>(image.tellg());
-    image.seekg(0, std::ios::beg);
-
-    char *dst = reinterpret_cast<char *>(p_memory + (kImageBase >> 2));
-    if (!image.read(dst, static_cast<std::streamsize>(image_size))) {
-      set_error(std::string("failed to read image: ") + image_path);
+    // 复用句柄时不能留下上一个镜像的内存
+    image_loaded_ = false;
+    memory_.clear();
+    uint32_t entry = kImageBase;
+    uint64_t image_size = 0;
+    bool ok = false;
+    if (is_elf) {
+      ok = load_elf(image_path, fd, entry, image_size);
+    } else if (is_gzip) {
+      ok = load_gzip(image_path, fd, image_size);
+    } else {
+      ok = load_raw(image_path, fd, static_cast<uint64_t>(st.st_size),
+                    image_size);
+    }
+    ::close(fd);
+    if (!ok) {
       return -1;
     }
 
-    p_memory[0x0u / 4] = 0xf1402573;
-    p_memory[0x4u / 4] = 0x83e005b7;
-    p_memory[0x8u / 4] = 0x800002b7;
-    p_memory[0xcu / 4] = 0x00028067;
-    p_memory[0x10000004u / 4] = 0x00006000;
+    // 引导桩：a0 = mhartid，a1 = DTB 地址，跳转到镜像入口
+    const uint32_t entry_hi = (entry + 0x800u) & 0xfffff000u;
+    memory_.write32(0x0u, 0xf1402573);
+    memory_.write32(0x4u, 0x83e005b7);
+    memory_.write32(0x8u, entry_hi | 0x2b7);
+    memory_.write32(0xcu, ((entry - entry_hi) & 0xfffu) << 20 | 0x28067);
+    memory_.write32(0x10000004u, 0x00006000);
 
     if (image_size_out != nullptr) {
-      *image_size_out = static_cast<uint64_t>(image_size);
+      *image_size_out = image_size;
     }
 
     image_loaded_ = true;
@@ -192,9 +369,307 @@ public:
     return 0;
   }
 
+  // Raw binary at kImageBase, entered at its first byte.
+  bool load_raw(const char *image_path, int fd, uint64_t size,
+                uint64_t &loaded) {
+    if (size > 0x100000000ULL - kImageBase) {
+      set_error(std::string("image too large: ") + image_path);
+      return false;
+    }
+    if (!memory_.map_file(fd, 0, kImageBase, size)) {
+      set_error(std::string("failed to read image: ") + image_path);
+      return false;
+    }
+    loaded = size;
+    return true;
+  }
+
+  // gzip-compressed raw binary, inflated page by page straight into guest
+  // memory at kImageBase; all-zero pages stay unallocated. Concatenated
+  // members are decoded in turn, trailing non-gzip bytes are ignored.
+  bool load_gzip(const char *image_path, int fd, uint64_t &loaded) {
+    z_stream zs{};
+    if (inflateInit2(&zs, 15 + 16) != Z_OK) {
+      set_error("inflateInit2 failed");
+      return false;
+    }
+    std::vector<Bytef> in(1u << 20);
+    uint32_t page[PhysicalMemory::kPageWords];
+    uint64_t addr = kImageBase;
+    std::string error;
+    auto flush = [&]() {
+      const size_t bytes = PhysicalMemory::kPageBytes - zs.avail_out;
+      zs.next_out = reinterpret_cast<Bytef *>(page);
+      zs.avail_out = PhysicalMemory::kPageBytes;
+      if (bytes == 0) {
+        return true;
+      }
+      if (addr == kImageBase && elf32::has_magic(page, bytes)) {
+        error = std::string("compressed ELF images are not supported: ") +
+                image_path;
+        return false;
+      }
+      if (addr + bytes > 0x100000000ULL) {
+        error = std::string("image too large: ") + image_path;
+        return false;
+      }
+      const uint8_t *p = reinterpret_cast<const uint8_t *>(page);
+      if (std::any_of(p, p + bytes, [](uint8_t b) { return b != 0; })) {
+        memory_.write_bytes(static_cast<uint32_t>(addr), page, bytes);
+      }
+      addr += bytes;
+      return true;
+    };
+
+    zs.next_out = reinterpret_cast<Bytef *>(page);
+    zs.avail_out = PhysicalMemory::kPageBytes;
+    int rc = Z_OK;
+    bool eof = false;
+    while (error.empty()) {
+      if (zs.avail_in == 0 && !eof) {
+        const ssize_t n = read(fd, in.data(), in.size());
+        if (n < 0) {
+          error = std::string("failed to read image: ") + image_path;
+          break;
+        }
+        eof = (n == 0);
+        zs.next_in = in.data();
+        zs.avail_in = static_cast<uInt>(n);
+      }
+      if (rc == Z_STREAM_END) {
+        if (zs.avail_in == 0 || zs.next_in[0] != 0x1f) {
+          break;
+        }
+        inflateReset(&zs);
+      } else if (zs.avail_in == 0 && eof) {
+        error = std::string("truncated gzip image: ") + image_path;
+        break;
+      }
+      rc = inflate(&zs, Z_NO_FLUSH);
+      if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) {
+        error = std::string("corrupt gzip image: ") + image_path;
+        break;
+      }
+      if (zs.avail_out == 0 && !flush()) {
+        break;
+      }
+    }
+    if (error.empty()) {
+      flush();
+    }
+    inflateEnd(&zs);
+    if (!error.empty()) {
+      set_error(error);
+      return false;
+    }
+    loaded = addr - kImageBase;
+    return true;
+  }
+
+  // PT_LOAD segments at their physical addresses. Memory was just cleared,
+  // so the .bss part beyond p_filesz already reads as zero.
+  bool load_elf(const char *image_path, int fd, uint32_t &entry,
+                uint64_t &loaded) {
+    elf32::ElfFile elf;
+    std::vector<elf32::Segment> segments;
+    std::string error;
+    if (!elf.open(image_path, error) || !elf.read_segments(segments, error)) {
+      set_error(error);
+      return false;
+    }
+    if (segments.empty()) {
+      set_error(std::string("no loadable segments: ") + image_path);
+      return false;
+    }
+    for (const elf32::Segment &seg : segments) {
+      if (!memory_.map_file(fd, seg.offset, seg.paddr, seg.filesz)) {
+        set_error(std::string("failed to read image: ") + image_path);
+        return false;
+      }
+      loaded += seg.filesz;
+    }
+    entry = elf32::physical_entry(segments, elf.entry());
+    return true;
+  }
+
   void set_limits(uint64_t max_inst, uint64_t max_cycles) {
     max_inst_ = max_inst;
     max_cycles_ = max_cycles;
+    resume_after_max_inst();
+  }
+
+  int save_checkpoint(const char *path) {
+    if (path == nullptr) {
+      set_error("checkpoint path is null");
+      return -1;
+    }
+    if (!image_loaded_) {
+      set_error("image not loaded");
+      return -1;
+    }
+    CheckpointWriter out;
+    out.put(stage_);
+    out.put(resume_stage_);
+    out.put(success_);
+    out.put(halted_reason_max_inst_);
+    out.put(halted_reason_ebreak_);
+    out.put(inst_count_);
+    out.put(last_inst_count_);
+    out.put(last_progress_time_);
+    out.put(stall_reported_);
+    out.put(fetch_ok_);
+    out.put(fetch_vaddr_);
+    out.put(fetch_paddr_);
+    out.put(inst_word_);
+    out.put(pre_req_);
+    out.put(fetch_req_);
+    out.put(data_req_);
+    out.put(mmu_req_);
+    out.put(write_req_);
+    out.put(mmu_req_ready_);
+    out.put(mmu_resp_valid_);
+    out.put(mmu_hook_);
+    out.put(slave_in_);
+    out.put(slave_out_);
+    out.put(sb_);
+    out.put(sb_entries_);
+    out.put(sb_head_);
+    out.put(sb_count_);
+    out.put(sb_issued_);
+    out.put(sb_written_);
+    out.put(sb_req_ready_);
+    out.put(sb_resp_valid_);
+    out.put(fb_tag_);
+    out.put(fb_valid_);
+    out.put(fb_lines_);
+    out.put(fb_prefetch_);
+    out.put(fb_victim_);
+    out.put(prefetch_req_);
+    out.put(prefetch_req_ready_);
+    out.put(prefetch_resp_valid_);
+    out.put(dc_sets_);
+    out.put(dc_ways_);
+    out.put(dc_line_bytes_);
+    out.put(dc_policy_);
+    out.put(dc_write_back_);
+    out.put_vector(dc_lines_);
+    out.put(dc_clock_);
+    out.put(dc_rng_);
+    out.put(dc_miss_);
+    out.put(dc_fill_);
+    out.put(dc_fill_dirty_);
+    out.put(dc_wb_);
+    out.put(dc_wb_req_ready_);
+    out.put(dc_wb_resp_valid_);
+    out.put(dc_writebacks_);
+    out.put(perf_);
+    out.put(acct_);
+    cpu_core_.save(out);
+    interconnect_.save(out);
+    ddr_.save(out);
+
+    std::string error;
+    if (!checkpoint_write_file(path, out, memory_, error)) {
+      set_error(error);
+      return -1;
+    }
+    return 0;
+  }
+
+  // Replaces the whole machine state. Limits and the slave callback stay as
+  // configured on this handle. On failure the handle needs a new image or
+  // checkpoint before it can run again.
+  int load_checkpoint(const char *path) {
+    if (path == nullptr) {
+      set_error("checkpoint path is null");
+      return -1;
+    }
+    std::vector<uint8_t> state;
+    std::string error;
+    if (!checkpoint_read_file(path, state, memory_, error)) {
+      // memory may be half-restored: never continue from it
+      set_error(error);
+      image_loaded_ = false;
+      stage_ = ExecStage::kHalted;
+      return -1;
+    }
+
+    CheckpointReader in(state.data(), state.size());
+    in.get(stage_);
+    in.get(resume_stage_);
+    in.get(success_);
+    in.get(halted_reason_max_inst_);
+    in.get(halted_reason_ebreak_);
+    in.get(inst_count_);
+    in.get(last_inst_count_);
+    in.get(last_progress_time_);
+    in.get(stall_reported_);
+    in.get(fetch_ok_);
+    in.get(fetch_vaddr_);
+    in.get(fetch_paddr_);
+    in.get(inst_word_);
+    in.get(pre_req_);
+    in.get(fetch_req_);
+    in.get(data_req_);
+    in.get(mmu_req_);
+    in.get(write_req_);
+    in.get(mmu_req_ready_);
+    in.get(mmu_resp_valid_);
+    in.get(mmu_hook_);
+    in.get(slave_in_);
+    in.get(slave_out_);
+    in.get(sb_);
+    in.get(sb_entries_);
+    in.get(sb_head_);
+    in.get(sb_count_);
+    in.get(sb_issued_);
+    in.get(sb_written_);
+    in.get(sb_req_ready_);
+    in.get(sb_resp_valid_);
+    in.get(fb_tag_);
+    in.get(fb_valid_);
+    in.get(fb_lines_);
+    in.get(fb_prefetch_);
+    in.get(fb_victim_);
+    in.get(prefetch_req_);
+    in.get(prefetch_req_ready_);
+    in.get(prefetch_resp_valid_);
+    in.get(dc_sets_);
+    in.get(dc_ways_);
+    in.get(dc_line_bytes_);
+    in.get(dc_policy_);
+    in.get(dc_write_back_);
+    in.get_vector(dc_lines_);
+    in.get(dc_clock_);
+    in.get(dc_rng_);
+    in.get(dc_miss_);
+    in.get(dc_fill_);
+    in.get(dc_fill_dirty_);
+    in.get(dc_wb_);
+    in.get(dc_wb_req_ready_);
+    in.get(dc_wb_resp_valid_);
+    in.get(dc_writebacks_);
+    in.get(perf_);
+    in.get(acct_);
+    const bool dcache_ok =
+        dc_lines_.size() == static_cast<size_t>(dc_sets_) * dc_ways_;
+    const bool ok = dcache_ok && cpu_core_.load(in) &&
+                    interconnect_.load(in) && ddr_.load(in) && in.at_end();
+    // profile 不进检查点：恢复后从检查点的时刻重新开始
+    profiler_.restart(now());
+    bind_self();
+    uart_valid_ = false;
+    uart_ch_ = 0;
+    if (!ok) {
+      set_error(std::string("corrupt checkpoint state: ") + path);
+      image_loaded_ = false;
+      stage_ = ExecStage::kHalted;
+      return -1;
+    }
+    image_loaded_ = true;
+    last_error_.clear();
+    resume_after_max_inst();
+    return 0;
   }
 
   int step(const sc_axi4_in_t &axi_in, sc_axi4_out_t &axi_out,
@@ -209,6 +684,12 @@ public:
       return -1;
     }
 
+    if (tlm_mode_) {
+      set_error("sc_sim_step needs the cycle timing mode");
+      fill_status(status);
+      return -1;
+    }
+
     if (stage_ == ExecStage::kHalted) {
       fill_axi_outputs(axi_out);
       fill_status(status);
@@ -216,24 +697,44 @@ public:
     }
 
     apply_axi_inputs(axi_in);
-    interconnect_.comb_outputs();
+    run_cycle([&] { fill_axi_outputs(axi_out); });
+    fill_status(status);
 
-    clear_master_inputs();
+    if (stage_ == ExecStage::kHalted) {
+      return success_ ? 1 : -1;
+    }
+    return 0;
+  }
 
-    bool req_ready = false;
-    bool resp_valid = false;
-    drive_current_stage(req_ready, resp_valid);
+  void set_slave(sc_sim_slave_fn slave_fn, void *user,
+                 const sc_axi4_in_t *initial_in) {
+    slave_fn_ = slave_fn;
+    slave_user_ = user;
+    slave_in_ = (initial_in != nullptr) ? *initial_in : sc_axi4_in_t{};
+    slave_out_ = {};
+  }
 
-    interconnect_.comb_inputs();
-    fill_axi_outputs(axi_out);
-    mirror_read_data(axi_in, axi_out);
-    mirror_write_data(axi_in, axi_out);
+  int step_n(uint64_t n_cycles, uint32_t stop_mask, sc_sim_status_t &status) {
+    clear_uart_event();
+    clear_error_if_running();
 
-    interconnect_.seq();
-    sim_time++;
+    if (!image_loaded_) {
+      set_error("image not loaded");
+      fill_status(status);
+      return -1;
+    }
 
-    update_stage_after_cycle(req_ready, resp_valid);
-    check_limits();
+    if (tlm_mode_ && slave_fn_ != nullptr) {
+      set_error("TLM timing needs the built-in SimDDR");
+      fill_status(status);
+      return -1;
+    }
+
+    if (tlm_mode_) {
+      run_tlm(n_cycles, stop_mask);
+    } else {
+      run_cycles(n_cycles, stop_mask);
+    }
     fill_status(status);
 
     if (stage_ == ExecStage::kHalted) {
@@ -242,8 +743,145 @@ public:
     return 0;
   }
 
+  int fast_forward(uint64_t max_inst, sc_sim_status_t &status) {
+    clear_uart_event();
+    clear_error_if_running();
+
+    if (!image_loaded_) {
+      set_error("image not loaded");
+      fill_status(status);
+      return -1;
+    }
+
+    if (stage_ == ExecStage::kHalted) {
+      fill_status(status);
+      return success_ ? 1 : -1;
+    }
+
+    // 只能在指令边界切换：取指前且没有未完成的 PTW 请求
+    if (stage_ != ExecStage::kPrepareFetch || mmu_req_.active) {
+      set_error("fast-forward requires an instruction boundary");
+      fill_status(status);
+      return -1;
+    }
+    // 写缓冲里的 store 会在之后覆盖快进期间写入的内存
+    if (sb_count_ != 0) {
+      set_error("fast-forward requires an empty store buffer");
+      fill_status(status);
+      return -1;
+    }
+    // 同理，写回中的脏行也会覆盖快进期间的写入
+    if (dc_wb_.active) {
+      set_error("fast-forward requires no data cache write-back in flight");
+      fill_status(status);
+      return -1;
+    }
+
+    uint64_t budget = max_inst;
+    if (inst_count_ < max_inst_ && max_inst_ - inst_count_ < budget) {
+      budget = max_inst_ - inst_count_;
+    }
+    const uint64_t ff_start = now();
+    cpu_core_.profiler = nullptr;
+    const uint64_t done = cpu_core_.run_fast(budget);
+    attach_profiler();
+    acct_.fast_forward += now() - ff_start;
+    if (profiler_.enabled()) {
+      profiler_.skip(now() - ff_start);
+    }
+    inst_count_ += done;
+    if (done != 0) {
+      last_inst_count_ = inst_count_;
+      last_progress_time_ = now();
+      stall_reported_ = false;
+    }
+    mmu_hook_ = {};
+
+    if (cpu_core_.fast_uart_valid) {
+      uart_valid_ = true;
+      uart_ch_ = cpu_core_.fast_uart_ch;
+    }
+    if (cpu_core_.fast_exit_reason == kFastExitEbreak) {
+      halted_reason_ebreak_ = true;
+      stage_ = ExecStage::kHalted;
+      success_ = true;
+    }
+
+    check_limits();
+    fill_status(status);
+    if (stage_ == ExecStage::kHalted) {
+      return success_ ? 1 : -1;
+    }
+    return 0;
+  }
+
   void get_status(sc_sim_status_t &status) const { fill_status(status); }
 
+  void get_tlb_stats(sc_sim_tlb_stats_t &stats) const {
+    stats.itlb_hit = cpu_core_.itlb.hit;
+    stats.itlb_miss = cpu_core_.itlb.miss;
+    stats.dtlb_hit = cpu_core_.dtlb.hit;
+    stats.dtlb_miss = cpu_core_.dtlb.miss;
+    stats.flushes = cpu_core_.tlb_flush_count;
+  }
+
+  void get_dcache_stats(sc_sim_dcache_stats_t &stats) const {
+    stats.accesses = perf_.cache_access_num;
+    stats.misses = perf_.cache_miss_num;
+    stats.writebacks = dc_writebacks_;
+  }
+
+  void get_perf(sc_sim_perf_t &perf) const {
+    perf = {};
+    perf.sim_time = now();
+    perf.inst_count = inst_count_;
+    perf.prepare_fetch_cycles = acct_.stage[stage_index(ExecStage::kPrepareFetch)];
+    perf.wait_fetch_cycles = acct_.stage[stage_index(ExecStage::kWaitFetch)];
+    perf.prepare_data_cycles = acct_.stage[stage_index(ExecStage::kPrepareData)];
+    perf.wait_data_cycles = acct_.stage[stage_index(ExecStage::kWaitData)];
+    perf.execute_cycles = acct_.stage[stage_index(ExecStage::kExecute)];
+    perf.wait_amo_write_cycles =
+        acct_.stage[stage_index(ExecStage::kWaitAmoWrite)];
+    perf.fast_forward_cycles = acct_.fast_forward;
+    perf.mmu_pending_cycles = acct_.mmu_pending;
+    perf.icache_access = perf_.icache_access_num;
+    perf.icache_miss = perf_.icache_miss_num;
+    perf.dcache_access = perf_.cache_access_num;
+    perf.dcache_miss = perf_.cache_miss_num;
+    perf.dcache_writeback = dc_writebacks_;
+    perf.itlb_hit = cpu_core_.itlb.hit;
+    perf.itlb_miss = cpu_core_.itlb.miss;
+    perf.dtlb_hit = cpu_core_.dtlb.hit;
+    perf.dtlb_miss = cpu_core_.dtlb.miss;
+    std::memcpy(perf.latency, acct_.latency, sizeof(perf.latency));
+  }
+
+  int write_perf_json(const char *path) {
+    if (path == nullptr) {
+      set_error("perf report path is null");
+      return -1;
+    }
+    const bool to_stdout = std::strcmp(path, "-") == 0;
+    FILE *out = to_stdout ? stdout : std::fopen(path, "w");
+    if (out == nullptr) {
+      set_error(std::string("cannot open perf report: ") + path);
+      return -1;
+    }
+    sc_sim_perf_t perf;
+    get_perf(perf);
+    write_perf_json_object(perf, out);
+    const bool ok = (std::fflush(out) == 0) && !std::ferror(out);
+    if (!to_stdout && std::fclose(out) != 0) {
+      set_error(std::string("failed to write perf report: ") + path);
+      return -1;
+    }
+    if (!ok) {
+      set_error(std::string("failed to write perf report: ") + path);
+      return -1;
+    }
+    return 0;
+  }
+
   const char *last_error() const {
     if (last_error_.empty()) {
       return "";
@@ -251,12 +889,74 @@ public:
     return last_error_.c_str();
   }
 
+  int set_pc_profiling(uint32_t period) {
+    profiler_.configure(period, now());
+    attach_profiler();
+    return 0;
+  }
+
+  int write_pc_profile(const char *folded_path, const char *hot_spots_path,
+                       const char *elf_path, uint32_t top) {
+    if (!profiler_.enabled()) {
+      set_error("PC profiling is off");
+      return -1;
+    }
+    guest_prof::SymbolTable symbols;
+    std::string error;
+    if (elf_path != nullptr && !symbols.load_elf(elf_path, error)) {
+      set_error(error);
+      return -1;
+    }
+    if (folded_path != nullptr &&
+        !profiler_.write_folded(folded_path, symbols, now(), error)) {
+      set_error(error);
+      return -1;
+    }
+    if (hot_spots_path == nullptr) {
+      return 0;
+    }
+    const bool to_stdout = std::strcmp(hot_spots_path, "-") == 0;
+    FILE *out = to_stdout ? stdout : std::fopen(hot_spots_path, "w");
+    if (out == nullptr) {
+      set_error(std::string("cannot open hot-spot report: ") + hot_spots_path);
+      return -1;
+    }
+    profiler_.write_hot_spots(out, symbols, now(), top);
+    const bool ok = (std::fflush(out) == 0) && !std::ferror(out);
+    if ((!to_stdout && std::fclose(out) != 0) || !ok) {
+      set_error(std::string("failed to write hot-spot report: ") +
+                hot_spots_path);
+      return -1;
+    }
+    return 0;
+  }
+
+  PhysicalMemory *memory() { return &memory_; }
+
+  uint64_t resident_memory() const { return memory_.resident_bytes(); }
+
+  // Enabling starts a fresh basic-block vector; disabling drops it.
+  void set_bbv_profiling(bool enable) {
+    std::unordered_map<uint32_t, uint64_t> discard;
+    cpu_core_.bbv_enabled = enable;
+    cpu_core_.bbv_take(discard);
+  }
+
+  void take_bbv(std::unordered_map<uint32_t, uint64_t> &out) {
+    cpu_core_.bbv_take(out);
+  }
+
   CpuMemReadResult on_cpu_mem_read(uint32_t paddr, uint32_t *data) {
-    if (data == nullptr || p_memory == nullptr) {
+    if (data == nullptr) {
       return CPU_MEM_READ_FAULT;
     }
 
     const uint32_t aligned_addr = paddr & ~0x3u;
+    if (tlm_mode_) {
+      *data = memory_.read32(aligned_addr);
+      tlm_ptw_reads_++;
+      return CPU_MEM_READ_OK;
+    }
     if (mmu_hook_.response_valid && mmu_hook_.addr != aligned_addr) {
       mmu_hook_.response_valid = false;
       mmu_hook_.pending = false;
@@ -287,16 +987,31 @@ public:
   }
 
 private:
-  void init_runtime() {
-    if (p_memory == nullptr) {
-      p_memory = new (std::nothrow) uint32_t[PHYSICAL_MEMORY_LENGTH];
-    }
-    if (p_memory == nullptr) {
-      set_error("failed to allocate physical memory");
-      stage_ = ExecStage::kHalted;
-      success_ = false;
-      return;
+  // CPU memory hooks; ctx is the owning simulator.
+  static CpuMemReadResult cpu_mem_read_hook(void *ctx, uint32_t paddr,
+                                            uint32_t *data) {
+    auto *sim = static_cast<SingleCycleAxi4Sim *>(ctx);
+    return sim->on_cpu_mem_read(paddr, data);
+  }
+
+  static bool cpu_mem_read_now_hook(void *ctx, uint32_t paddr,
+                                    uint32_t *data) {
+    if (data == nullptr) {
+      return false;
     }
+    *data = static_cast<SingleCycleAxi4Sim *>(ctx)->memory_.read32(paddr);
+    return true;
+  }
+
+  static bool cpu_mem_write_now_hook(void *ctx, uint32_t paddr, uint32_t data,
+                                     uint32_t wstrb) {
+    static_cast<SingleCycleAxi4Sim *>(ctx)->memory_.write32(paddr, data, wstrb);
+    return true;
+  }
+
+  uint64_t now() const { return static_cast<uint64_t>(cpu_core_.sim_time); }
+
+  void init_runtime() {
     image_loaded_ = false;
     max_inst_ = MAX_COMMIT_INST;
     max_cycles_ = 12000000000ULL;
@@ -304,12 +1019,12 @@ private:
   }
 
   void reset_machine_state() {
-    sim_time = 0;
     inst_count_ = 0;
     success_ = false;
     halted_reason_max_inst_ = false;
     halted_reason_ebreak_ = false;
     stage_ = ExecStage::kPrepareFetch;
+    resume_stage_ = ExecStage::kPrepareFetch;
     fetch_ok_ = false;
     fetch_vaddr_ = 0;
     fetch_paddr_ = 0;
@@ -322,6 +1037,20 @@ private:
     mmu_req_ready_ = false;
     mmu_resp_valid_ = false;
     mmu_hook_ = {};
+    sb_head_ = 0;
+    sb_count_ = 0;
+    sb_issued_ = 0;
+    sb_written_ = 0;
+    sb_req_ready_ = false;
+    sb_resp_valid_ = false;
+    fetch_buffer_flush();
+    prefetch_req_ = {};
+    prefetch_req_ready_ = false;
+    prefetch_resp_valid_ = false;
+    dcache_flush();
+    dc_writebacks_ = 0;
+    perf_ = PerfCount{};
+    acct_ = {};
     uart_valid_ = false;
     uart_ch_ = 0;
     last_inst_count_ = 0;
@@ -329,12 +1058,12 @@ private:
     stall_reported_ = false;
 
     cpu_core_.init(0);
-    cpu_core_.memory = p_memory;
-    g_active_sim = this;
-    g_cpu_mem_read32_hook = cpu_mem_read_hook;
-    g_cpu_mem_read32_now_hook = cpu_mem_read_now_hook;
-    g_cpu_mem_write32_now_hook = cpu_mem_write_now_hook;
+    cpu_core_.sim_time = 0;
+    profiler_.restart(0);
+    bind_self();
     interconnect_.init();
+    ddr_.init();
+    ddr_.comb_outputs();
   }
 
   void clear_error_if_running() {
@@ -461,6 +1190,7 @@ private:
     read_req.addr = addr;
     read_req.total_size = total_size;
     read_req.beats_total = calc_beats(total_size);
+    read_req.start = now();
   }
 
   void setup_write(WriteReqState &write_req, uint8_t id, uint32_t addr,
@@ -473,6 +1203,7 @@ private:
     write_req.wstrb = wstrb;
     write_req.total_size = total_size;
     write_req.beats_total = calc_beats(total_size);
+    write_req.start = now();
   }
 
   void apply_axi_inputs(const sc_axi4_in_t &axi_in) {
@@ -539,6 +1270,11 @@ private:
       return;
     }
 
+    if (!mmu_req_.issued &&
+        store_buffer_blocks(mmu_req_.addr, mmu_req_.total_size)) {
+      return;
+    }
+
     auto &port = interconnect_.read_ports[axi_interconnect::MASTER_MMU];
     mmu_req_ready_ = port.req.ready;
     mmu_resp_valid_ = port.resp.valid;
@@ -558,10 +1294,11 @@ private:
     switch (stage_) {
     case ExecStage::kWaitFetch: {
       auto &port = interconnect_.read_ports[axi_interconnect::MASTER_ICACHE];
-      req_ready = port.req.ready;
-      resp_valid = port.resp.valid;
+      resp_valid = port.resp.valid && port.resp.id == fetch_req_.id;
       port.resp.ready = true;
-      if (!fetch_req_.issued) {
+      if (fetch_req_.active && !fetch_req_.issued &&
+          !store_buffer_blocks(fetch_req_.addr, fetch_req_.total_size)) {
+        req_ready = port.req.ready;
         port.req.valid = true;
         port.req.addr = fetch_req_.addr;
         port.req.total_size = fetch_req_.total_size;
@@ -570,18 +1307,22 @@ private:
       break;
     }
     case ExecStage::kWaitData: {
-      if (pre_req_.is_read) {
+      if (pre_req_.is_read || dc_miss_) {
         auto &port = interconnect_.read_ports[axi_interconnect::MASTER_DCACHE_R];
-        req_ready = port.req.ready;
         resp_valid = port.resp.valid;
         port.resp.ready = true;
-        if (!data_req_.issued) {
+        if (!data_req_.issued &&
+            !store_buffer_blocks(data_req_.addr, data_req_.total_size) &&
+            !dcache_writeback_blocks(data_req_.addr)) {
+          req_ready = port.req.ready;
           port.req.valid = true;
           port.req.addr = data_req_.addr;
           port.req.total_size = data_req_.total_size;
           port.req.id = data_req_.id;
         }
-      } else {
+      } else if (!posts_store(pre_req_) && !posted_writes_pending()) {
+        // MMIO store (or buffer off): the write port is ours once the
+        // posted stores and dirty-line write-backs have drained
         auto &port = interconnect_.write_port;
         req_ready = port.req.ready;
         resp_valid = port.resp.valid;
@@ -599,6 +1340,9 @@ private:
       break;
     }
     case ExecStage::kWaitAmoWrite: {
+      if (posted_writes_pending()) {
+        break;
+      }
       auto &port = interconnect_.write_port;
       req_ready = port.req.ready;
       resp_valid = port.resp.valid;
@@ -614,66 +1358,603 @@ private:
       }
       break;
     }
-    default:
-      break;
+    default:
+      break;
+    }
+
+    drive_mmu_request();
+    drive_prefetch();
+    drive_store_buffer();
+    drive_dcache_writeback();
+  }
+
+  // ---------------- Fetch buffer ----------------
+
+  void fetch_buffer_flush() {
+    for (bool &valid : fb_valid_) {
+      valid = false;
+    }
+    fb_victim_ = 0;
+  }
+
+  bool fetch_buffer_hit(uint32_t paddr) const {
+    const uint32_t line = paddr & ~(kFetchLineBytes - 1);
+    for (uint32_t i = 0; i < fb_lines_; ++i) {
+      if (fb_valid_[i] && fb_tag_[i] == line) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void fetch_buffer_fill(uint32_t line) {
+    if (fetch_buffer_hit(line)) {
+      return;
+    }
+    fb_tag_[fb_victim_] = line;
+    fb_valid_[fb_victim_] = true;
+    fb_victim_ = (fb_victim_ + 1) % fb_lines_;
+  }
+
+  // Next-line prefetch after a fetch from `line`, one line in flight at a
+  // time.
+  void start_prefetch(uint32_t line) {
+    const uint32_t next = line + kFetchLineBytes;
+    if (!fb_prefetch_ || prefetch_req_.active || next < kImageBase ||
+        fetch_buffer_hit(next)) {
+      return;
+    }
+    setup_read(prefetch_req_, axi_interconnect::MASTER_ICACHE, kPrefetchReqId,
+               next, kFetchLineBytes - 1);
+  }
+
+  // The prefetch shares the icache port and only asks for it when the demand
+  // fetch is not using it.
+  void drive_prefetch() {
+    prefetch_req_ready_ = false;
+    prefetch_resp_valid_ = false;
+    if (!prefetch_req_.active) {
+      return;
+    }
+    auto &port = interconnect_.read_ports[axi_interconnect::MASTER_ICACHE];
+    prefetch_resp_valid_ =
+        port.resp.valid && port.resp.id == prefetch_req_.id;
+    port.resp.ready = true;
+    if (!prefetch_req_.issued && !port.req.valid &&
+        !store_buffer_blocks(prefetch_req_.addr, prefetch_req_.total_size)) {
+      prefetch_req_ready_ = port.req.ready;
+      port.req.valid = true;
+      port.req.addr = prefetch_req_.addr;
+      port.req.total_size = prefetch_req_.total_size;
+      port.req.id = prefetch_req_.id;
+    }
+  }
+
+  void update_prefetch_state() {
+    if (!prefetch_req_.active) {
+      return;
+    }
+    if (!prefetch_req_.issued && prefetch_req_ready_) {
+      prefetch_req_.issued = true;
+    }
+    if (prefetch_req_.issued && prefetch_resp_valid_) {
+      prefetch_req_.active = false;
+      note_done(axi_interconnect::MASTER_ICACHE, prefetch_req_.start);
+      fetch_buffer_fill(prefetch_req_.addr);
+    }
+  }
+
+  // ---------------- Store buffer ----------------
+
+  StoreBufferEntry &sb_at(uint32_t i) {
+    return sb_[(sb_head_ + i) % SC_SIM_STORE_BUFFER_MAX];
+  }
+  const StoreBufferEntry &sb_at(uint32_t i) const {
+    return sb_[(sb_head_ + i) % SC_SIM_STORE_BUFFER_MAX];
+  }
+
+  // Write-back data cache lines absorb RAM stores, so only write-through
+  // stores reach the buffer.
+  bool posts_store(const DecodedMemReq &req) const {
+    return sb_entries_ != 0 && req.valid && !req.is_read &&
+           req.paddr >= kImageBase && !dc_write_back_;
+  }
+
+  bool posted_writes_pending() const { return sb_count_ != 0 || dc_wb_.active; }
+
+  // Byte lanes of `word` held by posted stores.
+  uint8_t store_buffer_lanes(uint32_t word) const {
+    uint8_t lanes = 0;
+    for (uint32_t i = 0; i < sb_count_; ++i) {
+      const StoreBufferEntry &e = sb_at(i);
+      if (e.addr == word) {
+        lanes |= e.wstrb;
+      }
+    }
+    return lanes;
+  }
+
+  // A read must not reach the bus before posted stores to the same word (a
+  // callback slave would return the old data) or before any store when it
+  // targets MMIO.
+  bool store_buffer_blocks(uint32_t addr, uint8_t total_size) const {
+    if (sb_count_ == 0) {
+      return false;
+    }
+    if (addr < kImageBase) {
+      return true;
+    }
+    const uint32_t first = addr & ~0x3u;
+    const uint32_t last = (addr + total_size) & ~0x3u;
+    for (uint32_t i = 0; i < sb_count_; ++i) {
+      const uint32_t word = sb_at(i).addr;
+      if (word >= first && word <= last) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Load whose bytes all come from posted stores: completes without a read.
+  bool store_buffer_forwards(const DecodedMemReq &req) const {
+    const uint32_t offset = req.paddr & 0x3u;
+    if (sb_count_ == 0 || req.paddr < kImageBase ||
+        offset + req.total_size > 3) {
+      return false;
+    }
+    const uint8_t need =
+        static_cast<uint8_t>(((2u << req.total_size) - 1) << offset);
+    return (store_buffer_lanes(req.paddr & ~0x3u) & need) == need;
+  }
+
+  // Merges into the word's entry if its write is not issued yet, otherwise
+  // appends. False (retry next cycle) when the buffer is full or the word's
+  // issued write has not sent its W beat: a newer entry would race it.
+  bool store_buffer_push(uint32_t paddr, uint32_t wdata, uint8_t wstrb) {
+    const uint32_t word = paddr & ~0x3u;
+    for (uint32_t i = sb_written_; i < sb_count_; ++i) {
+      StoreBufferEntry &e = sb_at(i);
+      if (e.addr != word) {
+        continue;
+      }
+      if (i < sb_issued_) {
+        return false;
+      }
+      uint32_t mask = 0;
+      for (uint32_t lane = 0; lane < 4; ++lane) {
+        if (wstrb & (1u << lane)) {
+          mask |= 0xffu << (lane * 8);
+        }
+      }
+      e.wdata = (e.wdata & ~mask) | (wdata & mask);
+      e.wstrb |= wstrb;
+      return true;
+    }
+    if (sb_count_ >= sb_entries_) {
+      return false;
+    }
+    StoreBufferEntry &e = sb_at(sb_count_);
+    e.addr = word;
+    e.wdata = wdata;
+    e.wstrb = wstrb;
+    e.start = now();
+    sb_count_++;
+    return true;
+  }
+
+  // Oldest unissued entry goes out on the write port; responses retire
+  // entries in order.
+  void drive_store_buffer() {
+    sb_req_ready_ = false;
+    sb_resp_valid_ = false;
+    if (sb_count_ == 0) {
+      return;
+    }
+    auto &port = interconnect_.write_port;
+    sb_resp_valid_ = port.resp.valid;
+    port.resp.ready = true;
+    if (sb_issued_ < sb_count_) {
+      const StoreBufferEntry &e = sb_at(sb_issued_);
+      sb_req_ready_ = port.req.ready;
+      port.req.valid = true;
+      port.req.addr = e.addr;
+      port.req.wdata.clear();
+      port.req.wdata[0] = e.wdata;
+      port.req.wstrb = e.wstrb;
+      port.req.total_size = 3;
+      port.req.id = kDataReqId;
+    }
+  }
+
+  void update_store_buffer_state() {
+    if (sb_req_ready_) {
+      sb_issued_++;
+    }
+    if (sb_resp_valid_ && sb_written_ != 0) {
+      note_done(axi_interconnect::MASTER_DCACHE_W, sb_at(0).start);
+      sb_head_ = (sb_head_ + 1) % SC_SIM_STORE_BUFFER_MAX;
+      sb_count_--;
+      sb_issued_--;
+      sb_written_--;
+    }
+  }
+
+  // ---------------- Data cache ----------------
+
+  bool dcache_caches(uint32_t paddr) const {
+    return dc_sets_ != 0 && paddr >= kImageBase;
+  }
+
+  uint32_t dcache_line(uint32_t paddr) const {
+    return paddr & ~(dc_line_bytes_ - 1);
+  }
+
+  // First way of the set holding `paddr`.
+  uint32_t dcache_set_base(uint32_t paddr) const {
+    return ((paddr / dc_line_bytes_) & (dc_sets_ - 1)) * dc_ways_;
+  }
+
+  const DcacheLine *dcache_find(uint32_t paddr) const {
+    const uint32_t line = dcache_line(paddr);
+    const uint32_t base = dcache_set_base(paddr);
+    for (uint32_t w = 0; w < dc_ways_; ++w) {
+      const DcacheLine &l = dc_lines_[base + w];
+      if (l.valid && l.tag == line) {
+        return &l;
+      }
+    }
+    return nullptr;
+  }
+  DcacheLine *dcache_find(uint32_t paddr) {
+    return const_cast<DcacheLine *>(
+        static_cast<const SingleCycleAxi4Sim *>(this)->dcache_find(paddr));
+  }
+
+  void dcache_flush() {
+    dc_lines_.assign(static_cast<size_t>(dc_sets_) * dc_ways_, DcacheLine{});
+    dc_clock_ = 0;
+    dc_rng_ = 0x2545f491u;
+    dc_miss_ = false;
+    dc_fill_ = 0;
+    dc_fill_dirty_ = false;
+    dc_wb_ = {};
+    dc_wb_req_ready_ = false;
+    dc_wb_resp_valid_ = false;
+  }
+
+  uint32_t dcache_victim(uint32_t base) {
+    for (uint32_t w = 0; w < dc_ways_; ++w) {
+      if (!dc_lines_[base + w].valid) {
+        return base + w;
+      }
+    }
+    if (dc_policy_ == SC_SIM_DCACHE_RANDOM) {
+      dc_rng_ ^= dc_rng_ << 13; // xorshift32
+      dc_rng_ ^= dc_rng_ >> 17;
+      dc_rng_ ^= dc_rng_ << 5;
+      return base + dc_rng_ % dc_ways_;
+    }
+    uint32_t victim = base;
+    for (uint32_t w = 1; w < dc_ways_; ++w) {
+      if (dc_lines_[base + w].stamp < dc_lines_[victim].stamp) {
+        victim = base + w;
+      }
+    }
+    return victim;
+  }
+
+  // Memory is always current, so the slave's copy of a dirty line (or of
+  // the line being written back) is stale: bus reads must not mirror it.
+  bool dcache_holds_newer(uint32_t addr) const {
+    if (dc_wb_.active && dc_wb_.addr == dcache_line(addr)) {
+      return true;
+    }
+    const DcacheLine *l = dcache_find(addr);
+    return l != nullptr && l->dirty;
+  }
+
+  // A refill of the line being written back waits for the write to land.
+  bool dcache_writeback_blocks(uint32_t addr) const {
+    return dc_wb_.active && dc_wb_.addr == dcache_line(addr);
+  }
+
+  // Looks up a cacheable access. Hits (and write-through store misses,
+  // which do not allocate) finish here; other misses pick a victim, queue
+  // its write-back if dirty and start the line refill (dc_miss_). Returns
+  // false without counting anything while a dirty victim has to wait for
+  // the previous write-back.
+  bool dcache_access(const DecodedMemReq &req) {
+    const bool is_store = !req.is_read;
+    DcacheLine *hit = dcache_find(req.paddr);
+    if (hit != nullptr) {
+      perf_.cache_access_num++;
+      if (dc_policy_ == SC_SIM_DCACHE_LRU) {
+        hit->stamp = ++dc_clock_;
+      }
+      hit->dirty = hit->dirty || (is_store && dc_write_back_);
+      return true;
+    }
+    if (is_store && !dc_write_back_) {
+      perf_.cache_access_num++;
+      perf_.cache_miss_num++;
+      return true;
+    }
+    const uint32_t victim = dcache_victim(dcache_set_base(req.paddr));
+    DcacheLine &l = dc_lines_[victim];
+    if (l.valid && l.dirty) {
+      if (dc_wb_.active) {
+        return false;
+      }
+      setup_write(dc_wb_, kDataReqId, l.tag, 0, 0,
+                  static_cast<uint8_t>(dc_line_bytes_ - 1));
+      dc_writebacks_++;
+    }
+    perf_.cache_access_num++;
+    perf_.cache_miss_num++;
+    l.tag = dcache_line(req.paddr);
+    l.valid = false;
+    l.dirty = false;
+    dc_fill_ = victim;
+    dc_fill_dirty_ = is_store;
+    dc_miss_ = true;
+    setup_read(data_req_, axi_interconnect::MASTER_DCACHE_R, kDataReqId,
+               l.tag, static_cast<uint8_t>(dc_line_bytes_ - 1));
+    return true;
+  }
+
+  void dcache_fill_done() {
+    DcacheLine &l = dc_lines_[dc_fill_];
+    l.valid = true;
+    l.dirty = dc_fill_dirty_;
+    l.stamp = ++dc_clock_;
+    dc_miss_ = false;
+  }
+
+  // AMO write after its read brought the line in.
+  bool dcache_store_hit(uint32_t paddr) {
+    DcacheLine *l = dcache_find(paddr);
+    if (l == nullptr) {
+      return false;
+    }
+    l->dirty = true;
+    return true;
+  }
+
+  // The dirty victim goes out as one burst while the refill is running. The
+  // data comes from memory, which nothing changes until the write is done.
+  void drive_dcache_writeback() {
+    dc_wb_req_ready_ = false;
+    dc_wb_resp_valid_ = false;
+    if (!dc_wb_.active) {
+      return;
+    }
+    auto &port = interconnect_.write_port;
+    dc_wb_resp_valid_ = port.resp.valid;
+    port.resp.ready = true;
+    if (!dc_wb_.issued && !port.req.valid) {
+      dc_wb_req_ready_ = port.req.ready;
+      port.req.valid = true;
+      port.req.addr = dc_wb_.addr;
+      port.req.wdata.clear();
+      for (uint32_t i = 0; i < dc_wb_.beats_total; ++i) {
+        port.req.wdata[i] = memory_.read32(dc_wb_.addr + i * 4u);
+      }
+      port.req.wstrb = (dc_line_bytes_ == 32) ? 0xffffffffu
+                                              : (1u << dc_line_bytes_) - 1;
+      port.req.total_size = dc_wb_.total_size;
+      port.req.id = dc_wb_.id;
+    }
+  }
+
+  void update_dcache_writeback_state() {
+    if (!dc_wb_.active) {
+      return;
+    }
+    if (!dc_wb_.issued && dc_wb_req_ready_) {
+      dc_wb_.issued = true;
+    }
+    if (dc_wb_.issued && dc_wb_resp_valid_) {
+      dc_wb_.active = false;
+      note_done(axi_interconnect::MASTER_DCACHE_W, dc_wb_.start);
+    }
+  }
+
+  // ---------------- Perf accounting ----------------
+
+  static size_t stage_index(ExecStage stage) {
+    return static_cast<size_t>(stage);
+  }
+
+  void record_latency(uint8_t master, uint64_t cycles) {
+    sc_sim_latency_hist_t &h = acct_.latency[master];
+    h.count++;
+    h.total_cycles += cycles;
+    h.max_cycles = std::max(h.max_cycles, cycles);
+    const uint32_t bucket =
+        (cycles < 2) ? 0u : static_cast<uint32_t>(63 - __builtin_clzll(cycles));
+    h.buckets[std::min<uint32_t>(bucket, SC_SIM_PERF_LATENCY_BUCKETS - 1)]++;
+  }
+
+  void note_done(uint8_t master, uint64_t start) {
+    record_latency(master, now() - start);
+  }
+
+  // Charges `cycles` to the current stage (and to the page-table walk in
+  // flight, if any).
+  void account_cycles(uint64_t cycles) {
+    acct_.stage[stage_index(stage_)] += cycles;
+    if (mmu_req_.active) {
+      acct_.mmu_pending += cycles;
+    }
+  }
+
+  // One simulated cycle. The slave outputs for this cycle must already be in
+  // interconnect_.axi_io; sample_outputs() sees the settled master outputs
+  // before the sequential update.
+  template <typename SampleOutputs>
+  void run_cycle(SampleOutputs &&sample_outputs) {
+    account_cycles(1);
+    interconnect_.comb_outputs();
+
+    clear_master_inputs();
+
+    bool req_ready = false;
+    bool resp_valid = false;
+    drive_current_stage(req_ready, resp_valid);
+
+    interconnect_.comb_inputs();
+    sample_outputs();
+    mirror_read_data();
+    mirror_write_data();
+
+    interconnect_.seq();
+    cpu_core_.sim_time++;
+
+    update_stage_after_cycle(req_ready, resp_valid);
+    check_limits();
+  }
+
+  // Built-in SimDDR slave: both sides use SimDDR_IO_t, so signals are wired
+  // field by field without going through the C ABI structs.
+  void cycle_with_builtin_ddr() {
+    auto &bus = interconnect_.axi_io;
+    bus.ar.arready = ddr_.io.ar.arready;
+    bus.aw.awready = ddr_.io.aw.awready;
+    bus.w.wready = ddr_.io.w.wready;
+    bus.r.rvalid = ddr_.io.r.rvalid;
+    bus.r.rid = ddr_.io.r.rid;
+    bus.r.rdata = ddr_.io.r.rdata;
+    bus.r.rresp = ddr_.io.r.rresp;
+    bus.r.rlast = ddr_.io.r.rlast;
+    bus.b.bvalid = ddr_.io.b.bvalid;
+    bus.b.bid = ddr_.io.b.bid;
+    bus.b.bresp = ddr_.io.b.bresp;
+
+    run_cycle([&] {
+      ddr_.io.ar.arvalid = bus.ar.arvalid;
+      ddr_.io.ar.arid = bus.ar.arid;
+      ddr_.io.ar.araddr = bus.ar.araddr;
+      ddr_.io.ar.arlen = bus.ar.arlen;
+      ddr_.io.ar.arsize = bus.ar.arsize;
+      ddr_.io.ar.arburst = bus.ar.arburst;
+      ddr_.io.aw.awvalid = bus.aw.awvalid;
+      ddr_.io.aw.awid = bus.aw.awid;
+      ddr_.io.aw.awaddr = bus.aw.awaddr;
+      ddr_.io.aw.awlen = bus.aw.awlen;
+      ddr_.io.aw.awsize = bus.aw.awsize;
+      ddr_.io.aw.awburst = bus.aw.awburst;
+      ddr_.io.w.wvalid = bus.w.wvalid;
+      ddr_.io.w.wdata = bus.w.wdata;
+      ddr_.io.w.wstrb = bus.w.wstrb;
+      ddr_.io.w.wlast = bus.w.wlast;
+      ddr_.io.r.rready = bus.r.rready;
+      ddr_.io.b.bready = bus.b.bready;
+    });
+
+    ddr_.comb_inputs();
+    ddr_.seq();
+    ddr_.comb_outputs();
+  }
+
+  void cycle_with_slave_callback() {
+    apply_axi_inputs(slave_in_);
+    run_cycle([&] { fill_axi_outputs(slave_out_); });
+    slave_fn_(slave_user_, now(), &slave_out_, &slave_in_);
+  }
+
+  // With the built-in DDR the beat already matches memory; skipping equal
+  // words keeps the store from touching (or allocating) pages.
+  void mirror_word(uint32_t addr, uint32_t data) {
+    if (dc_sets_ != 0 && dcache_holds_newer(addr)) {
+      return;
+    }
+    if (memory_.read32(addr) != data) {
+      memory_.write32(addr, data);
     }
-
-    drive_mmu_request();
   }
 
-  void mirror_read_data(const sc_axi4_in_t &axi_in, const sc_axi4_out_t &axi_out) {
-    if (axi_in.rvalid == 0 || axi_out.rready == 0 || p_memory == nullptr) {
+  void mirror_read_data() {
+    const auto &bus = interconnect_.axi_io;
+    if (!bus.r.rvalid || !bus.r.rready) {
       return;
     }
+    const uint32_t rid = bus.r.rid;
+    const uint32_t rdata = bus.r.rdata;
 
     if (fetch_req_.active && fetch_req_.issued &&
-        axi_in.rid == encode_axi_id(fetch_req_.master, fetch_req_.id) &&
+        rid == encode_axi_id(fetch_req_.master, fetch_req_.id) &&
         fetch_req_.beats_seen < fetch_req_.beats_total) {
-      const uint32_t word_addr = (fetch_req_.addr >> 2) + fetch_req_.beats_seen;
-      p_memory[word_addr] = axi_in.rdata;
+      mirror_word(fetch_req_.addr + fetch_req_.beats_seen * 4u, rdata);
       fetch_req_.beats_seen++;
       return;
     }
 
+    if (prefetch_req_.active && prefetch_req_.issued &&
+        rid == encode_axi_id(prefetch_req_.master, prefetch_req_.id) &&
+        prefetch_req_.beats_seen < prefetch_req_.beats_total) {
+      mirror_word(prefetch_req_.addr + prefetch_req_.beats_seen * 4u, rdata);
+      prefetch_req_.beats_seen++;
+      return;
+    }
+
     if (mmu_req_.active && mmu_req_.issued &&
-        axi_in.rid == encode_axi_id(mmu_req_.master, mmu_req_.id) &&
+        rid == encode_axi_id(mmu_req_.master, mmu_req_.id) &&
         mmu_req_.beats_seen < mmu_req_.beats_total) {
-      const uint32_t word_addr = (mmu_req_.addr >> 2) + mmu_req_.beats_seen;
-      p_memory[word_addr] = axi_in.rdata;
-      mmu_hook_.data = axi_in.rdata;
+      mirror_word(mmu_req_.addr + mmu_req_.beats_seen * 4u, rdata);
+      mmu_hook_.data = rdata;
       mmu_req_.beats_seen++;
       return;
     }
 
     if (data_req_.active && data_req_.issued &&
-        axi_in.rid == encode_axi_id(data_req_.master, data_req_.id) &&
+        rid == encode_axi_id(data_req_.master, data_req_.id) &&
         data_req_.beats_seen < data_req_.beats_total) {
-      const uint32_t word_addr = (data_req_.addr >> 2) + data_req_.beats_seen;
-      p_memory[word_addr] = axi_in.rdata;
+      mirror_word(data_req_.addr + data_req_.beats_seen * 4u, rdata);
       data_req_.beats_seen++;
     }
   }
 
-  void mirror_write_data(const sc_axi4_in_t &axi_in,
-                         const sc_axi4_out_t &axi_out) {
-    if (axi_out.wvalid == 0 || axi_in.wready == 0 || !write_req_.active) {
-      return;
-    }
-    const uint32_t current_addr =
-        write_req_.addr + static_cast<uint32_t>(write_req_.beats_seen) * 4u;
-    apply_wstrb_write(current_addr, axi_out.wdata, axi_out.wstrb);
+  void commit_write_beat(uint32_t addr, uint32_t wdata, uint8_t wstrb) {
+    memory_.write32(addr, wdata, wstrb);
 
-    const uint32_t word_base = current_addr & ~0x3u;
+    const uint32_t word_base = addr & ~0x3u;
     for (uint32_t lane = 0; lane < 4; ++lane) {
-      if ((axi_out.wstrb & (1u << lane)) == 0) {
+      if ((wstrb & (1u << lane)) == 0) {
         continue;
       }
       const uint32_t byte_addr = word_base + lane;
       if (byte_addr == UART_BASE) {
         uart_valid_ = true;
-        uart_ch_ = static_cast<uint8_t>((axi_out.wdata >> (lane * 8)) & 0xffu);
+        uart_ch_ = static_cast<uint8_t>((wdata >> (lane * 8)) & 0xffu);
       }
     }
+  }
+
+  void mirror_write_data() {
+    const auto &bus = interconnect_.axi_io;
+    if (!bus.w.wvalid || !bus.w.wready) {
+      return;
+    }
+    if (sb_written_ < sb_issued_) {
+      const StoreBufferEntry &e = sb_at(sb_written_);
+      commit_write_beat(e.addr, bus.w.wdata, static_cast<uint8_t>(bus.w.wstrb));
+      sb_written_++;
+      return;
+    }
+    if (dc_wb_.active && dc_wb_.issued &&
+        dc_wb_.beats_seen < dc_wb_.beats_total) {
+      commit_write_beat(dc_wb_.addr + dc_wb_.beats_seen * 4u, bus.w.wdata,
+                        static_cast<uint8_t>(bus.w.wstrb));
+      dc_wb_.beats_seen++;
+      return;
+    }
+    if (!write_req_.active) {
+      return;
+    }
+    const uint32_t current_addr =
+        write_req_.addr + static_cast<uint32_t>(write_req_.beats_seen) * 4u;
+    commit_write_beat(current_addr, bus.w.wdata,
+                      static_cast<uint8_t>(bus.w.wstrb));
 
     if (write_req_.beats_seen < std::numeric_limits<uint8_t>::max()) {
       write_req_.beats_seen++;
@@ -690,40 +1971,69 @@ private:
     }
     if (mmu_req_.issued && mmu_resp_valid_) {
       mmu_req_.active = false;
+      note_done(axi_interconnect::MASTER_MMU, mmu_req_.start);
       mmu_hook_.response_valid = true;
-      if (p_memory != nullptr) {
-        mmu_hook_.data = p_memory[mmu_hook_.addr >> 2];
-      }
+      mmu_hook_.data = memory_.read32(mmu_hook_.addr);
     }
   }
 
   void update_stage_after_cycle(bool req_ready, bool resp_valid) {
     update_mmu_request_state();
+    update_prefetch_state();
+    update_store_buffer_state();
+    update_dcache_writeback_state();
 
     switch (stage_) {
     case ExecStage::kPrepareFetch:
+      // WFI 睡眠中：停在取指前直到 CLINT 截止周期，与单步粒度无关
+      if (wfi_sleep_cycles() != 0) {
+        last_progress_time_ = now();
+        break;
+      }
       prepare_fetch();
       break;
-    case ExecStage::kWaitFetch:
-      if (!fetch_req_.issued && req_ready) {
-        fetch_req_.issued = true;
+    case ExecStage::kWaitFetch: {
+      bool done = false;
+      if (fetch_req_.active) {
+        if (!fetch_req_.issued && req_ready) {
+          fetch_req_.issued = true;
+        }
+        if (fetch_req_.issued && resp_valid) {
+          fetch_req_.active = false;
+          note_done(axi_interconnect::MASTER_ICACHE, fetch_req_.start);
+          done = true;
+          if (fetch_req_.total_size == kFetchLineBytes - 1) {
+            fetch_buffer_fill(fetch_req_.addr);
+          }
+        }
+      } else {
+        done = fetch_buffer_hit(fetch_paddr_); // 等预取带回本行
       }
-      if (fetch_req_.issued && resp_valid) {
-        fetch_req_.active = false;
-        inst_word_ = fetch_ok_ ? p_memory[fetch_paddr_ >> 2] : 0u;
+      if (done) {
+        inst_word_ = fetch_ok_ ? memory_.read32(fetch_paddr_) : 0u;
         stage_ = ExecStage::kPrepareData;
       }
       break;
+    }
     case ExecStage::kPrepareData:
       prepare_data_request();
       break;
     case ExecStage::kWaitData:
-      if (pre_req_.is_read) {
+      if (pre_req_.is_read || dc_miss_) {
         if (!data_req_.issued && req_ready) {
           data_req_.issued = true;
         }
         if (data_req_.issued && resp_valid) {
           data_req_.active = false;
+          note_done(axi_interconnect::MASTER_DCACHE_R, data_req_.start);
+          if (dc_miss_) {
+            dcache_fill_done();
+          }
+          stage_ = ExecStage::kExecute;
+        }
+      } else if (posts_store(pre_req_)) {
+        if (store_buffer_push(pre_req_.paddr, pre_req_.wdata,
+                              static_cast<uint8_t>(pre_req_.wstrb))) {
           stage_ = ExecStage::kExecute;
         }
       } else {
@@ -732,6 +2042,7 @@ private:
         }
         if (write_req_.issued && resp_valid) {
           write_req_.active = false;
+          note_done(axi_interconnect::MASTER_DCACHE_W, write_req_.start);
           stage_ = ExecStage::kExecute;
         }
       }
@@ -741,12 +2052,7 @@ private:
       if (cpu_core_.translation_pending) {
         break;
       }
-      inst_count_++;
-      last_progress_time_ = static_cast<uint64_t>(sim_time);
-      if (inst_count_ != last_inst_count_) {
-        last_inst_count_ = inst_count_;
-        stall_reported_ = false;
-      }
+      note_retired();
 
       if (inst_word_ == INST_EBREAK) {
         halted_reason_ebreak_ = true;
@@ -754,13 +2060,30 @@ private:
         success_ = true;
         break;
       }
+      if (is_fence_i(inst_word_)) {
+        fetch_buffer_flush();
+      }
 
       if (((inst_word_ & 0x7f) == 0x2f) && cpu_core_.state.store) {
         const uint8_t amo_wstrb =
             static_cast<uint8_t>(cpu_core_.state.store_strb & 0xfu);
+        const uint8_t wstrb =
+            static_cast<uint8_t>(amo_wstrb == 0 ? 0xfu : amo_wstrb);
+        if (dc_write_back_ && dcache_caches(cpu_core_.state.store_addr) &&
+            dcache_store_hit(cpu_core_.state.store_addr)) {
+          stage_ = ExecStage::kPrepareFetch;
+          break;
+        }
+        // The AMO drained the buffer before its read, so a RAM write always
+        // fits.
+        if (sb_entries_ != 0 && cpu_core_.state.store_addr >= kImageBase &&
+            store_buffer_push(cpu_core_.state.store_addr,
+                              cpu_core_.state.store_data, wstrb)) {
+          stage_ = ExecStage::kPrepareFetch;
+          break;
+        }
         setup_write(write_req_, kDataReqId, cpu_core_.state.store_addr,
-                    cpu_core_.state.store_data,
-                    static_cast<uint8_t>(amo_wstrb == 0 ? 0xfu : amo_wstrb), 3);
+                    cpu_core_.state.store_data, wstrb, 3);
         stage_ = ExecStage::kWaitAmoWrite;
         break;
       }
@@ -773,6 +2096,7 @@ private:
       }
       if (write_req_.issued && resp_valid) {
         write_req_.active = false;
+        note_done(axi_interconnect::MASTER_DCACHE_W, write_req_.start);
         stage_ = ExecStage::kPrepareFetch;
       }
       break;
@@ -781,6 +2105,310 @@ private:
     }
   }
 
+  void note_retired() {
+    inst_count_++;
+    last_progress_time_ = now();
+    if (inst_count_ != last_inst_count_) {
+      last_inst_count_ = inst_count_;
+      stall_reported_ = false;
+    }
+  }
+
+  // ---------------- TLM timing ----------------
+
+  // One whole instruction from kPrepareFetch. Transactions complete directly
+  // on memory and charge their calibrated cost; page-table reads return at
+  // once and are counted in tlm_ptw_reads_. Stage-by-stage the cycle count is
+  // the same as the cycle model's.
+  void tlm_step_inst() {
+    if (!tlm_costs_.valid) {
+      calibrate_tlm();
+    }
+    const TlmCosts &cost = tlm_costs_;
+
+    uint64_t cycles = 1; // kPrepareFetch
+    tlm_ptw_reads_ = 0;
+    fetch_vaddr_ = cpu_core_.state.pc;
+    fetch_ok_ = translate_addr(cpu_core_, fetch_vaddr_, 0, fetch_paddr_);
+    const uint32_t fetch_ptw_reads = tlm_ptw_reads_;
+    inst_word_ = 0;
+    pre_req_ = {};
+    acct_.stage[stage_index(ExecStage::kPrepareFetch)] +=
+        1 + fetch_ptw_reads * cost.mmu_read;
+    if (fetch_ok_) {
+      cycles += cost.fetch;
+      acct_.stage[stage_index(ExecStage::kWaitFetch)] += cost.fetch;
+      record_latency(axi_interconnect::MASTER_ICACHE, cost.fetch);
+      inst_word_ = memory_.read32(fetch_paddr_);
+      cycles += 1; // kPrepareData
+      pre_req_ = decode_mem_req_pre_exec(cpu_core_, inst_word_);
+      acct_.stage[stage_index(ExecStage::kPrepareData)] +=
+          1 + (tlm_ptw_reads_ - fetch_ptw_reads) * cost.mmu_read;
+      if (pre_req_.valid) {
+        const uint32_t size = pre_req_.total_size & 0x3u;
+        const uint32_t data_cost =
+            pre_req_.is_read ? cost.read[size] : cost.write[size];
+        cycles += data_cost;
+        acct_.stage[stage_index(ExecStage::kWaitData)] += data_cost;
+        record_latency(pre_req_.is_read ? axi_interconnect::MASTER_DCACHE_R
+                                        : axi_interconnect::MASTER_DCACHE_W,
+                       data_cost);
+        if (!pre_req_.is_read) {
+          commit_write_beat(pre_req_.paddr, pre_req_.wdata,
+                            static_cast<uint8_t>(pre_req_.wstrb));
+        }
+      }
+    }
+    cycles += 1 + tlm_ptw_reads_ * cost.mmu_read; // kExecute
+    cpu_core_.sim_time += static_cast<long long>(cycles);
+    const uint32_t pre_exec_ptw_reads = tlm_ptw_reads_;
+
+    // exec() sees the same sim_time as in the cycle model's kExecute cycle.
+    tlm_ptw_reads_ = 0;
+    cpu_core_.exec();
+    cpu_core_.sim_time +=
+        static_cast<long long>(tlm_ptw_reads_ * cost.mmu_read);
+    acct_.stage[stage_index(ExecStage::kExecute)] +=
+        1 + tlm_ptw_reads_ * cost.mmu_read;
+    for (uint32_t i = 0; i < pre_exec_ptw_reads + tlm_ptw_reads_; ++i) {
+      record_latency(axi_interconnect::MASTER_MMU, cost.mmu_read);
+    }
+    acct_.mmu_pending +=
+        static_cast<uint64_t>(pre_exec_ptw_reads + tlm_ptw_reads_) *
+        cost.mmu_read;
+    note_retired();
+    if (const uint64_t sleep = wfi_sleep_cycles(); sleep != 0) {
+      // 与周期模型一致：睡眠算在下一条指令的 kPrepareFetch 之前
+      const uint64_t t = now();
+      const uint64_t until = std::min(t + sleep - 1, std::max(t, max_cycles_));
+      acct_.stage[stage_index(ExecStage::kPrepareFetch)] += until - t;
+      cpu_core_.sim_time = static_cast<long long>(until);
+      last_progress_time_ = until;
+    }
+
+    if (inst_word_ == INST_EBREAK) {
+      halted_reason_ebreak_ = true;
+      stage_ = ExecStage::kHalted;
+      success_ = true;
+      return;
+    }
+    if (((inst_word_ & 0x7f) == 0x2f) && cpu_core_.state.store) {
+      const uint8_t amo_wstrb =
+          static_cast<uint8_t>(cpu_core_.state.store_strb & 0xfu);
+      commit_write_beat(cpu_core_.state.store_addr, cpu_core_.state.store_data,
+                        static_cast<uint8_t>(amo_wstrb == 0 ? 0xfu : amo_wstrb));
+      cpu_core_.sim_time += cost.amo_write;
+      acct_.stage[stage_index(ExecStage::kWaitAmoWrite)] += cost.amo_write;
+      record_latency(axi_interconnect::MASTER_DCACHE_W, cost.amo_write);
+    }
+  }
+
+  // ---------------- Idle skipping ----------------
+
+  // Cycles until the CLINT deadline after a WFI that found no pending
+  // interrupt; 0 when the core is not asleep or nothing will wake it.
+  uint64_t wfi_sleep_cycles() const {
+    if (!cpu_core_.wfi_idle) {
+      return 0;
+    }
+    const uint64_t event = cpu_core_.clint.next_event();
+    const uint64_t t = now();
+    return (event != Clint::kNever && event > t) ? event - t : 0;
+  }
+
+  // A sleeping core with nothing in flight anywhere: the only thing that can
+  // happen before the CLINT deadline is sim_time moving.
+  bool bus_quiescent() const {
+    return !fetch_req_.active && !prefetch_req_.active && !data_req_.active &&
+           !write_req_.active && !mmu_req_.active && !dc_wb_.active &&
+           sb_count_ == 0 && interconnect_.idle() &&
+           ddr_.idle_cycles() == UINT64_MAX;
+  }
+
+  // Upcoming cycles in which only DDR latency counters (and sim_time) move:
+  // the core waits on an issued request and the bus has nothing to hand over.
+  // 0 if the next cycle may change anything else.
+  uint64_t idle_cycles() const {
+    if (stage_ == ExecStage::kPrepareFetch) {
+      return bus_quiescent() ? wfi_sleep_cycles() : 0;
+    }
+    bool issued = false;
+    switch (stage_) {
+    case ExecStage::kWaitFetch:
+      issued = fetch_req_.active ? fetch_req_.issued : prefetch_req_.issued;
+      break;
+    case ExecStage::kWaitData:
+      if (pre_req_.is_read || dc_miss_) {
+        issued = data_req_.issued;
+      } else {
+        // A posted store waiting for room only needs bus progress.
+        issued = posts_store(pre_req_) || write_req_.issued;
+      }
+      break;
+    case ExecStage::kWaitAmoWrite:
+      issued = write_req_.issued;
+      break;
+    default:
+      break;
+    }
+    if (!issued || (mmu_req_.active && !mmu_req_.issued) ||
+        (prefetch_req_.active && !prefetch_req_.issued) ||
+        (dc_wb_.active && !dc_wb_.issued) || !interconnect_.idle()) {
+      return 0;
+    }
+    return ddr_.idle_cycles();
+  }
+
+  // Skips the idle cycles ahead except the last one, which runs normally so
+  // the latency expiry and the bus signals after it come from the real cycle.
+  // Capped to end before n_cycles, max_cycles and the stall report.
+  uint64_t skip_idle_cycles(uint64_t max_skip) {
+    const uint64_t idle = idle_cycles();
+    if (idle <= 1) {
+      return 0;
+    }
+    uint64_t skip = std::min(idle - 1, max_skip);
+    const uint64_t t = now();
+    skip = std::min(skip, (max_cycles_ > t + 1) ? max_cycles_ - t - 1 : 0);
+    // WFI 睡眠不算停滞
+    const bool sleeping = stage_ == ExecStage::kPrepareFetch;
+    if (!stall_reported_ && !sleeping) {
+      const uint64_t stall_at = last_progress_time_ + kStallCycles;
+      skip = std::min(skip, (stall_at > t) ? stall_at - t : 0);
+    }
+    if (skip == 0) {
+      return 0;
+    }
+    account_cycles(skip);
+    ddr_.skip_cycles(skip);
+    interconnect_.skip_cycles(skip);
+    mmu_req_ready_ = false;
+    mmu_resp_valid_ = false;
+    sb_req_ready_ = false;
+    sb_resp_valid_ = false;
+    prefetch_req_ready_ = false;
+    prefetch_resp_valid_ = false;
+    dc_wb_req_ready_ = false;
+    dc_wb_resp_valid_ = false;
+    cpu_core_.sim_time += static_cast<long long>(skip);
+    if (sleeping) {
+      last_progress_time_ = now();
+    }
+    return skip;
+  }
+
+  void run_cycles(uint64_t n_cycles, uint32_t stop_mask) {
+    const uint64_t start_inst = inst_count_;
+    for (uint64_t i = 0; i < n_cycles && stage_ != ExecStage::kHalted; ++i) {
+      clear_uart_event();
+      if (slave_fn_ == nullptr) {
+        i += skip_idle_cycles(n_cycles - i - 1);
+        cycle_with_builtin_ddr();
+      } else {
+        cycle_with_slave_callback();
+      }
+      if ((stop_mask & SC_SIM_STOP_UART) && uart_valid_) {
+        break;
+      }
+      if ((stop_mask & SC_SIM_STOP_RETIRE) && inst_count_ != start_inst) {
+        break;
+      }
+    }
+  }
+
+  // step_n() in TLM timing. Instruction granularity: the last instruction may
+  // end past n_cycles.
+  void run_tlm(uint64_t n_cycles, uint32_t stop_mask) {
+    const uint64_t start_inst = inst_count_;
+    const uint64_t end_time =
+        (n_cycles > std::numeric_limits<uint64_t>::max() - now())
+            ? std::numeric_limits<uint64_t>::max()
+            : now() + n_cycles;
+    while (stage_ != ExecStage::kHalted && now() < end_time) {
+      clear_uart_event();
+      tlm_step_inst();
+      check_limits();
+      if ((stop_mask & SC_SIM_STOP_UART) && uart_valid_) {
+        break;
+      }
+      if ((stop_mask & SC_SIM_STOP_RETIRE) && inst_count_ != start_inst) {
+        break;
+      }
+    }
+  }
+
+  template <typename Done>
+  static uint32_t probe_cycles(SingleCycleAxi4Sim &probe, Done &&done) {
+    constexpr uint32_t kProbeLimit = 1u << 20;
+    uint32_t cycles = 0;
+    do {
+      probe.cycle_with_builtin_ddr();
+      cycles++;
+    } while (!done() && cycles < kProbeLimit);
+    return cycles;
+  }
+
+  // Each probe starts like the live pipeline does: request set up during the
+  // previous cycle, counted up to and including the cycle that sees the
+  // response.
+  void calibrate_tlm() {
+    constexpr uint32_t kProbeAddr = 0x80000000u;
+    const uint32_t latency = ddr_.get_latency();
+    auto make_probe = [latency] {
+      auto probe = std::make_unique<SingleCycleAxi4Sim>();
+      probe->ddr_.set_latency(latency);
+      return probe;
+    };
+    TlmCosts cost;
+
+    {
+      auto p = make_probe();
+      p->setup_read(p->fetch_req_, axi_interconnect::MASTER_ICACHE,
+                    kFetchReqId, kProbeAddr, 3);
+      p->stage_ = ExecStage::kWaitFetch;
+      cost.fetch =
+          probe_cycles(*p, [&] { return p->stage_ != ExecStage::kWaitFetch; });
+    }
+    {
+      auto p = make_probe();
+      p->mmu_hook_.pending = true;
+      p->mmu_hook_.addr = kProbeAddr;
+      p->setup_read(p->mmu_req_, axi_interconnect::MASTER_MMU, kMmuReqId,
+                    kProbeAddr, 3);
+      p->stage_ = ExecStage::kHalted;
+      cost.mmu_read =
+          probe_cycles(*p, [&] { return p->mmu_hook_.response_valid; });
+    }
+    for (uint8_t size = 0; size < 4; ++size) {
+      for (const bool is_read : {true, false}) {
+        auto p = make_probe();
+        p->pre_req_.valid = true;
+        p->pre_req_.is_read = is_read;
+        p->pre_req_.paddr = kProbeAddr;
+        p->pre_req_.total_size = size;
+        if (is_read) {
+          p->setup_read(p->data_req_, axi_interconnect::MASTER_DCACHE_R,
+                        kDataReqId, kProbeAddr, size);
+        } else {
+          p->setup_write(p->write_req_, kDataReqId, kProbeAddr, 0, 0xf, size);
+        }
+        p->stage_ = ExecStage::kWaitData;
+        const uint32_t cycles =
+            probe_cycles(*p, [&] { return p->stage_ != ExecStage::kWaitData; });
+        (is_read ? cost.read : cost.write)[size] = cycles;
+      }
+    }
+    {
+      auto p = make_probe();
+      p->setup_write(p->write_req_, kDataReqId, kProbeAddr, 0, 0xf, 3);
+      p->stage_ = ExecStage::kWaitAmoWrite;
+      cost.amo_write = probe_cycles(
+          *p, [&] { return p->stage_ != ExecStage::kWaitAmoWrite; });
+    }
+    cost.valid = true;
+    tlm_costs_ = cost;
+  }
+
   void prepare_fetch() {
     fetch_vaddr_ = cpu_core_.state.pc;
     fetch_ok_ = translate_addr(cpu_core_, fetch_vaddr_, 0, fetch_paddr_);
@@ -793,20 +2421,62 @@ private:
       stage_ = ExecStage::kExecute;
       return;
     }
+    if (fb_lines_ != 0 && fetch_paddr_ >= kImageBase) {
+      const uint32_t line = fetch_paddr_ & ~(kFetchLineBytes - 1);
+      start_prefetch(line);
+      perf_.icache_access_num++;
+      if (fetch_buffer_hit(fetch_paddr_)) {
+        inst_word_ = memory_.read32(fetch_paddr_);
+        stage_ = ExecStage::kPrepareData;
+        return;
+      }
+      perf_.icache_miss_num++;
+      stage_ = ExecStage::kWaitFetch;
+      if (prefetch_req_.active && prefetch_req_.addr == line) {
+        fetch_req_ = {}; // 行已在预取中
+        return;
+      }
+      setup_read(fetch_req_, axi_interconnect::MASTER_ICACHE, kFetchReqId,
+                 line, kFetchLineBytes - 1);
+      return;
+    }
     setup_read(fetch_req_, axi_interconnect::MASTER_ICACHE, kFetchReqId,
                fetch_paddr_, 3);
     stage_ = ExecStage::kWaitFetch;
   }
 
   void prepare_data_request() {
+    if ((sb_count_ != 0 && orders_memory(inst_word_)) ||
+        (prefetch_req_.active && is_fence_i(inst_word_))) {
+      return; // 等写缓冲排空 / 预取完成
+    }
     pre_req_ = decode_mem_req_pre_exec(cpu_core_, inst_word_);
     if (cpu_core_.translation_pending) {
       return;
     }
     if (pre_req_.valid) {
+      if (pre_req_.is_read && store_buffer_forwards(pre_req_)) {
+        stage_ = ExecStage::kExecute;
+        return;
+      }
+      if (dcache_caches(pre_req_.paddr)) {
+        if (!dcache_access(pre_req_)) {
+          return; // 牺牲行要等上一次写回完成
+        }
+        if (dc_miss_ || pre_req_.is_read || dc_write_back_) {
+          stage_ = dc_miss_ ? ExecStage::kWaitData : ExecStage::kExecute;
+          return;
+        }
+      }
       if (pre_req_.is_read) {
         setup_read(data_req_, axi_interconnect::MASTER_DCACHE_R, kDataReqId,
                    pre_req_.paddr, pre_req_.total_size);
+      } else if (posts_store(pre_req_)) {
+        stage_ = store_buffer_push(pre_req_.paddr, pre_req_.wdata,
+                                   static_cast<uint8_t>(pre_req_.wstrb))
+                     ? ExecStage::kExecute
+                     : ExecStage::kWaitData;
+        return;
       } else {
         setup_write(write_req_, kDataReqId, pre_req_.paddr, pre_req_.wdata,
                     static_cast<uint8_t>(pre_req_.wstrb), pre_req_.total_size);
@@ -817,6 +2487,17 @@ private:
     stage_ = ExecStage::kExecute;
   }
 
+  // A max_inst stop is resumable: raising the limit (or restoring a
+  // checkpoint taken at the stop) continues from the interrupted stage.
+  void resume_after_max_inst() {
+    if (stage_ == ExecStage::kHalted && halted_reason_max_inst_ &&
+        inst_count_ < max_inst_) {
+      stage_ = resume_stage_;
+      halted_reason_max_inst_ = false;
+      success_ = false;
+    }
+  }
+
   void check_limits() {
     if (stage_ == ExecStage::kHalted) {
       return;
@@ -824,20 +2505,19 @@ private:
 
     if (inst_count_ >= max_inst_) {
       halted_reason_max_inst_ = true;
+      resume_stage_ = stage_;
       stage_ = ExecStage::kHalted;
       success_ = true;
       return;
     }
 
-    if (static_cast<uint64_t>(sim_time) >= max_cycles_) {
+    if (now() >= max_cycles_) {
       set_error("max_cycles reached");
       stage_ = ExecStage::kHalted;
       success_ = false;
     }
 
-    constexpr uint64_t kStallCycles = 2000000ULL;
-    if (!stall_reported_ &&
-        static_cast<uint64_t>(sim_time) > last_progress_time_ + kStallCycles &&
+    if (!stall_reported_ && now() > last_progress_time_ + kStallCycles &&
         stage_ != ExecStage::kHalted) {
       stall_reported_ = true;
       std::fprintf(
@@ -846,7 +2526,7 @@ private:
           "mmu_pending=%d mmu_resp=%d mmu_addr=0x%08x mmu_req_active=%d "
           "mmu_req_issued=%d mmu_beats=%u/%u mmu_req_ready=%d "
           "arvalid=%d arready=%d arid=%u araddr=0x%08x\n",
-          static_cast<unsigned long long>(sim_time),
+          static_cast<unsigned long long>(now()),
           static_cast<unsigned long long>(inst_count_), stage_name(stage_),
           mmu_hook_.pending ? 1 : 0, mmu_hook_.response_valid ? 1 : 0,
           mmu_hook_.addr, mmu_req_.active ? 1 : 0, mmu_req_.issued ? 1 : 0,
@@ -860,7 +2540,7 @@ private:
   }
 
   void fill_status(sc_sim_status_t &status) const {
-    status.sim_time = static_cast<uint64_t>(sim_time);
+    status.sim_time = now();
     status.inst_count = inst_count_;
     status.halted = (stage_ == ExecStage::kHalted) ? 1 : 0;
     status.success = success_ ? 1 : 0;
@@ -878,12 +2558,16 @@ private:
   axi_interconnect::AXI_Interconnect interconnect_{};
 
   ExecStage stage_ = ExecStage::kHalted;
+  ExecStage resume_stage_ = ExecStage::kPrepareFetch;
   bool image_loaded_ = false;
   bool success_ = false;
   bool halted_reason_max_inst_ = false;
   bool halted_reason_ebreak_ = false;
   uint64_t max_inst_ = MAX_COMMIT_INST;
   uint64_t max_cycles_ = 12000000000ULL;
+  bool tlm_mode_ = false;
+  TlmCosts tlm_costs_{};
+  uint32_t tlm_ptw_reads_ = 0;
   uint64_t inst_count_ = 0;
   uint64_t last_inst_count_ = 0;
   uint64_t last_progress_time_ = 0;
@@ -902,34 +2586,130 @@ private:
   bool mmu_resp_valid_ = false;
   MmuHookState mmu_hook_{};
 
+  // Posted stores, oldest first from sb_head_: [0, sb_written_) sent their
+  // W beat, [0, sb_issued_) were accepted by the interconnect.
+  StoreBufferEntry sb_[SC_SIM_STORE_BUFFER_MAX]{};
+  uint32_t sb_entries_ = 0; // capacity, 0 = off
+  uint32_t sb_head_ = 0;
+  uint32_t sb_count_ = 0;
+  uint32_t sb_issued_ = 0;
+  uint32_t sb_written_ = 0;
+  bool sb_req_ready_ = false;
+  bool sb_resp_valid_ = false;
+
+  // Fetch buffer: fb_lines_ line slots (0 = off), filled FIFO from fb_victim_
+  uint32_t fb_tag_[SC_SIM_FETCH_BUFFER_MAX]{};
+  bool fb_valid_[SC_SIM_FETCH_BUFFER_MAX]{};
+  uint32_t fb_lines_ = 0;
+  bool fb_prefetch_ = false;
+  uint32_t fb_victim_ = 0;
+  ReadReqState prefetch_req_{};
+  bool prefetch_req_ready_ = false;
+  bool prefetch_resp_valid_ = false;
+
+  // Data cache: dc_sets_ x dc_ways_ lines, set-major (0 sets = off). At most
+  // one refill (dc_miss_, into dc_lines_[dc_fill_]) and one dirty-line
+  // write-back (dc_wb_) are in flight.
+  std::vector<DcacheLine> dc_lines_{};
+  uint32_t dc_sets_ = 0;
+  uint32_t dc_ways_ = 0;
+  uint32_t dc_line_bytes_ = 0;
+  int dc_policy_ = SC_SIM_DCACHE_LRU;
+  bool dc_write_back_ = false;
+  uint64_t dc_clock_ = 0;
+  uint32_t dc_rng_ = 0;
+  bool dc_miss_ = false;
+  uint32_t dc_fill_ = 0;
+  bool dc_fill_dirty_ = false;
+  WriteReqState dc_wb_{};
+  bool dc_wb_req_ready_ = false;
+  bool dc_wb_resp_valid_ = false;
+  uint64_t dc_writebacks_ = 0;
+  PerfCount perf_{};
+  CycleAccounting acct_{};
+  guest_prof::GuestProfiler profiler_;
+
   bool uart_valid_ = false;
   uint8_t uart_ch_ = 0;
 
+  PhysicalMemory memory_{};
+  sim_ddr::SimDDR ddr_{};
+  sc_sim_slave_fn slave_fn_ = nullptr;
+  void *slave_user_ = nullptr;
+  sc_axi4_in_t slave_in_{};
+  sc_axi4_out_t slave_out_{};
+
   std::string last_error_{};
 };
 
-static CpuMemReadResult cpu_mem_read_hook(uint32_t paddr, uint32_t *data) {
-  if (g_active_sim == nullptr) {
-    return CPU_MEM_READ_FAULT;
-  }
-  return g_active_sim->on_cpu_mem_read(paddr, data);
-}
-
-static bool cpu_mem_read_now_hook(uint32_t paddr, uint32_t *data) {
-  if (p_memory == nullptr || data == nullptr) {
-    return false;
+// JSON view of sc_sim_perf_t. Stage cycles are also given as a share of
+// sim_time and latencies with their mean, so CPI stacks can be read off
+// directly.
+void write_perf_json_object(const sc_sim_perf_t &perf, FILE *out) {
+  const auto u64 = [](uint64_t v) { return static_cast<unsigned long long>(v); };
+  const double total = perf.sim_time != 0 ? static_cast<double>(perf.sim_time)
+                                          : 1.0;
+  std::fprintf(out, "{\n  \"sim_time\": %llu,\n  \"inst_count\": %llu,\n",
+               u64(perf.sim_time), u64(perf.inst_count));
+  std::fprintf(out, "  \"cpi\": %.6f,\n",
+               perf.inst_count != 0
+                   ? static_cast<double>(perf.sim_time) /
+                         static_cast<double>(perf.inst_count)
+                   : 0.0);
+
+  const struct {
+    const char *name;
+    uint64_t cycles;
+  } stages[] = {
+      {"prepare_fetch", perf.prepare_fetch_cycles},
+      {"wait_fetch", perf.wait_fetch_cycles},
+      {"prepare_data", perf.prepare_data_cycles},
+      {"wait_data", perf.wait_data_cycles},
+      {"execute", perf.execute_cycles},
+      {"wait_amo_write", perf.wait_amo_write_cycles},
+      {"fast_forward", perf.fast_forward_cycles},
+  };
+  std::fputs("  \"stage_cycles\": {\n", out);
+  for (size_t i = 0; i < sizeof(stages) / sizeof(stages[0]); ++i) {
+    std::fprintf(out, "    \"%s\": {\"cycles\": %llu, \"share\": %.6f}%s\n",
+                 stages[i].name, u64(stages[i].cycles),
+                 static_cast<double>(stages[i].cycles) / total,
+                 i + 1 < sizeof(stages) / sizeof(stages[0]) ? "," : "");
   }
-  *data = p_memory[(paddr & ~0x3u) >> 2];
-  return true;
-}
-
-static bool cpu_mem_write_now_hook(uint32_t paddr, uint32_t data,
-                                   uint32_t wstrb) {
-  if (p_memory == nullptr) {
-    return false;
+  std::fputs("  },\n", out);
+  std::fprintf(out, "  \"mmu_pending_cycles\": %llu,\n",
+               u64(perf.mmu_pending_cycles));
+  std::fprintf(out,
+               "  \"icache\": {\"access\": %llu, \"miss\": %llu},\n"
+               "  \"dcache\": {\"access\": %llu, \"miss\": %llu, "
+               "\"writeback\": %llu},\n"
+               "  \"itlb\": {\"hit\": %llu, \"miss\": %llu},\n"
+               "  \"dtlb\": {\"hit\": %llu, \"miss\": %llu},\n",
+               u64(perf.icache_access), u64(perf.icache_miss),
+               u64(perf.dcache_access), u64(perf.dcache_miss),
+               u64(perf.dcache_writeback), u64(perf.itlb_hit),
+               u64(perf.itlb_miss), u64(perf.dtlb_hit), u64(perf.dtlb_miss));
+
+  static const char *const kMasterNames[SC_SIM_PERF_MASTERS] = {
+      "icache", "dcache_r", "mmu", "dcache_w"};
+  std::fputs("  \"axi_latency\": {\n", out);
+  for (int m = 0; m < SC_SIM_PERF_MASTERS; ++m) {
+    const sc_sim_latency_hist_t &h = perf.latency[m];
+    std::fprintf(out,
+                 "    \"%s\": {\"count\": %llu, \"total_cycles\": %llu, "
+                 "\"max_cycles\": %llu, \"mean_cycles\": %.3f,\n"
+                 "      \"buckets\": [",
+                 kMasterNames[m], u64(h.count), u64(h.total_cycles),
+                 u64(h.max_cycles),
+                 h.count != 0 ? static_cast<double>(h.total_cycles) /
+                                    static_cast<double>(h.count)
+                              : 0.0);
+    for (int b = 0; b < SC_SIM_PERF_LATENCY_BUCKETS; ++b) {
+      std::fprintf(out, "%s%llu", b != 0 ? ", " : "", u64(h.buckets[b]));
+    }
+    std::fprintf(out, "]}%s\n", m + 1 < SC_SIM_PERF_MASTERS ? "," : "");
   }
-  apply_wstrb_write(paddr, data, wstrb);
-  return true;
+  std::fputs("  }\n}\n", out);
 }
 
 } // namespace
@@ -942,6 +2722,17 @@ extern "C" {
 
 sc_sim_handle *sc_sim_create(void) { return new (std::nothrow) sc_sim_handle(); }
 
+sc_sim_handle *sc_sim_clone(sc_sim_handle *handle) {
+  if (handle == nullptr) {
+    return nullptr;
+  }
+  sc_sim_handle *clone = new (std::nothrow) sc_sim_handle(*handle);
+  if (clone != nullptr) {
+    clone->sim.bind_self();
+  }
+  return clone;
+}
+
 void sc_sim_destroy(sc_sim_handle *handle) { delete handle; }
 
 int sc_sim_load_image(sc_sim_handle *handle, const char *image_path,
@@ -960,6 +2751,58 @@ void sc_sim_set_limits(sc_sim_handle *handle, uint64_t max_inst,
   handle->sim.set_limits(max_inst, max_cycles);
 }
 
+void sc_sim_set_ddr_latency(sc_sim_handle *handle, uint32_t cycles) {
+  if (handle == nullptr) {
+    return;
+  }
+  handle->sim.set_ddr_latency(cycles);
+}
+
+int sc_sim_set_timing_mode(sc_sim_handle *handle, int mode) {
+  if (handle == nullptr) {
+    return -1;
+  }
+  return handle->sim.set_timing_mode(mode);
+}
+
+int sc_sim_set_store_buffer(sc_sim_handle *handle, uint32_t entries) {
+  if (handle == nullptr) {
+    return -1;
+  }
+  return handle->sim.set_store_buffer(entries);
+}
+
+int sc_sim_set_fetch_buffer(sc_sim_handle *handle, uint32_t lines,
+                            int prefetch) {
+  if (handle == nullptr) {
+    return -1;
+  }
+  return handle->sim.set_fetch_buffer(lines, prefetch != 0);
+}
+
+int sc_sim_set_dcache(sc_sim_handle *handle, uint32_t sets, uint32_t ways,
+                      uint32_t line_bytes, int policy, int write_back) {
+  if (handle == nullptr) {
+    return -1;
+  }
+  return handle->sim.set_dcache(sets, ways, line_bytes, policy,
+                                write_back != 0);
+}
+
+int sc_sim_save_checkpoint(sc_sim_handle *handle, const char *path) {
+  if (handle == nullptr) {
+    return -1;
+  }
+  return handle->sim.save_checkpoint(path);
+}
+
+int sc_sim_load_checkpoint(sc_sim_handle *handle, const char *path) {
+  if (handle == nullptr) {
+    return -1;
+  }
+  return handle->sim.load_checkpoint(path);
+}
+
 int sc_sim_step(sc_sim_handle *handle, const sc_axi4_in_t *axi_in,
                 sc_axi4_out_t *axi_out, sc_sim_status_t *status_out) {
   if (handle == nullptr || axi_in == nullptr || axi_out == nullptr ||
@@ -969,6 +2812,36 @@ int sc_sim_step(sc_sim_handle *handle, const sc_axi4_in_t *axi_in,
   return handle->sim.step(*axi_in, *axi_out, *status_out);
 }
 
+void sc_sim_set_slave(sc_sim_handle *handle, sc_sim_slave_fn slave_fn,
+                      void *user, const sc_axi4_in_t *initial_in) {
+  if (handle == nullptr) {
+    return;
+  }
+  handle->sim.set_slave(slave_fn, user, initial_in);
+}
+
+int sc_sim_step_n(sc_sim_handle *handle, uint64_t n_cycles, uint32_t stop_mask,
+                  sc_sim_status_t *status_out) {
+  if (handle == nullptr || status_out == nullptr) {
+    return -1;
+  }
+  return handle->sim.step_n(n_cycles, stop_mask, *status_out);
+}
+
+int sc_sim_run_until(sc_sim_handle *handle, uint32_t stop_mask,
+                     sc_sim_status_t *status_out) {
+  return sc_sim_step_n(handle, std::numeric_limits<uint64_t>::max(), stop_mask,
+                       status_out);
+}
+
+int sc_sim_fast_forward(sc_sim_handle *handle, uint64_t max_inst,
+                        sc_sim_status_t *status_out) {
+  if (handle == nullptr || status_out == nullptr) {
+    return -1;
+  }
+  return handle->sim.fast_forward(max_inst, *status_out);
+}
+
 void sc_sim_get_status(const sc_sim_handle *handle,
                        sc_sim_status_t *status_out) {
   if (handle == nullptr || status_out == nullptr) {
@@ -977,6 +2850,67 @@ void sc_sim_get_status(const sc_sim_handle *handle,
   handle->sim.get_status(*status_out);
 }
 
+void sc_sim_get_tlb_stats(const sc_sim_handle *handle,
+                          sc_sim_tlb_stats_t *stats_out) {
+  if (handle == nullptr || stats_out == nullptr) {
+    return;
+  }
+  handle->sim.get_tlb_stats(*stats_out);
+}
+
+void sc_sim_get_dcache_stats(const sc_sim_handle *handle,
+                             sc_sim_dcache_stats_t *stats_out) {
+  if (handle == nullptr || stats_out == nullptr) {
+    return;
+  }
+  handle->sim.get_dcache_stats(*stats_out);
+}
+
+void sc_sim_get_perf(const sc_sim_handle *handle, sc_sim_perf_t *perf_out) {
+  if (handle == nullptr || perf_out == nullptr) {
+    return;
+  }
+  handle->sim.get_perf(*perf_out);
+}
+
+int sc_sim_write_perf_json(sc_sim_handle *handle, const char *path) {
+  if (handle == nullptr) {
+    return -1;
+  }
+  return handle->sim.write_perf_json(path);
+}
+
+int sc_sim_set_pc_profiling(sc_sim_handle *handle, uint32_t period) {
+  if (handle == nullptr) {
+    return -1;
+  }
+  return handle->sim.set_pc_profiling(period);
+}
+
+int sc_sim_write_pc_profile(sc_sim_handle *handle, const char *folded_path,
+                            const char *hot_spots_path, const char *elf_path,
+                            uint32_t top) {
+  if (handle == nullptr) {
+    return -1;
+  }
+  return handle->sim.write_pc_profile(folded_path, hot_spots_path, elf_path,
+                                      top);
+}
+
+uint64_t sc_sim_get_resident_memory(const sc_sim_handle *handle) {
+  if (handle == nullptr) {
+    return 0;
+  }
+  return handle->sim.resident_memory();
+}
+
+void sc_sim_set_bbv_profiling(sc_sim_handle *handle, int enable) {
+  if (handle == nullptr) {
+    return;
+  }
+  handle->sim.set_bbv_profiling(enable != 0);
+}
+
 const char *sc_sim_last_error(const sc_sim_handle *handle) {
   if (handle == nullptr) {
     return "handle is null";
@@ -985,3 +2919,19 @@ const char *sc_sim_last_error(const sc_sim_handle *handle) {
 }
 
 } // extern "C"
+
+PhysicalMemory *sc_sim_get_memory(sc_sim_handle *handle) {
+  if (handle == nullptr) {
+    return nullptr;
+  }
+  return handle->sim.memory();
+}
+
+void sc_sim_take_bbv(sc_sim_handle *handle,
+                     std::unordered_map<uint32_t, uint64_t> &bbv_out) {
+  bbv_out.clear();
+  if (handle == nullptr) {
+    return;
+  }
+  handle->sim.take_bbv(bbv_out);
+}
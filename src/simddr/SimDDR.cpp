@@ -3,17 +3,16 @@
  * @brief SimDDR Implementation - DDR Memory Simulator with AXI4 Interface
  *
  * Implementation with outstanding transaction support and read interleaving.
- * Uses vector + round-robin for fair interleaved data delivery.
+ * Reads live in fixed slots with a free list and an age-ordered list;
+ * round-robin over that list gives fair interleaved data delivery.
  */
 
 #include "SimDDR.h"
+#include "Checkpoint.h"
 #include <algorithm>
 #include <cstdio>
 #include <cstring>
-
-// Use the global p_memory from the simulator
-extern uint32_t *p_memory;
-extern long long sim_time;
+#include <vector>
 
 namespace sim_ddr {
 
@@ -26,13 +25,23 @@ void SimDDR::init() {
   w_current = {};
 
   // Clear queues
-  while (!w_resp_queue.empty())
-    w_resp_queue.pop();
-
-  // Clear read transactions
-  r_transactions.clear();
-  r_rr_index = 0;
+  w_resp_head = 0;
+  w_resp_count = 0;
+
+  // Clear read transactions: every slot on the free list
+  for (uint32_t i = 0; i < SIM_DDR_MAX_OUTSTANDING; i++) {
+    r_slots[i] = {};
+    r_prev[i] = -1;
+    r_next[i] = static_cast<int8_t>(i + 1 < SIM_DDR_MAX_OUTSTANDING ? i + 1 : -1);
+  }
+  r_head = -1;
+  r_tail = -1;
+  r_free = 0;
+  r_count = 0;
+  r_wait = -1;
+  r_rr_slot = -1;
   r_selected_idx = -1;
+  cycle = 0;
 
   // Initialize IO outputs
   io.aw.awready = false;
@@ -83,7 +92,7 @@ void SimDDR::comb_write_channel() {
   io.b.bresp = AXI_RESP_OKAY;
 
   // --- AW Channel: Accept new write address if no active transaction ---
-  if (!w_active) {
+  if (!w_active && w_resp_count < SIM_DDR_MAX_OUTSTANDING) {
     io.aw.awready = true;
   }
 
@@ -93,10 +102,9 @@ void SimDDR::comb_write_channel() {
   }
 
   // --- B Channel: Send response if latency complete ---
-  if (!w_resp_queue.empty()) {
-    WriteRespPending &front =
-        const_cast<WriteRespPending &>(w_resp_queue.front());
-    if (front.latency_cnt >= SIM_DDR_LATENCY) {
+  if (w_resp_count != 0) {
+    const WriteRespPending &front = w_resp_ring[w_resp_head];
+    if (cycle - front.issue_cycle >= latency) {
       io.b.bvalid = true;
       io.b.bid = front.id;
       io.b.bresp = AXI_RESP_OKAY;
@@ -108,22 +116,56 @@ void SimDDR::comb_write_channel() {
 // Find next ready transaction using round-robin (for interleaving)
 // ============================================================================
 int SimDDR::find_next_ready_transaction() {
-  if (r_transactions.empty())
+  // Only the slots before r_wait have finished their latency.
+  if (r_count == 0 || r_wait == r_head)
     return -1;
 
-  size_t count = r_transactions.size();
-
-  // Start from current rr_index and search for a ready transaction
-  for (size_t i = 0; i < count; i++) {
-    size_t idx = (r_rr_index + i) % count;
-    if (r_transactions[idx].in_data_phase && !r_transactions[idx].complete) {
-      return static_cast<int>(idx);
+  // Start from the round-robin cursor and walk in age order, wrapping
+  int idx = (r_rr_slot >= 0) ? r_rr_slot : r_head;
+  for (uint32_t i = 0; i < r_count; i++) {
+    if (r_slots[idx].in_data_phase && !r_slots[idx].complete) {
+      return idx;
     }
+    idx = (r_next[idx] >= 0) ? r_next[idx] : r_head;
   }
 
   return -1; // No ready transactions
 }
 
+int SimDDR::alloc_read_slot() {
+  const int slot = r_free;
+  r_free = r_next[slot];
+  r_prev[slot] = static_cast<int8_t>(r_tail);
+  r_next[slot] = -1;
+  if (r_tail >= 0) {
+    r_next[r_tail] = static_cast<int8_t>(slot);
+  } else {
+    r_head = slot;
+  }
+  r_tail = slot;
+  r_count++;
+  return slot;
+}
+
+void SimDDR::free_read_slot(int slot) {
+  const int prev = r_prev[slot];
+  const int next = r_next[slot];
+  if (prev >= 0) {
+    r_next[prev] = static_cast<int8_t>(next);
+  } else {
+    r_head = next;
+  }
+  if (next >= 0) {
+    r_prev[next] = static_cast<int8_t>(prev);
+  } else {
+    r_tail = prev;
+  }
+  r_next[slot] = static_cast<int8_t>(r_free);
+  r_prev[slot] = -1;
+  r_free = slot;
+  r_count--;
+}
+
 // ============================================================================
 // Combinational Logic - Read Channel with Interleaving
 // ============================================================================
@@ -140,7 +182,7 @@ void SimDDR::comb_read_channel() {
   r_selected_idx = -1;
 
   // --- AR Channel: Accept new read address if not full ---
-  if (r_transactions.size() < SIM_DDR_MAX_OUTSTANDING) {
+  if (r_count < SIM_DDR_MAX_OUTSTANDING) {
     io.ar.arready = true;
   }
 
@@ -148,7 +190,7 @@ void SimDDR::comb_read_channel() {
   r_selected_idx = find_next_ready_transaction();
 
   if (r_selected_idx >= 0) {
-    ReadTransaction &txn = r_transactions[r_selected_idx];
+    ReadTransaction &txn = r_slots[r_selected_idx];
     uint32_t current_addr = txn.addr + (txn.beat_cnt << txn.size);
 
     io.r.rvalid = true;
@@ -186,106 +228,107 @@ void SimDDR::seq() {
 
     if (io.w.wlast) {
       w_current.data_done = true;
-      WriteRespPending resp;
+      WriteRespPending &resp =
+          w_resp_ring[(w_resp_head + w_resp_count) % SIM_DDR_MAX_OUTSTANDING];
       resp.id = w_current.id;
-      resp.latency_cnt = 0;
-      w_resp_queue.push(resp);
+      resp.issue_cycle = cycle;
+      w_resp_count++;
       w_active = false;
     }
   }
 
   // B handshake: Complete response
   if (io.b.bvalid && io.b.bready) {
-    w_resp_queue.pop();
-  }
-
-  // Increment latency counters for pending responses
-  std::queue<WriteRespPending> temp_queue;
-  while (!w_resp_queue.empty()) {
-    WriteRespPending resp = w_resp_queue.front();
-    w_resp_queue.pop();
-    resp.latency_cnt++;
-    temp_queue.push(resp);
+    w_resp_head = (w_resp_head + 1) % SIM_DDR_MAX_OUTSTANDING;
+    w_resp_count--;
   }
-  w_resp_queue = temp_queue;
 
   // ========== Read Channel Sequential Logic ==========
 
   // AR handshake: Start new read transaction
   if (io.ar.arvalid && io.ar.arready) {
-    ReadTransaction txn;
+    const int slot = alloc_read_slot();
+    ReadTransaction &txn = r_slots[slot];
     txn.addr = io.ar.araddr;
     txn.id = io.ar.arid;
     txn.len = io.ar.arlen;
     txn.size = io.ar.arsize;
     txn.burst = io.ar.arburst;
     txn.beat_cnt = 0;
-    txn.latency_cnt = 0;
+    txn.issue_cycle = cycle;
     txn.in_data_phase = false;
     txn.complete = false;
-    r_transactions.push_back(txn);
+    if (r_wait < 0) {
+      r_wait = slot;
+    }
   }
 
   // R handshake: Advance data beat on selected transaction
   if (io.r.rvalid && io.r.rready && r_selected_idx >= 0) {
-    ReadTransaction &txn = r_transactions[r_selected_idx];
+    ReadTransaction &txn = r_slots[r_selected_idx];
     txn.beat_cnt++;
 
+    // Advance round-robin cursor for interleaving
+    r_rr_slot = r_next[r_selected_idx];
+
+    // Last beat accepted: the slot goes back on the free list
     if (io.r.rlast) {
       txn.complete = true;
+      free_read_slot(r_selected_idx);
     }
-
-    // Advance round-robin index for interleaving
-    r_rr_index =
-        (r_selected_idx + 1) % std::max((size_t)1, r_transactions.size());
   }
 
-  // Update all read transactions: increment latency, mark data phase
-  for (auto &txn : r_transactions) {
-    if (!txn.in_data_phase && !txn.complete) {
-      txn.latency_cnt++;
-      if (txn.latency_cnt >= SIM_DDR_LATENCY) {
-        txn.in_data_phase = true;
-      }
+  cycle++;
+
+  // Latency expiry: oldest waiting transaction first, stop at the first one
+  // still counting
+  while (r_wait >= 0) {
+    ReadTransaction &txn = r_slots[r_wait];
+    if (cycle - txn.issue_cycle < latency) {
+      break;
     }
+    txn.in_data_phase = true;
+    r_wait = r_next[r_wait];
   }
+}
 
-  // Remove completed transactions
-  r_transactions.erase(
-      std::remove_if(r_transactions.begin(), r_transactions.end(),
-                     [](const ReadTransaction &t) { return t.complete; }),
-      r_transactions.end());
-
-  // Adjust rr_index if vector size changed
-  if (!r_transactions.empty() && r_rr_index >= r_transactions.size()) {
-    r_rr_index = 0;
+// ============================================================================
+// Idle Skipping
+// ============================================================================
+uint64_t SimDDR::idle_cycles() const {
+  // Any transaction past its latency is sending data.
+  if (w_active || io.r.rvalid || io.b.bvalid || r_wait != r_head) {
+    return 0;
+  }
+  // A deadline already reached takes effect on the next seq().
+  auto until_expiry = [this](uint64_t issue_cycle) -> uint64_t {
+    const uint64_t age = cycle - issue_cycle;
+    return (age < latency) ? latency - age : 1;
+  };
+
+  uint64_t idle = UINT64_MAX;
+  if (w_resp_count != 0) {
+    // Only the head drives bvalid.
+    idle = until_expiry(w_resp_ring[w_resp_head].issue_cycle);
   }
+  if (r_wait >= 0) {
+    idle = std::min(idle, until_expiry(r_slots[r_wait].issue_cycle));
+  }
+  return idle;
 }
 
+void SimDDR::skip_cycles(uint64_t cycles) { cycle += cycles; }
+
 // ============================================================================
 // Helper Functions
 // ============================================================================
 
 void SimDDR::do_memory_write(uint32_t addr, uint32_t data, uint8_t wstrb) {
-  uint32_t word_addr = addr >> 2;
-
-  if (p_memory == nullptr) {
+  if (memory == nullptr) {
     return;
   }
 
-  uint32_t old_data = p_memory[word_addr];
-  uint32_t mask = 0;
-
-  if (wstrb & 0x1)
-    mask |= 0x000000FF;
-  if (wstrb & 0x2)
-    mask |= 0x0000FF00;
-  if (wstrb & 0x4)
-    mask |= 0x00FF0000;
-  if (wstrb & 0x8)
-    mask |= 0xFF000000;
-
-  p_memory[word_addr] = (data & mask) | (old_data & ~mask);
+  memory->write32(addr, data, wstrb);
 
   if (DCACHE_LOG) {
     printf("[SimDDR] Write: addr=0x%08x data=0x%08x wstrb=0x%x\n", addr, data,
@@ -294,13 +337,11 @@ void SimDDR::do_memory_write(uint32_t addr, uint32_t data, uint8_t wstrb) {
 }
 
 uint32_t SimDDR::do_memory_read(uint32_t addr) {
-  uint32_t word_addr = addr >> 2;
-
-  if (p_memory == nullptr) {
+  if (memory == nullptr) {
     return 0xDEADBEEF;
   }
 
-  uint32_t data = p_memory[word_addr];
+  uint32_t data = memory->read32(addr);
 
   if (DCACHE_LOG) {
     printf("[SimDDR] Read: addr=0x%08x -> 0x%08x\n", addr, data);
@@ -309,14 +350,117 @@ uint32_t SimDDR::do_memory_read(uint32_t addr) {
   return data;
 }
 
+// ============================================================================
+// Checkpoint
+// ============================================================================
+void SimDDR::save(CheckpointWriter &out) const {
+  out.put(io);
+  out.put(latency);
+  out.put(w_active);
+  out.put(w_current);
+  std::vector<WriteRespPending> resp_list;
+  for (uint32_t i = 0; i < w_resp_count; i++) {
+    resp_list.push_back(
+        w_resp_ring[(w_resp_head + i) % SIM_DDR_MAX_OUTSTANDING]);
+  }
+  out.put_vector(resp_list);
+  out.put(r_slots);
+  out.put(r_next);
+  out.put(r_prev);
+  out.put(r_head);
+  out.put(r_tail);
+  out.put(r_free);
+  out.put(r_count);
+  out.put(r_wait);
+  out.put(r_rr_slot);
+  out.put(r_selected_idx);
+  out.put(cycle);
+}
+
+bool SimDDR::load(CheckpointReader &in) {
+  std::vector<WriteRespPending> resp_list;
+  in.get(io);
+  in.get(latency);
+  in.get(w_active);
+  in.get(w_current);
+  in.get_vector(resp_list);
+  in.get(r_slots);
+  in.get(r_next);
+  in.get(r_prev);
+  in.get(r_head);
+  in.get(r_tail);
+  in.get(r_free);
+  in.get(r_count);
+  in.get(r_wait);
+  in.get(r_rr_slot);
+  in.get(r_selected_idx);
+  in.get(cycle);
+  if (!in.ok() || resp_list.size() > SIM_DDR_MAX_OUTSTANDING ||
+      r_count > SIM_DDR_MAX_OUTSTANDING || !read_slots_consistent()) {
+    return false;
+  }
+  w_resp_head = 0;
+  w_resp_count = static_cast<uint32_t>(resp_list.size());
+  std::copy(resp_list.begin(), resp_list.end(), w_resp_ring);
+  return in.ok();
+}
+
+bool SimDDR::read_slots_consistent() const {
+  constexpr int kSlots = static_cast<int>(SIM_DDR_MAX_OUTSTANDING);
+  auto in_range = [](int idx) { return idx >= -1 && idx < kSlots; };
+  if (!in_range(r_head) || !in_range(r_tail) || !in_range(r_free) ||
+      !in_range(r_wait) || !in_range(r_rr_slot) ||
+      !in_range(r_selected_idx)) {
+    return false;
+  }
+  for (int i = 0; i < kSlots; i++) {
+    if (!in_range(r_next[i]) || !in_range(r_prev[i])) {
+      return false;
+    }
+  }
+
+  // 占用链表：从 r_head 沿 r_next 走到 r_tail，反向链接一致，长度为 r_count
+  bool occupied[SIM_DDR_MAX_OUTSTANDING] = {};
+  uint32_t count = 0;
+  int prev = -1;
+  for (int idx = r_head; idx >= 0; idx = r_next[idx]) {
+    if (occupied[idx] || r_prev[idx] != prev) {
+      return false;
+    }
+    occupied[idx] = true;
+    count++;
+    prev = idx;
+  }
+  if (prev != r_tail || count != r_count) {
+    return false;
+  }
+
+  // 空闲链表覆盖其余全部槽位
+  bool seen[SIM_DDR_MAX_OUTSTANDING] = {};
+  uint32_t free_count = 0;
+  for (int idx = r_free; idx >= 0; idx = r_next[idx]) {
+    if (occupied[idx] || seen[idx]) {
+      return false;
+    }
+    seen[idx] = true;
+    free_count++;
+  }
+  if (count + free_count != SIM_DDR_MAX_OUTSTANDING) {
+    return false;
+  }
+
+  // 还在延迟中的事务不会被释放；轮询游标与本拍选中的槽位可能已回到空闲
+  // 链表，只要求在范围内
+  return r_wait < 0 || occupied[r_wait];
+}
+
 // ============================================================================
 // Debug
 // ============================================================================
 void SimDDR::print_state() {
-  printf("[SimDDR] Write: active=%d resp_pending=%zu\n", w_active,
-         w_resp_queue.size());
-  printf("[SimDDR] Read: txn_count=%zu rr_index=%zu\n", r_transactions.size(),
-         r_rr_index);
+  printf("[SimDDR] Write: active=%d resp_pending=%u\n", w_active,
+         w_resp_count);
+  printf("[SimDDR] Read: txn_count=%u rr_slot=%d\n", r_count, r_rr_slot);
 }
 
 } // namespace sim_ddr
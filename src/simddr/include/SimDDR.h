@@ -8,18 +8,20 @@
  *
  * Features:
  * - 5 AXI4 channels (AW, W, B, AR, R)
- * - Configurable memory latency
+ * - Configurable memory latency (absolute deadlines, no per-cycle counters)
  * - Outstanding transaction support (multiple in-flight transactions)
  * - Read data interleaving (can switch between transactions mid-burst)
  * - INCR burst mode support
- * - Uses external p_memory for storage (shared with main simulator)
+ * - Uses an external PhysicalMemory for storage (owned by the simulator)
  */
 
+#include "PhysicalMemory.h"
 #include "SimDDR_IO.h"
 #include <config.h>
 #include <cstdint>
-#include <queue>
-#include <vector>
+
+class CheckpointWriter;
+class CheckpointReader;
 
 namespace sim_ddr {
 
@@ -48,7 +50,7 @@ struct WriteTransaction {
 // Write response pending (in latency phase after W complete)
 struct WriteRespPending {
   uint8_t id;
-  uint32_t latency_cnt;
+  uint64_t issue_cycle; // seq() count when the last W beat was accepted
 };
 
 // Read transaction (after AR handshake, in latency or sending data)
@@ -59,7 +61,7 @@ struct ReadTransaction {
   uint8_t size;
   uint8_t burst;
   uint8_t beat_cnt; // Current beat sent
-  uint32_t latency_cnt;
+  uint64_t issue_cycle; // seq() count at the AR handshake
   bool in_data_phase; // True if latency done, sending data
   bool complete;      // True when all beats sent and rlast accepted
 };
@@ -72,6 +74,14 @@ public:
   // ========== Simulator Interface ==========
   void init();
 
+  // Backing store for reads/writes; must be set before the first access.
+  void set_memory(PhysicalMemory *mem) { memory = mem; }
+
+  // Read/write latency in cycles (default SIM_DDR_LATENCY). Takes effect at
+  // once, also for transactions still counting down.
+  void set_latency(uint32_t cycles) { latency = cycles; }
+  uint32_t get_latency() const { return latency; }
+
   // Two-phase combinational logic for proper signal timing
   void comb_outputs(); // Phase 1: arready, rvalid, rdata, bvalid, bresp
   void comb_inputs();  // Phase 2: Process arvalid, awvalid, wvalid
@@ -82,31 +92,67 @@ public:
 
   void seq();
 
+  // ========== Idle Skipping ==========
+  // Cycles until the next latency expiry, i.e. seq() calls after which an
+  // output may change. 0 while a burst or W data is moving, UINT64_MAX when
+  // nothing is in flight. Up to idle_cycles() - 1 cycles only count latency.
+  uint64_t idle_cycles() const;
+  // Same state as `cycles` idle seq() calls; cycles < idle_cycles().
+  void skip_cycles(uint64_t cycles);
+
   // ========== IO Ports ==========
   SimDDR_IO_t io;
 
   // ========== Debug ==========
   void print_state();
 
+  // ========== Checkpoint ==========
+  // IO, latency and every transaction in flight (not the backing memory).
+  void save(CheckpointWriter &out) const;
+  bool load(CheckpointReader &in);
+
 private:
+  PhysicalMemory *memory = nullptr;
+  uint32_t latency = SIM_DDR_LATENCY;
+
   // ========== Write Channel ==========
   // Active write transaction (receiving W data)
   bool w_active;
   WriteTransaction w_current;
 
-  // Pending write responses (in latency)
-  std::queue<WriteRespPending> w_resp_queue;
+  // Pending write responses, oldest first: a fixed ring, AW is held off
+  // while it is full
+  WriteRespPending w_resp_ring[SIM_DDR_MAX_OUTSTANDING];
+  uint32_t w_resp_head;
+  uint32_t w_resp_count;
 
   // ========== Read Channel with Interleaving ==========
-  // Vector allows access to any transaction for interleaving
-  std::vector<ReadTransaction> r_transactions;
-
-  // Round-robin index for fair interleaving
-  size_t r_rr_index;
-
-  // Currently selected transaction index for this cycle (-1 if none)
+  // Fixed transaction slots. Occupied slots are linked oldest first
+  // (r_next/r_prev from r_head to r_tail); free slots are chained through
+  // r_next from r_free. Nothing is allocated or shifted per transaction.
+  ReadTransaction r_slots[SIM_DDR_MAX_OUTSTANDING];
+  int8_t r_next[SIM_DDR_MAX_OUTSTANDING];
+  int8_t r_prev[SIM_DDR_MAX_OUTSTANDING];
+  int r_head;
+  int r_tail;
+  int r_free;
+  uint32_t r_count;
+
+  // Latency is the same for every transaction, so deadlines expire in issue
+  // order: r_wait is the oldest slot still in latency (-1 if none) and the
+  // only one checked each cycle.
+  int r_wait;
+
+  // Round-robin cursor for fair interleaving: slot to try first, in age
+  // order (-1: oldest)
+  int r_rr_slot;
+
+  // Currently selected slot for this cycle (-1 if none)
   int r_selected_idx;
 
+  // Completed seq() calls; transactions are ready at issue_cycle + latency
+  uint64_t cycle;
+
   // ========== Combinational Logic Functions ==========
   void comb_write_channel();
   void comb_read_channel();
@@ -117,6 +163,12 @@ private:
 
   // Find next ready transaction using round-robin
   int find_next_ready_transaction();
+
+  int alloc_read_slot();
+  void free_read_slot(int slot);
+  // Checkpoint sanity: every slot index is in range and the occupied and
+  // free lists partition the slots consistently with r_count.
+  bool read_slots_consistent() const;
 };
 
 } // namespace sim_ddr
@@ -0,0 +1,287 @@
+/**
+ * @file SimPoint.cpp
+ * @brief BBV profiling pass and sampled cycle-mode replay.
+ */
+
+#include "SimPoint.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+constexpr uint64_t kNoLimit = std::numeric_limits<uint64_t>::max();
+
+// Fast-forwards until inst_count reaches target. Returns like
+// sc_sim_fast_forward(); 0 means the target was reached.
+int fast_forward_to(sc_sim_handle *sim, uint64_t target,
+                    sc_sim_status_t &status, FILE *uart_out) {
+  int rc = 0;
+  while (rc == 0 && status.inst_count < target) {
+    const uint64_t before = status.inst_count;
+    rc = sc_sim_fast_forward(sim, target - status.inst_count, &status);
+    if (status.uart_valid && uart_out != nullptr) {
+      std::fputc(status.uart_ch, uart_out);
+    }
+    if (rc == 0 && status.inst_count == before && !status.uart_valid) {
+      break;
+    }
+  }
+  return rc;
+}
+
+// One SimPoint frequency-vector line. Block ids are 1-based and assigned in
+// first-seen order, so they are stable over the whole run.
+bool write_bbv_line(FILE *out,
+                    const std::unordered_map<uint32_t, uint64_t> &bbv,
+                    std::unordered_map<uint32_t, uint32_t> &ids) {
+  std::vector<std::pair<uint32_t, uint64_t>> line;
+  line.reserve(bbv.size());
+  for (const auto &[paddr, count] : bbv) {
+    if (count == 0) {
+      continue;
+    }
+    auto it = ids.find(paddr);
+    if (it == ids.end()) {
+      it = ids.emplace(paddr, static_cast<uint32_t>(ids.size() + 1)).first;
+    }
+    line.emplace_back(it->second, count);
+  }
+  std::sort(line.begin(), line.end());
+
+  std::fputc('T', out);
+  for (const auto &[id, count] : line) {
+    std::fprintf(out, ":%u:%llu ", id, static_cast<unsigned long long>(count));
+  }
+  return std::fputc('\n', out) != EOF;
+}
+
+// "<a> <b>" per line, as written by simpoint -saveSimpoints and
+// -saveSimpointWeights.
+template <typename A>
+bool read_pairs(const char *path, std::vector<std::pair<A, uint64_t>> &pairs,
+                std::string &error) {
+  std::ifstream in(path);
+  if (!in.is_open()) {
+    error = std::string("cannot open ") + path;
+    return false;
+  }
+  std::string text;
+  while (std::getline(in, text)) {
+    std::istringstream line(text);
+    A a{};
+    uint64_t b = 0;
+    if (!(line >> a)) {
+      continue; // blank line
+    }
+    if (!(line >> b)) {
+      error = std::string("malformed line in ") + path + ": " + text;
+      return false;
+    }
+    pairs.emplace_back(a, b);
+  }
+  return true;
+}
+
+// Warmup and measurement of one sample, on its own forked handle.
+void run_sample(sc_sim_handle *sim, uint64_t start, uint64_t interval,
+                SimPointSample &sample) {
+  sc_sim_status_t status{};
+  sc_sim_get_status(sim, &status);
+
+  if (status.inst_count < start) {
+    sc_sim_set_limits(sim, start, kNoLimit);
+    if (sc_sim_run_until(sim, 0, &status) < 0) {
+      sample.error = sc_sim_last_error(sim);
+      return;
+    }
+    if (status.inst_count < start) {
+      sample.error = "program ended during warmup";
+      return;
+    }
+  }
+
+  const sc_sim_status_t begin = status;
+  sc_sim_set_limits(sim, start + interval, kNoLimit);
+  if (sc_sim_run_until(sim, 0, &status) < 0) {
+    sample.error = sc_sim_last_error(sim);
+    return;
+  }
+  sample.inst = status.inst_count - begin.inst_count;
+  sample.cycles = status.sim_time - begin.sim_time;
+  if (sample.inst == 0) {
+    sample.error = "no instructions retired in interval";
+    return;
+  }
+  sample.ok = true;
+}
+
+} // namespace
+
+bool simpoint_profile(sc_sim_handle *sim, const SimPointConfig &cfg,
+                      const char *bbv_path, SimPointProfile &profile,
+                      std::string &error) {
+  if (cfg.interval == 0) {
+    error = "SimPoint interval must be non-zero";
+    return false;
+  }
+  FILE *out = std::fopen(bbv_path, "w");
+  if (out == nullptr) {
+    error = std::string("cannot open BBV file for writing: ") + bbv_path;
+    return false;
+  }
+
+  std::unordered_map<uint32_t, uint32_t> ids;
+  std::unordered_map<uint32_t, uint64_t> bbv;
+  sc_sim_status_t status{};
+  sc_sim_get_status(sim, &status);
+  sc_sim_set_bbv_profiling(sim, 1);
+
+  profile = SimPointProfile{};
+  bool ok = true;
+  int rc = 0;
+  while (rc == 0 && ok) {
+    const uint64_t before = status.inst_count;
+    rc = fast_forward_to(sim, before + cfg.interval, status, cfg.uart_out);
+    if (status.inst_count == before) {
+      break;
+    }
+    sc_sim_take_bbv(sim, bbv);
+    ok = write_bbv_line(out, bbv, ids);
+    profile.intervals++;
+  }
+  sc_sim_set_bbv_profiling(sim, 0);
+  profile.inst_count = status.inst_count;
+  profile.blocks = ids.size();
+
+  ok = (std::fclose(out) == 0) && ok;
+  if (!ok) {
+    error = std::string("failed to write BBV file: ") + bbv_path;
+    return false;
+  }
+  if (rc < 0) {
+    error = sc_sim_last_error(sim);
+    return false;
+  }
+  return true;
+}
+
+bool simpoint_replay(sc_sim_handle *sim, const SimPointConfig &cfg,
+                     const char *simpoints_path, const char *weights_path,
+                     SimPointResult &result, std::string &error) {
+  if (cfg.interval == 0) {
+    error = "SimPoint interval must be non-zero";
+    return false;
+  }
+  std::vector<std::pair<uint64_t, uint64_t>> points;  // interval, cluster
+  std::vector<std::pair<double, uint64_t>> weights;   // weight, cluster
+  if (!read_pairs(simpoints_path, points, error) ||
+      !read_pairs(weights_path, weights, error)) {
+    return false;
+  }
+  std::map<uint64_t, double> cluster_weight;
+  for (const auto &[weight, cluster] : weights) {
+    cluster_weight[cluster] = weight;
+  }
+
+  result = SimPointResult{};
+  for (const auto &[interval, cluster] : points) {
+    const auto it = cluster_weight.find(cluster);
+    if (it == cluster_weight.end()) {
+      error = "no weight for cluster " + std::to_string(cluster);
+      return false;
+    }
+    SimPointSample sample;
+    sample.interval = interval;
+    sample.weight = it->second;
+    result.samples.push_back(sample);
+  }
+  std::sort(result.samples.begin(), result.samples.end(),
+            [](const SimPointSample &a, const SimPointSample &b) {
+              return a.interval < b.interval;
+            });
+
+  // One functional pass forks every sample at the start of its warmup. The
+  // forks share memory copy-on-write with the base handle.
+  std::vector<sc_sim_handle *> forks(result.samples.size(), nullptr);
+  sc_sim_status_t status{};
+  sc_sim_get_status(sim, &status);
+  int rc = 0;
+  for (size_t i = 0; i < result.samples.size(); ++i) {
+    SimPointSample &sample = result.samples[i];
+    const uint64_t start = sample.interval * cfg.interval;
+    const uint64_t warm_start = start - std::min(start, cfg.warmup);
+    if (rc == 0) {
+      rc = fast_forward_to(sim, warm_start, status, nullptr);
+    }
+    if (status.inst_count != warm_start) {
+      sample.error = (rc < 0) ? sc_sim_last_error(sim)
+                              : "program ended before interval";
+      continue;
+    }
+    forks[i] = sc_sim_clone(sim);
+    if (forks[i] == nullptr) {
+      sample.error = "failed to fork simulator";
+      continue;
+    }
+    sample.warmup_inst = start - warm_start;
+    if (!cfg.checkpoint_prefix.empty()) {
+      const std::string path = cfg.checkpoint_prefix + "." +
+                               std::to_string(sample.interval) + ".ckpt";
+      if (sc_sim_save_checkpoint(forks[i], path.c_str()) != 0) {
+        sample.error = sc_sim_last_error(forks[i]);
+        sc_sim_destroy(forks[i]);
+        forks[i] = nullptr;
+      }
+    }
+  }
+
+  unsigned jobs = cfg.jobs != 0 ? cfg.jobs : std::thread::hardware_concurrency();
+  jobs = std::max(1u, std::min<unsigned>(
+                          jobs, static_cast<unsigned>(forks.size())));
+  std::atomic<size_t> next{0};
+  auto worker = [&] {
+    for (size_t i = next++; i < forks.size(); i = next++) {
+      if (forks[i] == nullptr) {
+        continue;
+      }
+      run_sample(forks[i], result.samples[i].interval * cfg.interval,
+                 cfg.interval, result.samples[i]);
+      sc_sim_destroy(forks[i]);
+      forks[i] = nullptr;
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < jobs; ++t) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  // Weighted mean of CPI (cycles per instruction is what adds up over
+  // intervals), renormalized over the samples that completed.
+  double cpi = 0.0;
+  for (const SimPointSample &sample : result.samples) {
+    if (sample.ok) {
+      cpi += sample.weight * static_cast<double>(sample.cycles) /
+             static_cast<double>(sample.inst);
+      result.weight_used += sample.weight;
+    }
+  }
+  if (result.weight_used <= 0.0) {
+    error = "no SimPoint sample completed";
+    return false;
+  }
+  cpi /= result.weight_used;
+  result.ipc = 1.0 / cpi;
+  return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+/**
+ * @file SimPoint.h
+ * @brief SimPoint-style sampled simulation on top of the cycle API.
+ *
+ * Two passes over the same image:
+ *
+ *   1. simpoint_profile(): fast-forwards the whole program and writes one
+ *      basic-block vector per interval in the SimPoint frequency-vector
+ *      format ("T:<id>:<count> :<id>:<count> ..."). Cluster it with
+ *      `simpoint -loadFVFile <bbv> -maxK <K> -saveSimpoints <sp>
+ *      -saveSimpointWeights <w>`.
+ *   2. simpoint_replay(): fast-forwards again, forks a handle (and optionally
+ *      saves a checkpoint) `warmup` instructions before every chosen interval,
+ *      runs warmup + interval in cycle mode on worker threads and combines the
+ *      per-interval CPI with the cluster weights into one IPC estimate.
+ */
+
+#include "sc_axi4_sim_api.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct SimPointConfig {
+  uint64_t interval = 0; // instructions per interval
+  uint64_t warmup = 0;   // cycle-mode instructions before each interval
+  unsigned jobs = 0;     // replay threads, 0: one per hardware thread
+  // Non-empty: each forked sample is also saved as <prefix>.<interval>.ckpt
+  // (a checkpoint at the start of its warmup) for later replays.
+  std::string checkpoint_prefix;
+  FILE *uart_out = nullptr; // UART bytes of the profiling pass, may be NULL
+};
+
+struct SimPointProfile {
+  uint64_t intervals = 0;
+  uint64_t inst_count = 0;
+  uint64_t blocks = 0; // distinct basic blocks seen
+};
+
+struct SimPointSample {
+  uint64_t interval = 0;
+  double weight = 0.0;
+  uint64_t warmup_inst = 0;
+  uint64_t inst = 0;   // measured instructions
+  uint64_t cycles = 0; // measured cycles
+  bool ok = false;
+  std::string error;
+};
+
+struct SimPointResult {
+  std::vector<SimPointSample> samples;
+  double ipc = 0.0;          // weighted estimate
+  double weight_used = 0.0;  // total weight of the samples that ran
+};
+
+// sim must have an image loaded and be at its first instruction.
+bool simpoint_profile(sc_sim_handle *sim, const SimPointConfig &cfg,
+                      const char *bbv_path, SimPointProfile &profile,
+                      std::string &error);
+
+bool simpoint_replay(sc_sim_handle *sim, const SimPointConfig &cfg,
+                     const char *simpoints_path, const char *weights_path,
+                     SimPointResult &result, std::string &error);
@@ -0,0 +1,279 @@
+/**
+ * @file AxiTrace.cpp
+ * @brief Binary AXI trace encoding, background block compression and
+ *        decoding.
+ */
+
+#include "AxiTrace.h"
+
+#include <cstring>
+#include <zlib.h>
+
+namespace axi_trace {
+
+const FieldInfo kFields[kFieldCount] = {
+    {"arvalid", 1, false}, {"arready", 1, false}, {"arid", 8, false},
+    {"araddr", 32, true},  {"arlen", 8, false},   {"arsize", 3, false},
+    {"awvalid", 1, false}, {"awready", 1, false}, {"awid", 8, false},
+    {"awaddr", 32, true},  {"awlen", 8, false},   {"awsize", 3, false},
+    {"wvalid", 1, false},  {"wready", 1, false},  {"wdata", 32, false},
+    {"wstrb", 4, false},   {"wlast", 1, false},   {"rvalid", 1, false},
+    {"rready", 1, false},  {"rid", 8, false},     {"rdata", 32, false},
+    {"rlast", 1, false},   {"bvalid", 1, false},  {"bready", 1, false},
+    {"bid", 8, false},     {"bresp", 2, false},
+};
+
+void capture(const sc_axi4_in_t &in, const sc_axi4_out_t &out, Sample &s) {
+  s.v[0] = out.arvalid;
+  s.v[1] = in.arready;
+  s.v[2] = out.arid;
+  s.v[3] = out.araddr;
+  s.v[4] = out.arlen;
+  s.v[5] = out.arsize;
+  s.v[6] = out.awvalid;
+  s.v[7] = in.awready;
+  s.v[8] = out.awid;
+  s.v[9] = out.awaddr;
+  s.v[10] = out.awlen;
+  s.v[11] = out.awsize;
+  s.v[12] = out.wvalid;
+  s.v[13] = in.wready;
+  s.v[14] = out.wdata;
+  s.v[15] = out.wstrb;
+  s.v[16] = out.wlast;
+  s.v[17] = in.rvalid;
+  s.v[18] = out.rready;
+  s.v[19] = in.rid;
+  s.v[20] = in.rdata;
+  s.v[21] = in.rlast;
+  s.v[22] = in.bvalid;
+  s.v[23] = out.bready;
+  s.v[24] = in.bid;
+  s.v[25] = in.bresp;
+}
+
+static inline uint64_t zigzag(uint32_t cur, uint32_t prev) {
+  const int64_t delta = static_cast<int64_t>(static_cast<int32_t>(cur - prev));
+  return (static_cast<uint64_t>(delta) << 1) ^
+         static_cast<uint64_t>(delta >> 63);
+}
+
+static inline uint32_t unzigzag(uint64_t value, uint32_t prev) {
+  const int64_t delta =
+      static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  return prev + static_cast<uint32_t>(delta);
+}
+
+// ---------------- Writer ----------------
+
+bool TraceWriter::open(const std::string &path, std::string &error) {
+  close();
+  file_ = std::fopen(path.c_str(), "wb");
+  if (file_ == nullptr) {
+    error = "cannot open AXI trace file: " + path;
+    return false;
+  }
+  AxiTraceHeader header{};
+  std::memcpy(header.magic, kTraceMagic, sizeof(header.magic));
+  header.version = kTraceVersion;
+  header.field_count = kFieldCount;
+  if (std::fwrite(&header, sizeof(header), 1, file_) != 1) {
+    error = "cannot write AXI trace header: " + path;
+    std::fclose(file_);
+    file_ = nullptr;
+    return false;
+  }
+
+  prev_ = Sample{};
+  has_record_ = false;
+  prev_cycle_ = 0;
+  last_cycle_ = 0;
+  records_ = 0;
+  block_.clear();
+  block_.reserve(kBlockBytes + 256);
+  stop_ = false;
+  io_error_ = false;
+  thread_ = std::thread(&TraceWriter::writer_main, this);
+  return true;
+}
+
+bool TraceWriter::close() {
+  if (file_ == nullptr) {
+    return true;
+  }
+  // Mark how long the last values held, so decoders see the full run.
+  if (has_record_ && last_cycle_ > prev_cycle_) {
+    emit(last_cycle_, 0, prev_);
+  }
+  submit_block();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+  const bool ok = (std::fclose(file_) == 0) && !io_error_;
+  file_ = nullptr;
+  return ok;
+}
+
+void TraceWriter::put_varint(uint64_t value) {
+  while (value >= 0x80) {
+    block_.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  block_.push_back(static_cast<uint8_t>(value));
+}
+
+void TraceWriter::emit(uint64_t cycle, uint32_t mask, const Sample &cur) {
+  put_varint(cycle - prev_cycle_);
+  put_varint(mask);
+  for (uint32_t m = mask; m != 0; m &= m - 1) {
+    const uint32_t i = static_cast<uint32_t>(__builtin_ctz(m));
+    put_varint(kFields[i].delta_coded ? zigzag(cur.v[i], prev_.v[i])
+                                      : cur.v[i]);
+  }
+  prev_ = cur;
+  prev_cycle_ = cycle;
+  records_++;
+  if (block_.size() >= kBlockBytes) {
+    submit_block();
+  }
+}
+
+void TraceWriter::submit_block() {
+  if (block_.empty()) {
+    return;
+  }
+  std::vector<uint8_t> full;
+  full.reserve(kBlockBytes + 256);
+  full.swap(block_);
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Bounded queue: a slow disk throttles the simulation instead of memory.
+  cv_.wait(lock, [&] { return queue_.size() < kMaxQueuedBlocks; });
+  queue_.push_back(std::move(full));
+  lock.unlock();
+  cv_.notify_all();
+}
+
+void TraceWriter::writer_main() {
+  std::vector<uint8_t> comp;
+  for (;;) {
+    std::vector<uint8_t> raw;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [&] { return stop_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return; // stop_ and drained
+      }
+      raw = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    cv_.notify_all();
+
+    uLongf comp_len = compressBound(static_cast<uLong>(raw.size()));
+    comp.resize(comp_len);
+    bool ok = compress2(comp.data(), &comp_len, raw.data(),
+                        static_cast<uLong>(raw.size()), Z_BEST_SPEED) == Z_OK;
+    const uint32_t sizes[2] = {static_cast<uint32_t>(raw.size()),
+                               static_cast<uint32_t>(comp_len)};
+    ok = ok && std::fwrite(sizes, sizeof(sizes), 1, file_) == 1 &&
+         std::fwrite(comp.data(), comp_len, 1, file_) == 1;
+    if (!ok) {
+      io_error_ = true;
+    }
+  }
+}
+
+// ---------------- Reader ----------------
+
+TraceReader::~TraceReader() {
+  if (file_ != nullptr) {
+    std::fclose(file_);
+  }
+}
+
+bool TraceReader::open(const std::string &path, std::string &error) {
+  file_ = std::fopen(path.c_str(), "rb");
+  if (file_ == nullptr) {
+    error = "cannot open AXI trace file: " + path;
+    return false;
+  }
+  AxiTraceHeader header{};
+  if (std::fread(&header, sizeof(header), 1, file_) != 1 ||
+      std::memcmp(header.magic, kTraceMagic, sizeof(header.magic)) != 0 ||
+      header.version != kTraceVersion || header.field_count != kFieldCount) {
+    error = "not a compatible AXI trace file: " + path;
+    return false;
+  }
+  return true;
+}
+
+bool TraceReader::load_block() {
+  uint32_t sizes[2] = {};
+  if (std::fread(sizes, sizeof(sizes), 1, file_) != 1) {
+    return false; // clean end of file
+  }
+  comp_.resize(sizes[1]);
+  block_.resize(sizes[0]);
+  uLongf raw_len = sizes[0];
+  if (std::fread(comp_.data(), comp_.size(), 1, file_) != 1 ||
+      uncompress(block_.data(), &raw_len, comp_.data(),
+                 static_cast<uLong>(comp_.size())) != Z_OK ||
+      raw_len != sizes[0]) {
+    error_ = "corrupt AXI trace block";
+    return false;
+  }
+  pos_ = 0;
+  return true;
+}
+
+bool TraceReader::get_varint(uint64_t &value) {
+  value = 0;
+  for (uint32_t shift = 0; shift < 64; shift += 7) {
+    if (pos_ >= block_.size()) {
+      error_ = "truncated AXI trace record";
+      return false;
+    }
+    const uint8_t byte = block_[pos_++];
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  error_ = "bad varint in AXI trace";
+  return false;
+}
+
+bool TraceReader::next(uint64_t &cycle, Sample &sample, uint32_t &mask) {
+  if (file_ == nullptr) {
+    return false;
+  }
+  if (pos_ >= block_.size() && !load_block()) {
+    return false;
+  }
+  uint64_t delta = 0;
+  uint64_t bits = 0;
+  if (!get_varint(delta) || !get_varint(bits)) {
+    return false;
+  }
+  for (uint64_t m = bits; m != 0; m &= m - 1) {
+    const uint32_t i = static_cast<uint32_t>(__builtin_ctzll(m));
+    uint64_t value = 0;
+    if (i >= kFieldCount || !get_varint(value)) {
+      if (error_.empty()) {
+        error_ = "bad field mask in AXI trace";
+      }
+      return false;
+    }
+    cur_.v[i] = kFields[i].delta_coded ? unzigzag(value, cur_.v[i])
+                                       : static_cast<uint32_t>(value);
+  }
+  cycle_ += delta;
+  cycle = cycle_;
+  sample = cur_;
+  mask = static_cast<uint32_t>(bits);
+  return true;
+}
+
+} // namespace axi_trace
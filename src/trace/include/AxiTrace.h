@@ -0,0 +1,149 @@
+#pragma once
+/**
+ * @file AxiTrace.h
+ * @brief Compact binary AXI4 port trace (writer + reader).
+ *
+ * A trace holds the 26 AXI signals of the CPU master port (same columns as
+ * the old per-cycle CSV). A record is written only on cycles where at least
+ * one signal differs from the previous cycle, so idle stretches cost nothing
+ * and the per-cycle view is recovered by holding values between records.
+ *
+ * File layout:
+ *
+ *   AxiTraceHeader
+ *   blocks   { uint32_t raw_bytes, uint32_t comp_bytes, zlib data } ...
+ *
+ * Records inside the (decompressed) block stream:
+ *
+ *   varint  cycle delta to the previous record
+ *   varint  mask of changed fields (bit i = field i)
+ *   varint  per changed field: zigzag delta for addresses, value otherwise
+ *
+ * The writer fills large blocks on the simulation thread and hands them to a
+ * background thread for compression and file I/O.
+ */
+
+#include "sc_axi4_sim_api.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace axi_trace {
+
+constexpr char kTraceMagic[8] = {'S', 'C', 'A', 'X', 'T', 'R', 'C', 'E'};
+constexpr uint32_t kTraceVersion = 1;
+constexpr uint32_t kFieldCount = 26;
+
+struct FieldInfo {
+  const char *name;
+  uint8_t width;     // bits, for VCD
+  bool delta_coded;  // addresses: zigzag delta instead of the raw value
+};
+
+extern const FieldInfo kFields[kFieldCount];
+
+struct AxiTraceHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t field_count;
+};
+
+// Field values of one cycle, in kFields order.
+struct Sample {
+  uint32_t v[kFieldCount];
+};
+
+void capture(const sc_axi4_in_t &in, const sc_axi4_out_t &out, Sample &s);
+
+class TraceWriter {
+public:
+  static constexpr size_t kBlockBytes = 1u << 20;
+  static constexpr size_t kMaxQueuedBlocks = 4;
+
+  TraceWriter() = default;
+  ~TraceWriter() { close(); }
+  TraceWriter(const TraceWriter &) = delete;
+  TraceWriter &operator=(const TraceWriter &) = delete;
+
+  bool open(const std::string &path, std::string &error);
+  // Flushes the last block and waits for the writer thread. Returns false if
+  // any write failed.
+  bool close();
+  bool is_open() const { return file_ != nullptr; }
+
+  void record(uint64_t cycle, const sc_axi4_in_t &in,
+              const sc_axi4_out_t &out) {
+    Sample cur;
+    capture(in, out, cur);
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < kFieldCount; ++i) {
+      mask |= static_cast<uint32_t>(cur.v[i] != prev_.v[i]) << i;
+    }
+    last_cycle_ = cycle;
+    if (mask == 0 && has_record_) {
+      return;
+    }
+    if (!has_record_) {
+      mask = (1u << kFieldCount) - 1; // the first record carries every field
+      has_record_ = true;
+    }
+    emit(cycle, mask, cur);
+  }
+
+  uint64_t records() const { return records_; }
+
+private:
+  void emit(uint64_t cycle, uint32_t mask, const Sample &cur);
+  void put_varint(uint64_t value);
+  void submit_block();
+  void writer_main();
+
+  FILE *file_ = nullptr;
+  Sample prev_{};
+  bool has_record_ = false;
+  uint64_t prev_cycle_ = 0;
+  uint64_t last_cycle_ = 0;
+  uint64_t records_ = 0;
+  std::vector<uint8_t> block_;
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::vector<uint8_t>> queue_;
+  bool stop_ = false;
+  bool io_error_ = false;
+};
+
+class TraceReader {
+public:
+  TraceReader() = default;
+  ~TraceReader();
+  TraceReader(const TraceReader &) = delete;
+  TraceReader &operator=(const TraceReader &) = delete;
+
+  bool open(const std::string &path, std::string &error);
+  // Next record: cycle and the full sample after applying its changes.
+  // Returns false at end of trace or on error (see error()).
+  bool next(uint64_t &cycle, Sample &sample, uint32_t &mask);
+  const std::string &error() const { return error_; }
+
+private:
+  bool load_block();
+  bool get_varint(uint64_t &value);
+
+  FILE *file_ = nullptr;
+  std::vector<uint8_t> block_;
+  std::vector<uint8_t> comp_;
+  size_t pos_ = 0;
+  Sample cur_{};
+  uint64_t cycle_ = 0;
+  std::string error_;
+};
+
+} // namespace axi_trace
@@ -0,0 +1,168 @@
+// Converts a binary AXI trace (AXI_TRACE=1 runs of single_cycle_axi4.out)
+// to the per-cycle CSV of earlier versions, a change-only CSV, or VCD.
+
+#include "AxiTrace.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+
+using axi_trace::kFieldCount;
+using axi_trace::kFields;
+using axi_trace::Sample;
+
+enum class Format { kCsv, kCsvChanges, kVcd };
+
+void print_usage(const char *argv0) {
+  std::cout << "Usage: " << argv0
+            << " [--csv | --changes | --vcd] <trace.axt> [output]\n"
+            << "  --csv      one row per cycle (default)\n"
+            << "  --changes  one row per cycle where a signal changed\n"
+            << "  --vcd      value change dump for waveform viewers\n";
+}
+
+void write_csv_header(FILE *out) {
+  std::fputs("cycle", out);
+  for (uint32_t i = 0; i < kFieldCount; ++i) {
+    std::fprintf(out, ",%s", kFields[i].name);
+  }
+  std::fputc('\n', out);
+}
+
+void write_csv_row(FILE *out, uint64_t cycle, const Sample &s) {
+  std::fprintf(out, "%llu", static_cast<unsigned long long>(cycle));
+  for (uint32_t i = 0; i < kFieldCount; ++i) {
+    std::fprintf(out, ",%u", s.v[i]);
+  }
+  std::fputc('\n', out);
+}
+
+void write_vcd_header(FILE *out) {
+  std::fputs("$timescale 1ns $end\n$scope module axi4 $end\n", out);
+  for (uint32_t i = 0; i < kFieldCount; ++i) {
+    std::fprintf(out, "$var wire %u %c %s $end\n", kFields[i].width,
+                 static_cast<char>('!' + i), kFields[i].name);
+  }
+  std::fputs("$upscope $end\n$enddefinitions $end\n", out);
+}
+
+void write_vcd_changes(FILE *out, uint64_t cycle, const Sample &s,
+                       uint32_t mask) {
+  std::fprintf(out, "#%llu\n", static_cast<unsigned long long>(cycle));
+  for (uint32_t m = mask; m != 0; m &= m - 1) {
+    const uint32_t i = static_cast<uint32_t>(__builtin_ctz(m));
+    const char id = static_cast<char>('!' + i);
+    if (kFields[i].width == 1) {
+      std::fprintf(out, "%u%c\n", s.v[i] & 1u, id);
+      continue;
+    }
+    char bits[33];
+    int n = 0;
+    for (int b = kFields[i].width - 1; b >= 0; --b) {
+      if (n != 0 || ((s.v[i] >> b) & 1u) || b == 0) {
+        bits[n++] = ((s.v[i] >> b) & 1u) ? '1' : '0';
+      }
+    }
+    bits[n] = '\0';
+    std::fprintf(out, "b%s %c\n", bits, id);
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Format format = Format::kCsv;
+  const char *in_path = nullptr;
+  const char *out_path = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--csv") == 0) {
+      format = Format::kCsv;
+    } else if (std::strcmp(argv[i], "--changes") == 0) {
+      format = Format::kCsvChanges;
+    } else if (std::strcmp(argv[i], "--vcd") == 0) {
+      format = Format::kVcd;
+    } else if (std::strcmp(argv[i], "-h") == 0 ||
+               std::strcmp(argv[i], "--help") == 0) {
+      print_usage(argv[0]);
+      return 0;
+    } else if (in_path == nullptr) {
+      in_path = argv[i];
+    } else if (out_path == nullptr) {
+      out_path = argv[i];
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if (in_path == nullptr) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  axi_trace::TraceReader reader;
+  std::string error;
+  if (!reader.open(in_path, error)) {
+    std::cerr << "Error: " << error << std::endl;
+    return 1;
+  }
+  FILE *out = (out_path != nullptr) ? std::fopen(out_path, "w") : stdout;
+  if (out == nullptr) {
+    std::cerr << "Error: cannot open output file: " << out_path << std::endl;
+    return 1;
+  }
+  static char out_buffer[1 << 20];
+  std::setvbuf(out, out_buffer, _IOFBF, sizeof(out_buffer));
+
+  if (format == Format::kVcd) {
+    write_vcd_header(out);
+  } else {
+    write_csv_header(out);
+  }
+
+  uint64_t cycle = 0;
+  uint32_t mask = 0;
+  Sample sample{};
+  Sample held{};
+  uint64_t held_cycle = 0;
+  bool first = true;
+  while (reader.next(cycle, sample, mask)) {
+    switch (format) {
+    case Format::kCsv:
+      // Signals hold their values between records.
+      for (uint64_t c = held_cycle + 1; !first && c < cycle; ++c) {
+        write_csv_row(out, c, held);
+      }
+      write_csv_row(out, cycle, sample);
+      break;
+    case Format::kCsvChanges:
+      if (mask != 0) {
+        write_csv_row(out, cycle, sample);
+      }
+      break;
+    case Format::kVcd:
+      write_vcd_changes(out, cycle, sample, mask);
+      break;
+    }
+    held = sample;
+    held_cycle = cycle;
+    first = false;
+  }
+
+  const bool write_ok = (std::fflush(out) == 0);
+  if (out != stdout) {
+    std::fclose(out);
+  }
+  if (!reader.error().empty()) {
+    std::cerr << "Error: " << reader.error() << std::endl;
+    return 1;
+  }
+  if (!write_ok) {
+    std::cerr << "Error: failed to write output" << std::endl;
+    return 1;
+  }
+  return 0;
+}
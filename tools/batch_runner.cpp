@@ -0,0 +1,346 @@
+// Runs many (image, limits, DDR latency) jobs in one process on a pool of
+// worker threads and prints one JSON report. Each worker owns a single
+// simulator handle and reloads it per job; handles share nothing, so the
+// pool scales with the core count. Workers take the next unstarted job from
+// a shared counter, so a long job never holds back short ones queued behind
+// it.
+//
+// Manifest: one job per line, '#' starts a comment, '-' keeps a default:
+//
+//   <image> [max_inst] [max_cycles] [ddr_latency]
+
+#include "config.h"
+#include "sc_axi4_sim_api.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Job {
+  std::string image;
+  uint64_t max_inst = 0;
+  uint64_t max_cycles = 0;
+  uint32_t latency = 0;
+};
+
+struct JobResult {
+  bool pass = false;
+  std::string reason;
+  uint64_t inst = 0;
+  uint64_t cycles = 0;
+  double seconds = 0.0;
+  uint64_t uart_bytes = 0;
+  uint32_t uart_hash = 2166136261u; // FNV-1a of the UART output
+};
+
+struct Options {
+  unsigned jobs = 0; // 0: one per hardware thread
+  bool tlm = false;
+  bool uart = false; // echo each job's UART output to stderr
+  uint64_t max_inst = MAX_COMMIT_INST;
+  uint64_t max_cycles = 12000000000ULL;
+  uint32_t latency = ICACHE_MISS_LATENCY;
+  const char *manifest = nullptr;
+  const char *out_path = nullptr;
+};
+
+bool parse_u64(const char *str, uint64_t &value) {
+  if (str == nullptr || *str == '\0') {
+    return false;
+  }
+  char *end = nullptr;
+  value = std::strtoull(str, &end, 0);
+  return end != nullptr && *end == '\0';
+}
+
+void print_usage(const char *argv0) {
+  std::cout << "Usage: " << argv0 << " [options] <manifest>\n"
+            << "  manifest lines: <image> [max_inst] [max_cycles] "
+               "[ddr_latency] ('-' keeps the default)\n"
+            << "  --jobs <N>        Worker threads (default: all cores)\n"
+            << "  --max-inst <N>    Default instruction limit\n"
+            << "  --max-cycles <N>  Default cycle limit\n"
+            << "  --latency <N>     Default SimDDR latency\n"
+            << "  --tlm             Transaction-level timing for all jobs\n"
+            << "  --uart            Copy guest UART output to stderr\n"
+            << "  --out <file>      Write the JSON report to a file "
+               "(default stdout)\n";
+}
+
+bool parse_field(const std::string &token, uint64_t &value, uint64_t max) {
+  if (token == "-") {
+    return true;
+  }
+  uint64_t parsed = 0;
+  if (!parse_u64(token.c_str(), parsed) || parsed > max) {
+    return false;
+  }
+  value = parsed;
+  return true;
+}
+
+bool read_manifest(const Options &opt, std::vector<Job> &jobs,
+                   std::string &error) {
+  std::ifstream in(opt.manifest);
+  if (!in.is_open()) {
+    error = std::string("cannot open manifest: ") + opt.manifest;
+    return false;
+  }
+  std::string line;
+  for (uint64_t line_no = 1; std::getline(in, line); ++line_no) {
+    const size_t hash = line.find('#');
+    if (hash != std::string::npos) {
+      line.resize(hash);
+    }
+    std::istringstream fields(line);
+    std::string token;
+    if (!(fields >> token)) {
+      continue;
+    }
+    Job job;
+    job.image = token;
+    job.max_inst = opt.max_inst;
+    job.max_cycles = opt.max_cycles;
+    uint64_t latency = opt.latency;
+    bool ok = true;
+    if (fields >> token) {
+      ok = ok && parse_field(token, job.max_inst, UINT64_MAX);
+    }
+    if (fields >> token) {
+      ok = ok && parse_field(token, job.max_cycles, UINT64_MAX);
+    }
+    if (fields >> token) {
+      ok = ok && parse_field(token, latency, UINT32_MAX);
+    }
+    if (!ok || (fields >> token)) {
+      error = std::string(opt.manifest) + ":" + std::to_string(line_no) +
+              ": bad job line";
+      return false;
+    }
+    job.latency = static_cast<uint32_t>(latency);
+    jobs.push_back(job);
+  }
+  return true;
+}
+
+void run_job(sc_sim_handle *sim, const Options &opt, const Job &job,
+             JobResult &result) {
+  const auto begin = std::chrono::steady_clock::now();
+  sc_sim_set_limits(sim, job.max_inst, job.max_cycles);
+  sc_sim_set_ddr_latency(sim, job.latency);
+  if (sc_sim_load_image(sim, job.image.c_str(), nullptr) != 0) {
+    result.reason = sc_sim_last_error(sim);
+    return;
+  }
+  std::string uart;
+  sc_sim_status_t status{};
+  int rc = 0;
+  while (rc == 0) {
+    rc = sc_sim_run_until(sim, SC_SIM_STOP_UART, &status);
+    if (status.uart_valid) {
+      result.uart_bytes++;
+      result.uart_hash = (result.uart_hash ^ status.uart_ch) * 16777619u;
+      if (opt.uart) {
+        uart.push_back(static_cast<char>(status.uart_ch));
+      }
+    }
+  }
+  result.seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - begin)
+                       .count();
+  result.inst = status.inst_count;
+  result.cycles = status.sim_time;
+  result.pass = rc > 0 && status.success;
+  if (result.pass) {
+    result.reason = status.inst_count >= job.max_inst ? "max_inst" : "ebreak";
+  } else {
+    result.reason = sc_sim_last_error(sim);
+  }
+  if (opt.uart) {
+    // 一次写出整段输出，避免多个任务的字符交错
+    std::fprintf(stderr, "[batch] %s\n%s\n", job.image.c_str(), uart.c_str());
+  }
+}
+
+void write_json_string(FILE *out, const std::string &s) {
+  std::fputc('"', out);
+  for (const char c : s) {
+    if (c == '"' || c == '\\') {
+      std::fprintf(out, "\\%c", c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      std::fprintf(out, "\\u%04x", static_cast<unsigned>(c));
+    } else {
+      std::fputc(c, out);
+    }
+  }
+  std::fputc('"', out);
+}
+
+double ratio(double num, double den) { return den > 0 ? num / den : 0.0; }
+
+void write_report(FILE *out, const std::vector<Job> &jobs,
+                  const std::vector<JobResult> &results, unsigned workers,
+                  double wall_seconds) {
+  uint64_t passed = 0;
+  uint64_t total_inst = 0;
+  double busy_seconds = 0.0;
+  std::fputs("{\n  \"jobs\": [\n", out);
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    const Job &job = jobs[i];
+    const JobResult &r = results[i];
+    passed += r.pass ? 1 : 0;
+    total_inst += r.inst;
+    busy_seconds += r.seconds;
+    std::fputs("    {\"image\": ", out);
+    write_json_string(out, job.image);
+    std::fprintf(out,
+                 ", \"max_inst\": %llu, \"max_cycles\": %llu, "
+                 "\"latency\": %u,\n     \"status\": \"%s\", \"reason\": ",
+                 static_cast<unsigned long long>(job.max_inst),
+                 static_cast<unsigned long long>(job.max_cycles), job.latency,
+                 r.pass ? "pass" : "fail");
+    write_json_string(out, r.reason);
+    std::fprintf(out,
+                 ", \"inst\": %llu, \"cycles\": %llu, \"ipc\": %.6f,\n"
+                 "     \"host_seconds\": %.6f, \"mips\": %.3f, "
+                 "\"uart_bytes\": %llu, \"uart_fnv1a\": \"%08x\"}%s\n",
+                 static_cast<unsigned long long>(r.inst),
+                 static_cast<unsigned long long>(r.cycles),
+                 ratio(static_cast<double>(r.inst),
+                       static_cast<double>(r.cycles)),
+                 r.seconds, ratio(static_cast<double>(r.inst), r.seconds) / 1e6,
+                 static_cast<unsigned long long>(r.uart_bytes), r.uart_hash,
+                 i + 1 < jobs.size() ? "," : "");
+  }
+  std::fprintf(out,
+               "  ],\n  \"summary\": {\"jobs\": %zu, \"passed\": %llu, "
+               "\"failed\": %llu, \"workers\": %u,\n"
+               "    \"wall_seconds\": %.6f, \"busy_seconds\": %.6f, "
+               "\"inst\": %llu, \"aggregate_mips\": %.3f}\n}\n",
+               jobs.size(), static_cast<unsigned long long>(passed),
+               static_cast<unsigned long long>(jobs.size() - passed), workers,
+               wall_seconds, busy_seconds,
+               static_cast<unsigned long long>(total_inst),
+               ratio(static_cast<double>(total_inst), wall_seconds) / 1e6);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  uint64_t value = 0;
+  for (int i = 1; i < argc; ++i) {
+    const bool has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--tlm") == 0) {
+      opt.tlm = true;
+    } else if (std::strcmp(argv[i], "--uart") == 0) {
+      opt.uart = true;
+    } else if (std::strcmp(argv[i], "--jobs") == 0 && has_value &&
+               parse_u64(argv[i + 1], value) && value <= 4096) {
+      opt.jobs = static_cast<unsigned>(value);
+      ++i;
+    } else if (std::strcmp(argv[i], "--max-inst") == 0 && has_value &&
+               parse_u64(argv[i + 1], opt.max_inst)) {
+      ++i;
+    } else if (std::strcmp(argv[i], "--max-cycles") == 0 && has_value &&
+               parse_u64(argv[i + 1], opt.max_cycles)) {
+      ++i;
+    } else if (std::strcmp(argv[i], "--latency") == 0 && has_value &&
+               parse_u64(argv[i + 1], value) && value <= UINT32_MAX) {
+      opt.latency = static_cast<uint32_t>(value);
+      ++i;
+    } else if (std::strcmp(argv[i], "--out") == 0 && has_value) {
+      opt.out_path = argv[++i];
+    } else if (std::strcmp(argv[i], "-h") == 0 ||
+               std::strcmp(argv[i], "--help") == 0) {
+      print_usage(argv[0]);
+      return 0;
+    } else if (opt.manifest == nullptr && argv[i][0] != '-') {
+      opt.manifest = argv[i];
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if (opt.manifest == nullptr) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<Job> jobs;
+  std::string error;
+  if (!read_manifest(opt, jobs, error)) {
+    std::cerr << "Error: " << error << std::endl;
+    return 1;
+  }
+  FILE *out = (opt.out_path != nullptr) ? std::fopen(opt.out_path, "w")
+                                        : stdout;
+  if (out == nullptr) {
+    std::cerr << "Error: cannot open output file: " << opt.out_path
+              << std::endl;
+    return 1;
+  }
+
+  unsigned workers =
+      opt.jobs != 0 ? opt.jobs : std::thread::hardware_concurrency();
+  workers = std::max(1u, std::min<unsigned>(
+                             workers, static_cast<unsigned>(jobs.size())));
+  std::vector<JobResult> results(jobs.size());
+  std::atomic<size_t> next{0};
+  std::atomic<bool> setup_failed{false};
+  const auto begin = std::chrono::steady_clock::now();
+  auto worker = [&] {
+    sc_sim_handle *sim = sc_sim_create();
+    if (sim == nullptr ||
+        (opt.tlm && sc_sim_set_timing_mode(sim, SC_SIM_TIMING_TLM) != 0)) {
+      setup_failed = true;
+      sc_sim_destroy(sim);
+      return;
+    }
+    for (size_t i = next++; i < jobs.size(); i = next++) {
+      run_job(sim, opt, jobs[i], results[i]);
+    }
+    sc_sim_destroy(sim);
+  };
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < workers; ++t) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread &t : threads) {
+    t.join();
+  }
+  const double wall_seconds = std::chrono::duration<double>(
+                                  std::chrono::steady_clock::now() - begin)
+                                  .count();
+  if (setup_failed) {
+    std::cerr << "Error: failed to create simulator handles" << std::endl;
+    return 1;
+  }
+
+  write_report(out, jobs, results, workers, wall_seconds);
+  const bool write_ok = (std::fflush(out) == 0);
+  if (out != stdout) {
+    std::fclose(out);
+  }
+  if (!write_ok) {
+    std::cerr << "Error: failed to write report" << std::endl;
+    return 1;
+  }
+  const bool all_pass =
+      std::all_of(results.begin(), results.end(),
+                  [](const JobResult &r) { return r.pass; });
+  return all_pass ? 0 : 2;
+}
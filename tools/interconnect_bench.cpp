@@ -0,0 +1,219 @@
+// Microbenchmark: per-cycle host cost of AXI_Interconnect + SimDDR under
+// synthetic traffic. Every read master keeps up to --depth cache-line reads
+// in flight (one per ID) and the write port up to --depth word stores, so
+// ARs, interleaved R bursts, AW/W/B and the response paths are all busy every
+// cycle. The master side is a few assignments, so the time is the
+// interconnect and the DDR model; the read/write counts show the bandwidth
+// gained from deeper outstanding queues.
+
+#include "AXI_Interconnect.h"
+#include "PhysicalMemory.h"
+#include "SimDDR.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+using axi_interconnect::AXI_Interconnect;
+using axi_interconnect::NUM_READ_MASTERS;
+
+bool parse_u64(const char *str, uint64_t &value) {
+  if (str == nullptr || *str == '\0') {
+    return false;
+  }
+  char *end = nullptr;
+  value = std::strtoull(str, &end, 0);
+  return end != nullptr && *end == '\0';
+}
+
+void print_usage(const char *argv0) {
+  std::cout << "Usage: " << argv0
+            << " [--cycles N] [--latency N] [--depth N] [--reorder]\n";
+}
+
+// Master-driven AXI signals: interconnect -> SimDDR.
+void drive_ddr(const sim_ddr::SimDDR_IO_t &bus, sim_ddr::SimDDR_IO_t &ddr) {
+  ddr.ar.arvalid = bus.ar.arvalid;
+  ddr.ar.arid = bus.ar.arid;
+  ddr.ar.araddr = bus.ar.araddr;
+  ddr.ar.arlen = bus.ar.arlen;
+  ddr.ar.arsize = bus.ar.arsize;
+  ddr.ar.arburst = bus.ar.arburst;
+  ddr.aw.awvalid = bus.aw.awvalid;
+  ddr.aw.awid = bus.aw.awid;
+  ddr.aw.awaddr = bus.aw.awaddr;
+  ddr.aw.awlen = bus.aw.awlen;
+  ddr.aw.awsize = bus.aw.awsize;
+  ddr.aw.awburst = bus.aw.awburst;
+  ddr.w.wvalid = bus.w.wvalid;
+  ddr.w.wdata = bus.w.wdata;
+  ddr.w.wstrb = bus.w.wstrb;
+  ddr.w.wlast = bus.w.wlast;
+  ddr.r.rready = bus.r.rready;
+  ddr.b.bready = bus.b.bready;
+}
+
+// Slave-driven AXI signals: SimDDR -> interconnect.
+void sample_ddr(const sim_ddr::SimDDR_IO_t &ddr, sim_ddr::SimDDR_IO_t &bus) {
+  bus.ar.arready = ddr.ar.arready;
+  bus.aw.awready = ddr.aw.awready;
+  bus.w.wready = ddr.w.wready;
+  bus.r.rvalid = ddr.r.rvalid;
+  bus.r.rid = ddr.r.rid;
+  bus.r.rdata = ddr.r.rdata;
+  bus.r.rresp = ddr.r.rresp;
+  bus.r.rlast = ddr.r.rlast;
+  bus.b.bvalid = ddr.b.bvalid;
+  bus.b.bid = ddr.b.bid;
+  bus.b.bresp = ddr.b.bresp;
+}
+
+struct MasterState {
+  uint32_t busy_ids = 0;    // read masters: IDs in flight, bit per ID
+  uint32_t outstanding = 0; // write master
+  uint32_t addr = 0;
+  uint64_t done = 0;
+};
+
+// First free ID if another read may be issued, -1 otherwise.
+int next_read_id(const MasterState &m, uint64_t depth) {
+  if (static_cast<uint64_t>(__builtin_popcount(m.busy_ids)) >= depth) {
+    return -1;
+  }
+  for (int id = 0; id < axi_interconnect::READ_IDS_PER_MASTER; ++id) {
+    if ((m.busy_ids & (1u << id)) == 0) {
+      return id;
+    }
+  }
+  return -1;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  uint64_t cycles = 20000000ULL;
+  uint64_t latency = sim_ddr::SIM_DDR_LATENCY;
+  uint64_t depth = 1;
+  bool reorder = false;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--reorder") == 0) {
+      reorder = true;
+      continue;
+    }
+    if (std::strcmp(argv[i], "--depth") == 0 && i + 1 < argc &&
+        parse_u64(argv[i + 1], depth) && depth != 0) {
+      ++i;
+      continue;
+    }
+    if (std::strcmp(argv[i], "--cycles") == 0 && i + 1 < argc &&
+        parse_u64(argv[i + 1], cycles)) {
+      ++i;
+      continue;
+    }
+    if (std::strcmp(argv[i], "--latency") == 0 && i + 1 < argc &&
+        parse_u64(argv[i + 1], latency)) {
+      ++i;
+      continue;
+    }
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  PhysicalMemory memory;
+  sim_ddr::SimDDR ddr;
+  ddr.set_memory(&memory);
+  ddr.init();
+  ddr.set_latency(static_cast<uint32_t>(latency));
+  ddr.comb_outputs();
+
+  AXI_Interconnect ic;
+  ic.init();
+  ic.set_read_depth(static_cast<uint8_t>(depth));
+  ic.set_write_depth(static_cast<uint8_t>(depth));
+  ic.set_read_reorder(reorder);
+
+  MasterState rd[NUM_READ_MASTERS];
+  for (int i = 0; i < NUM_READ_MASTERS; ++i) {
+    rd[i].addr = 0x80000000u + static_cast<uint32_t>(i) * 0x100000u;
+  }
+  MasterState wr;
+  wr.addr = 0x80800000u;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (uint64_t c = 0; c < cycles; ++c) {
+    sample_ddr(ddr.io, ic.axi_io);
+    ic.comb_outputs();
+
+    bool rd_ready[NUM_READ_MASTERS];
+    bool rd_resp[NUM_READ_MASTERS];
+    int rd_id[NUM_READ_MASTERS];
+    int rd_resp_id[NUM_READ_MASTERS];
+    for (int i = 0; i < NUM_READ_MASTERS; ++i) {
+      auto &port = ic.read_ports[i];
+      rd_ready[i] = port.req.ready;
+      rd_resp[i] = port.resp.valid;
+      rd_resp_id[i] = port.resp.id;
+      rd_id[i] = next_read_id(rd[i], depth);
+      port.resp.ready = true;
+      port.req.valid = rd_id[i] >= 0;
+      port.req.addr = rd[i].addr;
+      port.req.total_size = 31;
+      port.req.id = static_cast<uint8_t>(rd_id[i] >= 0 ? rd_id[i] : 0);
+    }
+    auto &wport = ic.write_port;
+    const bool wr_ready = wport.req.ready;
+    const bool wr_resp = wport.resp.valid;
+    const bool wr_valid = wr.outstanding < depth;
+    wport.resp.ready = true;
+    wport.req.valid = wr_valid;
+    wport.req.addr = wr.addr;
+    wport.req.wdata[0] = static_cast<uint32_t>(c);
+    wport.req.wstrb = 0xF;
+    wport.req.total_size = 3;
+    wport.req.id = 0;
+
+    ic.comb_inputs();
+    drive_ddr(ic.axi_io, ddr.io);
+    ic.seq();
+    ddr.seq();
+    ddr.comb_outputs();
+
+    for (int i = 0; i < NUM_READ_MASTERS; ++i) {
+      if (rd_resp[i]) {
+        rd[i].busy_ids &= ~(1u << rd_resp_id[i]);
+        rd[i].done++;
+      }
+      if (rd_id[i] >= 0 && rd_ready[i]) {
+        rd[i].busy_ids |= 1u << rd_id[i];
+        rd[i].addr += 32;
+      }
+    }
+    if (wr_resp) {
+      wr.outstanding--;
+      wr.done++;
+    }
+    if (wr_valid && wr_ready) {
+      wr.outstanding++;
+      wr.addr += 4;
+    }
+  }
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  uint64_t reads = 0;
+  for (const MasterState &m : rd) {
+    reads += m.done;
+  }
+  std::cout << "cycles=" << cycles << " latency=" << latency
+            << " depth=" << depth << (reorder ? " reorder" : "")
+            << " reads=" << reads << " writes=" << wr.done << "\n"
+            << "ns_per_cycle=" << seconds * 1e9 / static_cast<double>(cycles)
+            << " mcycles_per_s="
+            << static_cast<double>(cycles) / seconds / 1e6 << std::endl;
+  return (reads != 0 && wr.done != 0) ? 0 : 1;
+}
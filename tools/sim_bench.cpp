@@ -0,0 +1,906 @@
+// Host-side simulation speed benchmark. Every workload (the bundled
+// Dhrystone/CoreMark images plus generated kernels) runs once per layer:
+//
+//   exec   SingleCycleCpu::exec() alone, memory accessed directly
+//   fast   sc_sim_fast_forward() (pre-decoded blocks, no AXI)
+//   tlm    sc_sim_run_until() in TLM timing
+//   cycle  sc_sim_run_until() in cycle timing with the built-in SimDDR
+//   step   one sc_sim_step() per cycle driving an external SimDDR
+//
+// and the bus models run alone under synthetic traffic:
+//
+//   axi/interconnect  AXI_Interconnect with an ideal zero-latency slave
+//   axi/simddr        SimDDR driven directly by one read and one write master
+//
+// Results go to stdout as a table and, with --json, as one JSON object per
+// row so old reports can serve as --baseline for regression checks.
+
+#include "AXI_Interconnect.h"
+#include "PhysicalMemory.h"
+#include "RISCV.h"
+#include "SimDDR.h"
+#include "sc_axi4_sim_api.h"
+#include "single_cycle_cpu.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t kBase = 0x80000000u;
+
+bool parse_u64(const char *str, uint64_t &value) {
+  if (str == nullptr || *str == '\0') {
+    return false;
+  }
+  char *end = nullptr;
+  value = std::strtoull(str, &end, 0);
+  return end != nullptr && *end == '\0';
+}
+
+void print_usage(const char *argv0) {
+  std::cout << "Usage: " << argv0 << " [options]\n"
+            << "  --inst <N>        Instructions per CPU row (default 1000000)\n"
+            << "  --cycles <N>      Cycles per bus-model row (default 2000000)\n"
+            << "  --repeat <N>      Keep the fastest of N runs (default 1)\n"
+            << "  --only <text>     Run rows whose workload/layer contains "
+               "text\n"
+            << "  --json <file>     Write the results as JSON (- for stdout)\n"
+            << "  --baseline <file> Compare against an earlier --json report\n"
+            << "  --tolerance <P>   Allowed slowdown in percent (default 10)\n";
+}
+
+// ---------------- Kernel generation ----------------
+
+enum Reg : uint32_t {
+  zero = 0, t0 = 5, t1 = 6, t2 = 7, s0 = 8, a0 = 10, a1 = 11, a2 = 12,
+  a3 = 13, a4 = 14, a5 = 15, a6 = 16, a7 = 17, t3 = 28, t4 = 29, t5 = 30,
+  t6 = 31,
+};
+
+uint32_t r_type(uint32_t f7, uint32_t rs2, uint32_t rs1, uint32_t f3,
+                uint32_t rd, uint32_t op) {
+  return f7 << 25 | rs2 << 20 | rs1 << 15 | f3 << 12 | rd << 7 | op;
+}
+
+uint32_t i_type(int32_t imm, uint32_t rs1, uint32_t f3, uint32_t rd,
+                uint32_t op) {
+  return (static_cast<uint32_t>(imm) & 0xfff) << 20 | rs1 << 15 | f3 << 12 |
+         rd << 7 | op;
+}
+
+uint32_t s_type(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t f3) {
+  const auto u = static_cast<uint32_t>(imm);
+  return ((u >> 5) & 0x7f) << 25 | rs2 << 20 | rs1 << 15 | f3 << 12 |
+         (u & 0x1f) << 7 | 0x23;
+}
+
+uint32_t b_type(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t f3) {
+  const auto u = static_cast<uint32_t>(imm);
+  return ((u >> 12) & 1) << 31 | ((u >> 5) & 0x3f) << 25 | rs2 << 20 |
+         rs1 << 15 | f3 << 12 | ((u >> 1) & 0xf) << 8 | ((u >> 11) & 1) << 7 |
+         0x63;
+}
+
+uint32_t amo(uint32_t f5, uint32_t rd, uint32_t rs1, uint32_t rs2) {
+  return f5 << 27 | rs2 << 20 | rs1 << 15 | 2u << 12 | rd << 7 | 0x2f;
+}
+
+// Code words from kBase; data (e.g. page tables) may be placed behind it.
+struct Program {
+  std::vector<uint32_t> words;
+
+  size_t here() const { return words.size(); }
+  uint32_t addr(size_t index) const {
+    return kBase + static_cast<uint32_t>(index) * 4;
+  }
+  void emit(uint32_t w) { words.push_back(w); }
+  void li(uint32_t rd, uint32_t value) {
+    const uint32_t hi = (value + 0x800u) & 0xfffff000u;
+    emit(hi | rd << 7 | 0x37); // lui
+    emit(i_type(static_cast<int32_t>(value - hi), rd, 0, rd, 0x13));
+  }
+  void addi(uint32_t rd, uint32_t rs1, int32_t imm) {
+    emit(i_type(imm, rs1, 0, rd, 0x13));
+  }
+  void bnez_back(uint32_t rs, size_t target) {
+    const auto off =
+        static_cast<int32_t>(target) - static_cast<int32_t>(here());
+    emit(b_type(off * 4, zero, rs, 1));
+  }
+  void put(uint32_t addr, uint32_t value) {
+    const size_t index = (addr - kBase) / 4;
+    if (words.size() <= index) {
+      words.resize(index + 1, 0);
+    }
+    words[index] = value;
+  }
+};
+
+// Loop body with s0 as the counter, then ebreak. Sized to retire a bit
+// fewer than `inst` instructions so a kernel ends on its own ebreak.
+template <typename Body>
+void counted_loop(Program &p, uint64_t inst, uint32_t len, Body &&body) {
+  const uint64_t iters = inst > 64 + len ? (inst - 64) / len : 1;
+  p.li(s0, static_cast<uint32_t>(std::min<uint64_t>(iters, 0x7fffffffu)));
+  const size_t loop = p.here();
+  body();
+  p.addi(s0, s0, -1);
+  p.bnez_back(s0, loop);
+  p.emit(INST_EBREAK);
+}
+
+// Integer ALU mix with a multiply: 10 instructions per iteration.
+Program kernel_alu(uint64_t inst) {
+  Program p;
+  p.li(a0, 1);
+  p.li(a1, 0x12345);
+  counted_loop(p, inst, 10, [&] {
+    p.emit(r_type(0x00, a1, a0, 0, a2, 0x33)); // add
+    p.emit(r_type(0x00, a0, a2, 4, a3, 0x33)); // xor
+    p.emit(i_type(3, a3, 1, a4, 0x13));        // slli
+    p.emit(r_type(0x01, a1, a4, 0, a5, 0x33)); // mul
+    p.emit(r_type(0x20, a2, a5, 0, a0, 0x33)); // sub
+    p.emit(r_type(0x00, a3, a1, 6, a1, 0x33)); // or
+    p.emit(i_type(5, a0, 5, a6, 0x13));        // srli
+    p.emit(r_type(0x00, a1, a6, 7, a7, 0x33)); // and
+  });
+  return p;
+}
+
+// Read-modify-write stream over a 64 KiB array: 8 per iteration.
+Program kernel_ldst(uint64_t inst) {
+  Program p;
+  p.li(t0, 0);
+  p.li(t4, 0xfffc);
+  p.li(t5, 0x80100000u);
+  counted_loop(p, inst, 8, [&] {
+    p.emit(r_type(0x00, t4, t0, 7, t1, 0x33)); // and
+    p.emit(r_type(0x00, t5, t1, 0, t1, 0x33)); // add
+    p.emit(i_type(0, t1, 2, t2, 0x03));        // lw
+    p.addi(t2, t2, 1);
+    p.emit(s_type(0, t2, t1, 2)); // sw
+    p.addi(t0, t0, 4);
+  });
+  return p;
+}
+
+// AMOs and an LR/SC pair on two words: 7 per iteration.
+Program kernel_amo(uint64_t inst) {
+  Program p;
+  p.li(t5, 0x80100000u);
+  p.li(t6, 0x80100040u);
+  p.li(t1, 1);
+  counted_loop(p, inst, 7, [&] {
+    p.emit(amo(0x00, t2, t5, t1));   // amoadd.w
+    p.emit(amo(0x08, t3, t5, t2));   // amoor.w
+    p.emit(amo(0x02, t3, t6, zero)); // lr.w
+    p.addi(t3, t3, 1);
+    p.emit(amo(0x03, t4, t6, t3)); // sc.w
+  });
+  return p;
+}
+
+// Sv32 with 4 KiB pages in S-mode, touching 512 pages in turn so nearly
+// every access misses the 64-entry DTLB and walks the page table.
+Program kernel_ptw(uint64_t inst) {
+  constexpr uint32_t kRoot = kBase + 0x10000;
+  constexpr uint32_t kLeaf = kBase + 0x11000;
+  Program p;
+  p.li(t0, 0x80000000u | (kRoot >> 12));
+  p.emit(i_type(0x180, t0, 1, zero, 0x73)); // csrw satp
+  p.li(t0, 1u << 12);
+  p.emit(i_type(0x300, t0, 3, zero, 0x73)); // csrc mstatus
+  p.li(t0, 1u << 11);
+  p.emit(i_type(0x300, t0, 2, zero, 0x73)); // csrs mstatus, MPP=S
+  const size_t set_mepc = p.here();
+  p.li(t0, 0); // patched below
+  p.emit(i_type(0x341, t0, 1, zero, 0x73)); // csrw mepc
+  p.emit(0x30200073);                       // mret
+  const uint32_t s_entry = p.addr(p.here());
+  p.words[set_mepc] = ((s_entry + 0x800u) & 0xfffff000u) | t0 << 7 | 0x37;
+  p.words[set_mepc + 1] = i_type(
+      static_cast<int32_t>(s_entry - ((s_entry + 0x800u) & 0xfffff000u)), t0,
+      0, t0, 0x13);
+
+  p.li(t0, 0);
+  p.li(t3, 4096);
+  p.li(t4, 0x1ff000);
+  p.li(t5, 0x80100000u);
+  counted_loop(p, inst, 7, [&] {
+    p.emit(r_type(0x00, t4, t0, 7, t1, 0x33)); // and
+    p.emit(r_type(0x00, t5, t1, 0, t1, 0x33)); // add
+    p.emit(i_type(0, t1, 2, t2, 0x03));        // lw
+    p.emit(s_type(4, t2, t1, 2));              // sw
+    p.emit(r_type(0x00, t3, t0, 0, t0, 0x33)); // add
+  });
+
+  // 0x80000000-0x803fffff identity-mapped with 4 KiB RWX pages.
+  p.put(kRoot + (kBase >> 22) * 4, (kLeaf >> 12) << 10 | 0x1);
+  for (uint32_t i = 0; i < 1024; ++i) {
+    p.put(kLeaf + i * 4, ((kBase >> 12) + i) << 10 | 0xcf);
+  }
+  return p;
+}
+
+// Zfinx single-precision arithmetic in integer registers: 7 per iteration.
+Program kernel_fp(uint64_t inst) {
+  Program p;
+  p.li(a0, 0x3f800000u); // 1.0f
+  p.li(a1, 0x3e000000u); // 0.125f
+  p.li(a2, 0x40490fdbu); // pi
+  counted_loop(p, inst, 7, [&] {
+    p.emit(r_type(0x00, a1, a0, 0, a3, 0x53)); // fadd.s
+    p.emit(r_type(0x08, a2, a3, 0, a4, 0x53)); // fmul.s
+    p.emit(r_type(0x0c, a2, a4, 0, a5, 0x53)); // fdiv.s
+    p.emit(r_type(0x04, a1, a5, 0, a0, 0x53)); // fsub.s
+    p.emit(a2 << 27 | a1 << 20 | a0 << 15 | a6 << 7 | 0x43); // fmadd.s
+  });
+  return p;
+}
+
+// ---------------- CPU layers ----------------
+
+struct Row {
+  std::string workload;
+  std::string layer;
+  uint64_t inst = 0;
+  uint64_t cycles = 0;
+  double seconds = 0.0;
+  bool ok = false;
+  double baseline = 0.0; // rate of the baseline row, 0 if none
+  bool regressed = false;
+
+  // inst/s for CPU rows, cycles/s for bus-model rows.
+  double rate() const {
+    const double work = static_cast<double>(inst != 0 ? inst : cycles);
+    return seconds > 0 ? work / seconds : 0.0;
+  }
+};
+
+enum class Layer { kExec, kFast, kTlm, kCycle, kStep };
+
+const char *layer_name(Layer layer) {
+  switch (layer) {
+  case Layer::kExec:
+    return "exec";
+  case Layer::kFast:
+    return "fast";
+  case Layer::kTlm:
+    return "tlm";
+  case Layer::kCycle:
+    return "cycle";
+  case Layer::kStep:
+    return "step";
+  }
+  return "?";
+}
+
+struct Workload {
+  std::string name;
+  std::string image; // file to load
+  bool kernel;       // must reach its own ebreak within the budget
+};
+
+void sample_ddr_outputs(const sim_ddr::SimDDR_IO_t &ddr_io, sc_axi4_in_t &in) {
+  in.arready = ddr_io.ar.arready;
+  in.awready = ddr_io.aw.awready;
+  in.wready = ddr_io.w.wready;
+  in.rvalid = ddr_io.r.rvalid;
+  in.rid = ddr_io.r.rid;
+  in.rdata = ddr_io.r.rdata;
+  in.rresp = ddr_io.r.rresp;
+  in.rlast = ddr_io.r.rlast;
+  in.bvalid = ddr_io.b.bvalid;
+  in.bid = ddr_io.b.bid;
+  in.bresp = ddr_io.b.bresp;
+}
+
+void drive_ddr_inputs(sim_ddr::SimDDR_IO_t &ddr_io, const sc_axi4_out_t &out) {
+  ddr_io.ar.arvalid = out.arvalid;
+  ddr_io.ar.arid = out.arid;
+  ddr_io.ar.araddr = out.araddr;
+  ddr_io.ar.arlen = out.arlen;
+  ddr_io.ar.arsize = out.arsize;
+  ddr_io.ar.arburst = out.arburst;
+  ddr_io.aw.awvalid = out.awvalid;
+  ddr_io.aw.awid = out.awid;
+  ddr_io.aw.awaddr = out.awaddr;
+  ddr_io.aw.awlen = out.awlen;
+  ddr_io.aw.awsize = out.awsize;
+  ddr_io.aw.awburst = out.awburst;
+  ddr_io.w.wvalid = out.wvalid;
+  ddr_io.w.wdata = out.wdata;
+  ddr_io.w.wstrb = out.wstrb;
+  ddr_io.w.wlast = out.wlast;
+  ddr_io.r.rready = out.rready;
+  ddr_io.b.bready = out.bready;
+}
+
+CpuMemReadResult iss_read(void *ctx, uint32_t paddr, uint32_t *data) {
+  *data = static_cast<PhysicalMemory *>(ctx)->read32(paddr & ~0x3u);
+  return CPU_MEM_READ_OK;
+}
+
+bool iss_read_now(void *ctx, uint32_t paddr, uint32_t *data) {
+  if (data == nullptr) {
+    return false;
+  }
+  *data = static_cast<PhysicalMemory *>(ctx)->read32(paddr);
+  return true;
+}
+
+bool iss_write_now(void *ctx, uint32_t paddr, uint32_t data, uint32_t wstrb) {
+  static_cast<PhysicalMemory *>(ctx)->write32(paddr, data, wstrb);
+  return true;
+}
+
+// exec() on the handle's memory (boot stub and image already in place).
+void run_exec(sc_sim_handle *sim, uint64_t budget, Row &row) {
+  auto cpu = std::make_unique<SingleCycleCpu>();
+  cpu->init(0);
+  cpu->mem_hooks.ctx = sc_sim_get_memory(sim);
+  cpu->mem_hooks.read32 = iss_read;
+  cpu->mem_hooks.read32_now = iss_read_now;
+  cpu->mem_hooks.write32_now = iss_write_now;
+  const auto begin = std::chrono::steady_clock::now();
+  uint64_t n = 0;
+  while (n < budget) {
+    cpu->exec();
+    cpu->sim_time++;
+    n++;
+    if (!cpu->is_exception && cpu->Instruction == INST_EBREAK) {
+      row.ok = true;
+      break;
+    }
+  }
+  row.seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - begin)
+                    .count();
+  row.inst = row.cycles = n;
+  row.ok = row.ok || n == budget;
+}
+
+void run_api(sc_sim_handle *sim, Layer layer, uint64_t budget, Row &row) {
+  sc_sim_set_limits(sim, budget, UINT64_MAX);
+  sc_sim_status_t status{};
+  sim_ddr::SimDDR ddr;
+  sc_axi4_in_t in{};
+  sc_axi4_out_t out{};
+  if (layer == Layer::kStep) {
+    ddr.set_memory(sc_sim_get_memory(sim));
+    ddr.init();
+    ddr.comb_outputs();
+    sample_ddr_outputs(ddr.io, in);
+  }
+  if (layer == Layer::kTlm) {
+    sc_sim_set_timing_mode(sim, SC_SIM_TIMING_TLM);
+  }
+
+  const auto begin = std::chrono::steady_clock::now();
+  int rc = 0;
+  switch (layer) {
+  case Layer::kFast:
+    while (rc == 0 && status.inst_count < budget) {
+      rc = sc_sim_fast_forward(sim, budget - status.inst_count, &status);
+    }
+    break;
+  case Layer::kTlm:
+  case Layer::kCycle:
+    while (rc == 0) {
+      rc = sc_sim_run_until(sim, 0, &status);
+    }
+    break;
+  case Layer::kStep:
+    while (rc == 0) {
+      rc = sc_sim_step(sim, &in, &out, &status);
+      drive_ddr_inputs(ddr.io, out);
+      ddr.comb_inputs();
+      ddr.seq();
+      ddr.comb_outputs();
+      sample_ddr_outputs(ddr.io, in);
+    }
+    break;
+  case Layer::kExec:
+    break;
+  }
+  row.seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - begin)
+                    .count();
+  row.inst = status.inst_count;
+  row.cycles = status.sim_time;
+  row.ok = rc >= 0 && (status.success || status.inst_count >= budget);
+}
+
+bool run_cpu_row(const Workload &w, Layer layer, uint64_t budget, Row &row) {
+  sc_sim_handle *sim = sc_sim_create();
+  if (sim == nullptr || sc_sim_load_image(sim, w.image.c_str(), nullptr) != 0) {
+    std::cerr << "Error: cannot load " << w.image << ": "
+              << (sim != nullptr ? sc_sim_last_error(sim) : "") << std::endl;
+    sc_sim_destroy(sim);
+    return false;
+  }
+  if (layer == Layer::kExec) {
+    run_exec(sim, budget, row);
+  } else {
+    run_api(sim, layer, budget, row);
+  }
+  if (w.kernel && row.inst >= budget) {
+    row.ok = false;
+  }
+  sc_sim_destroy(sim);
+  return true;
+}
+
+// ---------------- Bus-model layers ----------------
+
+// Accepts every request at once and answers the next cycle.
+struct IdealSlave {
+  struct Read {
+    uint8_t id;
+    uint8_t beats_left;
+    uint32_t addr;
+  };
+  std::deque<Read> reads;
+  std::deque<uint8_t> aw_ids;
+  std::deque<uint8_t> b_ids;
+  sim_ddr::SimDDR_IO_t io{};
+
+  void comb_outputs() {
+    io.ar.arready = true;
+    io.aw.awready = true;
+    io.w.wready = !aw_ids.empty();
+    io.r.rvalid = !reads.empty();
+    io.r.rid = reads.empty() ? 0 : reads.front().id;
+    io.r.rdata = reads.empty() ? 0 : reads.front().addr;
+    io.r.rresp = 0;
+    io.r.rlast = !reads.empty() && reads.front().beats_left == 1;
+    io.b.bvalid = !b_ids.empty();
+    io.b.bid = b_ids.empty() ? 0 : b_ids.front();
+    io.b.bresp = 0;
+  }
+
+  void seq() {
+    if (io.r.rvalid && io.r.rready) {
+      Read &r = reads.front();
+      r.addr += 4;
+      if (--r.beats_left == 0) {
+        reads.pop_front();
+      }
+    }
+    if (io.b.bvalid && io.b.bready) {
+      b_ids.pop_front();
+    }
+    if (io.w.wvalid && io.w.wready && io.w.wlast) {
+      b_ids.push_back(aw_ids.front());
+      aw_ids.pop_front();
+    }
+    if (io.ar.arvalid) {
+      reads.push_back({static_cast<uint8_t>(io.ar.arid),
+                       static_cast<uint8_t>(io.ar.arlen + 1), io.ar.araddr});
+    }
+    if (io.aw.awvalid) {
+      aw_ids.push_back(static_cast<uint8_t>(io.aw.awid));
+    }
+  }
+};
+
+// Master-driven AXI signals: interconnect -> slave.
+void drive_slave(const sim_ddr::SimDDR_IO_t &from, sim_ddr::SimDDR_IO_t &to) {
+  to.ar.arvalid = from.ar.arvalid;
+  to.ar.arid = from.ar.arid;
+  to.ar.araddr = from.ar.araddr;
+  to.ar.arlen = from.ar.arlen;
+  to.ar.arsize = from.ar.arsize;
+  to.ar.arburst = from.ar.arburst;
+  to.aw.awvalid = from.aw.awvalid;
+  to.aw.awid = from.aw.awid;
+  to.aw.awaddr = from.aw.awaddr;
+  to.aw.awlen = from.aw.awlen;
+  to.aw.awsize = from.aw.awsize;
+  to.aw.awburst = from.aw.awburst;
+  to.w.wvalid = from.w.wvalid;
+  to.w.wdata = from.w.wdata;
+  to.w.wstrb = from.w.wstrb;
+  to.w.wlast = from.w.wlast;
+  to.r.rready = from.r.rready;
+  to.b.bready = from.b.bready;
+}
+
+// Slave-driven AXI signals: slave -> interconnect.
+void sample_slave(const sim_ddr::SimDDR_IO_t &from, sim_ddr::SimDDR_IO_t &to) {
+  to.ar.arready = from.ar.arready;
+  to.aw.awready = from.aw.awready;
+  to.w.wready = from.w.wready;
+  to.r.rvalid = from.r.rvalid;
+  to.r.rid = from.r.rid;
+  to.r.rdata = from.r.rdata;
+  to.r.rresp = from.r.rresp;
+  to.r.rlast = from.r.rlast;
+  to.b.bvalid = from.b.bvalid;
+  to.b.bid = from.b.bid;
+  to.b.bresp = from.b.bresp;
+}
+
+// Every read master keeps one line read in flight, the write port one store.
+void run_interconnect(uint64_t cycles, Row &row) {
+  using axi_interconnect::NUM_READ_MASTERS;
+  axi_interconnect::AXI_Interconnect ic;
+  ic.init();
+  IdealSlave slave;
+  slave.comb_outputs();
+  bool rd_busy[NUM_READ_MASTERS] = {};
+  bool wr_busy = false;
+  uint64_t done = 0;
+  const auto begin = std::chrono::steady_clock::now();
+  for (uint64_t c = 0; c < cycles; ++c) {
+    sample_slave(slave.io, ic.axi_io);
+    ic.comb_outputs();
+    bool rd_issue[NUM_READ_MASTERS];
+    bool rd_ready[NUM_READ_MASTERS];
+    bool rd_resp[NUM_READ_MASTERS];
+    for (int i = 0; i < NUM_READ_MASTERS; ++i) {
+      auto &port = ic.read_ports[i];
+      rd_ready[i] = port.req.ready;
+      rd_resp[i] = port.resp.valid;
+      rd_issue[i] = !rd_busy[i];
+      port.resp.ready = true;
+      port.req.valid = rd_issue[i];
+      port.req.addr = kBase + static_cast<uint32_t>(i) * 0x100000u +
+                      static_cast<uint32_t>(c & 0xffe0);
+      port.req.total_size = 31;
+      port.req.id = 0;
+    }
+    auto &wport = ic.write_port;
+    const bool wr_ready = wport.req.ready;
+    const bool wr_resp = wport.resp.valid;
+    const bool wr_issue = !wr_busy;
+    wport.resp.ready = true;
+    wport.req.valid = wr_issue;
+    wport.req.addr = kBase + 0x800000u + static_cast<uint32_t>(c & 0xfffc);
+    wport.req.wdata[0] = static_cast<uint32_t>(c);
+    wport.req.wstrb = 0xF;
+    wport.req.total_size = 3;
+    wport.req.id = 0;
+
+    ic.comb_inputs();
+    drive_slave(ic.axi_io, slave.io);
+    ic.seq();
+    slave.seq();
+    slave.comb_outputs();
+
+    for (int i = 0; i < NUM_READ_MASTERS; ++i) {
+      if (rd_resp[i]) {
+        rd_busy[i] = false;
+        done++;
+      }
+      if (rd_issue[i] && rd_ready[i]) {
+        rd_busy[i] = true;
+      }
+    }
+    if (wr_resp) {
+      wr_busy = false;
+      done++;
+    }
+    if (wr_issue && wr_ready) {
+      wr_busy = true;
+    }
+  }
+  row.seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - begin)
+                    .count();
+  row.cycles = cycles;
+  row.ok = done != 0;
+}
+
+// Back-to-back 8-beat reads and writes straight into SimDDR.
+void run_simddr(uint64_t cycles, Row &row) {
+  PhysicalMemory memory;
+  sim_ddr::SimDDR ddr;
+  ddr.set_memory(&memory);
+  ddr.init();
+  ddr.comb_outputs();
+  uint32_t raddr = kBase;
+  uint32_t waddr = kBase + 0x800000u;
+  bool aw_done = false;
+  uint32_t w_beat = 0;
+  uint64_t done = 0;
+  const auto begin = std::chrono::steady_clock::now();
+  for (uint64_t c = 0; c < cycles; ++c) {
+    sim_ddr::SimDDR_IO_t &io = ddr.io;
+    const bool ar_fire = io.ar.arready;
+    const bool aw_fire = !aw_done && io.aw.awready;
+    const bool w_fire = aw_done && io.w.wready;
+    const bool r_fire = io.r.rvalid;
+    const bool b_fire = io.b.bvalid;
+    const bool r_last = io.r.rlast;
+    io.ar.arvalid = true;
+    io.ar.arid = 0;
+    io.ar.araddr = raddr;
+    io.ar.arlen = 7;
+    io.ar.arsize = 2;
+    io.ar.arburst = sim_ddr::AXI_BURST_INCR;
+    io.aw.awvalid = !aw_done;
+    io.aw.awid = 0;
+    io.aw.awaddr = waddr;
+    io.aw.awlen = 7;
+    io.aw.awsize = 2;
+    io.aw.awburst = sim_ddr::AXI_BURST_INCR;
+    io.w.wvalid = aw_done;
+    io.w.wdata = static_cast<uint32_t>(c);
+    io.w.wstrb = 0xF;
+    io.w.wlast = w_beat == 7;
+    io.r.rready = true;
+    io.b.bready = true;
+    ddr.comb_inputs();
+    ddr.seq();
+    ddr.comb_outputs();
+
+    if (ar_fire) {
+      raddr = kBase + ((raddr + 32) & 0xfffff);
+    }
+    if (r_fire && r_last) {
+      done++;
+    }
+    if (aw_fire) {
+      aw_done = true;
+    }
+    if (w_fire && ++w_beat == 8) {
+      w_beat = 0;
+      aw_done = false;
+      waddr = kBase + 0x800000u + ((waddr + 32) & 0xfffff);
+    }
+    if (b_fire) {
+      done++;
+    }
+  }
+  row.seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - begin)
+                    .count();
+  row.cycles = cycles;
+  row.ok = done != 0;
+}
+
+// ---------------- Reporting ----------------
+
+// "key": value from one line of an earlier report (numbers and strings).
+std::string json_field(const std::string &line, const char *key) {
+  const std::string tag = std::string("\"") + key + "\": ";
+  const size_t pos = line.find(tag);
+  if (pos == std::string::npos) {
+    return std::string();
+  }
+  size_t begin = pos + tag.size();
+  if (line[begin] == '"') {
+    const size_t end = line.find('"', begin + 1);
+    return line.substr(begin + 1, end - begin - 1);
+  }
+  const size_t end = line.find_first_of(",}", begin);
+  return line.substr(begin, end - begin);
+}
+
+bool read_baseline(const char *path, std::map<std::string, double> &rates) {
+  std::ifstream in(path);
+  if (!in.is_open()) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    const std::string workload = json_field(line, "workload");
+    const std::string rate = json_field(line, "rate");
+    if (!workload.empty() && !rate.empty()) {
+      rates[workload + "/" + json_field(line, "layer")] =
+          std::strtod(rate.c_str(), nullptr);
+    }
+  }
+  return true;
+}
+
+void write_json(FILE *out, const std::vector<Row> &rows, uint64_t budget,
+                uint64_t cycles, uint64_t repeat) {
+  std::fprintf(out,
+               "{\"inst_budget\": %llu, \"cycle_budget\": %llu, "
+               "\"repeat\": %llu, \"rows\": [\n",
+               static_cast<unsigned long long>(budget),
+               static_cast<unsigned long long>(cycles),
+               static_cast<unsigned long long>(repeat));
+  for (size_t i = 0; i < rows.size(); ++i) {
+    const Row &r = rows[i];
+    std::fprintf(out,
+                 "  {\"workload\": \"%s\", \"layer\": \"%s\", \"inst\": %llu, "
+                 "\"cycles\": %llu, \"seconds\": %.6f, \"rate\": %.1f, "
+                 "\"inst_per_s\": %.1f, \"cycles_per_s\": %.1f, "
+                 "\"ok\": %s, \"baseline_rate\": %.1f, \"regressed\": %s}%s\n",
+                 r.workload.c_str(), r.layer.c_str(),
+                 static_cast<unsigned long long>(r.inst),
+                 static_cast<unsigned long long>(r.cycles), r.seconds,
+                 r.rate(),
+                 r.seconds > 0 ? static_cast<double>(r.inst) / r.seconds : 0.0,
+                 r.seconds > 0 ? static_cast<double>(r.cycles) / r.seconds
+                               : 0.0,
+                 r.ok ? "true" : "false", r.baseline,
+                 r.regressed ? "true" : "false",
+                 i + 1 < rows.size() ? "," : "");
+  }
+  std::fputs("]}\n", out);
+}
+
+bool write_image(const Program &p, std::string &path) {
+  char name[] = "/tmp/sim_bench_XXXXXX";
+  const int fd = mkstemp(name);
+  if (fd < 0) {
+    return false;
+  }
+  const size_t bytes = p.words.size() * sizeof(uint32_t);
+  const bool ok = write(fd, p.words.data(), bytes) ==
+                  static_cast<ssize_t>(bytes);
+  close(fd);
+  path = name;
+  return ok;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  uint64_t budget = 1000000;
+  uint64_t bus_cycles = 2000000;
+  uint64_t repeat = 1;
+  uint64_t tolerance = 10;
+  std::string only;
+  const char *json_path = nullptr;
+  const char *baseline_path = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    const bool has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--inst") == 0 && has_value &&
+        parse_u64(argv[i + 1], budget) && budget != 0) {
+      ++i;
+    } else if (std::strcmp(argv[i], "--cycles") == 0 && has_value &&
+               parse_u64(argv[i + 1], bus_cycles) && bus_cycles != 0) {
+      ++i;
+    } else if (std::strcmp(argv[i], "--repeat") == 0 && has_value &&
+               parse_u64(argv[i + 1], repeat) && repeat != 0) {
+      ++i;
+    } else if (std::strcmp(argv[i], "--tolerance") == 0 && has_value &&
+               parse_u64(argv[i + 1], tolerance) && tolerance < 100) {
+      ++i;
+    } else if (std::strcmp(argv[i], "--only") == 0 && has_value) {
+      only = argv[++i];
+    } else if (std::strcmp(argv[i], "--json") == 0 && has_value) {
+      json_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--baseline") == 0 && has_value) {
+      baseline_path = argv[++i];
+    } else if (std::strcmp(argv[i], "-h") == 0 ||
+               std::strcmp(argv[i], "--help") == 0) {
+      print_usage(argv[0]);
+      return 0;
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  std::map<std::string, double> baseline;
+  if (baseline_path != nullptr && !read_baseline(baseline_path, baseline)) {
+    std::cerr << "Error: cannot read baseline: " << baseline_path << std::endl;
+    return 1;
+  }
+
+  std::vector<Workload> workloads = {{"dhrystone", "bin/dhrystone.bin", false},
+                                     {"coremark", "bin/coremark.bin", false}};
+  std::vector<std::string> temp_files;
+  const std::pair<const char *, Program (*)(uint64_t)> kernels[] = {
+      {"alu", kernel_alu}, {"ldst", kernel_ldst}, {"amo", kernel_amo},
+      {"ptw", kernel_ptw}, {"fp", kernel_fp},
+  };
+  for (const auto &[name, build] : kernels) {
+    std::string path;
+    if (!write_image(build(budget), path)) {
+      std::cerr << "Error: cannot write kernel image" << std::endl;
+      return 1;
+    }
+    temp_files.push_back(path);
+    workloads.push_back({name, path, true});
+  }
+
+  auto selected = [&](const std::string &key) {
+    return only.empty() || key.find(only) != std::string::npos;
+  };
+  std::vector<Row> rows;
+  bool failed = false;
+  auto keep_best = [&](Row best, auto &&run) {
+    for (uint64_t r = 0; r < repeat; ++r) {
+      Row row = best;
+      run(row);
+      if (r == 0 || row.seconds < best.seconds) {
+        best = row;
+      }
+    }
+    rows.push_back(best);
+  };
+  const Layer layers[] = {Layer::kExec, Layer::kFast, Layer::kTlm,
+                          Layer::kCycle, Layer::kStep};
+  for (const Workload &w : workloads) {
+    for (Layer layer : layers) {
+      Row row;
+      row.workload = w.name;
+      row.layer = layer_name(layer);
+      if (!selected(row.workload + "/" + row.layer)) {
+        continue;
+      }
+      keep_best(row, [&](Row &r) {
+        failed |= !run_cpu_row(w, layer, budget, r);
+      });
+    }
+  }
+  for (const char *layer : {"interconnect", "simddr"}) {
+    Row row;
+    row.workload = "axi";
+    row.layer = layer;
+    if (!selected(row.workload + "/" + row.layer)) {
+      continue;
+    }
+    keep_best(row, [&](Row &r) {
+      if (std::strcmp(layer, "interconnect") == 0) {
+        run_interconnect(bus_cycles, r);
+      } else {
+        run_simddr(bus_cycles, r);
+      }
+    });
+  }
+  for (const std::string &path : temp_files) {
+    unlink(path.c_str());
+  }
+
+  bool regressed = false;
+  std::printf("%-10s %-13s %10s %11s %9s %9s %10s\n", "workload", "layer",
+              "inst", "cycles", "seconds", "MIPS", "Mcycles/s");
+  for (Row &r : rows) {
+    const auto it = baseline.find(r.workload + "/" + r.layer);
+    if (it != baseline.end()) {
+      r.baseline = it->second;
+      r.regressed =
+          r.rate() < it->second * (100.0 - static_cast<double>(tolerance)) /
+                         100.0;
+      regressed |= r.regressed;
+    }
+    failed |= !r.ok;
+    std::printf("%-10s %-13s %10llu %11llu %9.3f %9.2f %10.2f%s%s\n",
+                r.workload.c_str(), r.layer.c_str(),
+                static_cast<unsigned long long>(r.inst),
+                static_cast<unsigned long long>(r.cycles), r.seconds,
+                r.seconds > 0 ? static_cast<double>(r.inst) / r.seconds / 1e6
+                              : 0.0,
+                r.seconds > 0 ? static_cast<double>(r.cycles) / r.seconds / 1e6
+                              : 0.0,
+                r.ok ? "" : "  FAILED", r.regressed ? "  REGRESSED" : "");
+  }
+
+  if (json_path != nullptr) {
+    const bool to_stdout = std::strcmp(json_path, "-") == 0;
+    FILE *out = to_stdout ? stdout : std::fopen(json_path, "w");
+    if (out == nullptr) {
+      std::cerr << "Error: cannot open " << json_path << std::endl;
+      return 1;
+    }
+    write_json(out, rows, budget, bus_cycles, repeat);
+    if (!to_stdout) {
+      std::fclose(out);
+    }
+  }
+  if (failed) {
+    return 1;
+  }
+  return regressed ? 3 : 0;
+}